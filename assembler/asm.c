@@ -5,19 +5,27 @@
 
 #include <stdint.h>
 #include <assert.h>
+#include <time.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
 
 #define WORD_SIZE 16
 #define WORD_UTYPE uint16_t
 #define WORD_STYPE int16_t
 #define WORD_MAX UINT16_MAX
 
+#include "object_format.c"
+#include "../emulator/image_format.c"
+
 typedef enum {
     TOKEN_START, TOKEN_ASSIGN, TOKEN_ARRAY, TOKEN_COMMA, TOKEN_ALLOC, TOKEN_HYPHEN, 
     TOKEN__INST_BEGIN,
     TOKEN_INST_ZER, TOKEN_INST_INC, TOKEN_INST_DEC, 
     TOKEN_INST_NEG, TOKEN_INST_ADD, TOKEN_INST_SUB, TOKEN_INST_MUL, TOKEN_INST_DIV, TOKEN_INST_MOD, 
-    TOKEN_INST_JMP, TOKEN_INST_JLE, TOKEN_INST_JLZ, TOKEN_INST_JEZ, TOKEN_INST_JGE, TOKEN_INST_JGZ, TOKEN_INST_SJP, TOKEN_INST_LJP, 
-    TOKEN_INST_MOV, TOKEN_INST_ADR, TOKEN_INST_DRD, TOKEN_INST_DWT, 
+    TOKEN_INST_AND, TOKEN_INST_OR, TOKEN_INST_XOR, TOKEN_INST_SHL, TOKEN_INST_SHR, 
+    TOKEN_INST_JMP, TOKEN_INST_JLE, TOKEN_INST_JLZ, TOKEN_INST_JEZ, TOKEN_INST_JGE, TOKEN_INST_JGZ, TOKEN_INST_SJP, TOKEN_INST_LJP, TOKEN_INST_CAL, TOKEN_INST_RET, TOKEN_INST_JTB, 
+    TOKEN_INST_MOV, TOKEN_INST_ADR, TOKEN_INST_DRD, TOKEN_INST_DWT, TOKEN_INST_LDX, TOKEN_INST_STX, TOKEN_INST_CPY, TOKEN_INST_FIL, 
     TOKEN_INST_INP, TOKEN_INST_OUT, TOKEN_INST_HLT,
     TOKEN__INST_END,
     TOKEN_LABEL_DECL, TOKEN_LABEL_USE,
@@ -26,16 +34,14 @@ typedef enum {
 
 #define MAX_IDENTIFIER_LENGTH 2048
 
-TokenType token = TOKEN_UNKNOWN;
 static char token_string_buffer[MAX_IDENTIFIER_LENGTH + 1] = {0};
-static char temp_token_string_buffer[MAX_IDENTIFIER_LENGTH + 2] = {0};
-static WORD_UTYPE token_number = 0;
 
 static PICOCT_Match keyword_table[] = {
     {"zer",  TOKEN_INST_ZER}, {"inc",  TOKEN_INST_INC}, {"dec",  TOKEN_INST_DEC},
     {"neg",  TOKEN_INST_NEG}, {"add",  TOKEN_INST_ADD}, {"sub",  TOKEN_INST_SUB}, {"mul",  TOKEN_INST_MUL}, {"div",  TOKEN_INST_DIV}, {"mod",  TOKEN_INST_MOD},
-    {"jmp",  TOKEN_INST_JMP}, {"jle",  TOKEN_INST_JLE}, {"jlz",  TOKEN_INST_JLZ}, {"jez",  TOKEN_INST_JEZ}, {"jge",  TOKEN_INST_JGE}, {"jgz",  TOKEN_INST_JGZ}, {"sjp",  TOKEN_INST_SJP}, {"ljp",  TOKEN_INST_LJP},
-    {"mov",  TOKEN_INST_MOV}, {"adr",  TOKEN_INST_ADR}, {"drd",  TOKEN_INST_DRD}, {"dwt",  TOKEN_INST_DWT}, 
+    {"and",  TOKEN_INST_AND}, {"or",   TOKEN_INST_OR}, {"xor",  TOKEN_INST_XOR}, {"shl",  TOKEN_INST_SHL}, {"shr",  TOKEN_INST_SHR},
+    {"jmp",  TOKEN_INST_JMP}, {"jle",  TOKEN_INST_JLE}, {"jlz",  TOKEN_INST_JLZ}, {"jez",  TOKEN_INST_JEZ}, {"jge",  TOKEN_INST_JGE}, {"jgz",  TOKEN_INST_JGZ}, {"sjp",  TOKEN_INST_SJP}, {"ljp",  TOKEN_INST_LJP}, {"cal",  TOKEN_INST_CAL}, {"ret",  TOKEN_INST_RET}, {"jtb",  TOKEN_INST_JTB},
+    {"mov",  TOKEN_INST_MOV}, {"adr",  TOKEN_INST_ADR}, {"drd",  TOKEN_INST_DRD}, {"dwt",  TOKEN_INST_DWT}, {"ldx",  TOKEN_INST_LDX}, {"stx",  TOKEN_INST_STX}, {"cpy",  TOKEN_INST_CPY}, {"fil",  TOKEN_INST_FIL}, 
     {"inp",  TOKEN_INST_INP}, {"out",  TOKEN_INST_OUT}, {"hlt",  TOKEN_INST_HLT},
 };
 static PICOCT_Match symbol_table[] = {
@@ -63,8 +69,9 @@ static const char** token_type_names = (const char*[]) {
     "",
     "INST_ZER", "INST_INC", "INST_DEC", 
     "INST_NEG", "INST_ADD", "INST_SUB", "INST_MUL", "INST_DIV", "INST_MOD", 
-    "INST_JMP", "INST_JLE", "INST_JLZ", "INST_JEZ", "INST_JGE", "INST_JGZ", "INST_SJP", "INST_LJP", 
-    "INST_MOV", "INST_ADR", "INST_DRD", "INST_DWT", 
+    "INST_AND", "INST_OR", "INST_XOR", "INST_SHL", "INST_SHR", 
+    "INST_JMP", "INST_JLE", "INST_JLZ", "INST_JEZ", "INST_JGE", "INST_JGZ", "INST_SJP", "INST_LJP", "INST_CAL", "INST_RET", "INST_JTB", 
+    "INST_MOV", "INST_ADR", "INST_DRD", "INST_DWT", "INST_LDX", "INST_STX", "INST_CPY", "INST_FIL", 
     "INST_INP", "INST_OUT", "INST_HLT",
     "",
     "TOKEN_LABEL_DECL ($)", "TOKEN_LABEL_USE (@)",
@@ -77,22 +84,42 @@ typedef enum {
     IST_IMMADDR_ADDR,
     IST_LABEL,
     IST_ADDR_LABEL,
+    IST_LABEL_ADDR,
+    IST_ADDR_LABELS,
     IST_LABELDEREF_ADDR,
     IST_ADDRDEREF_ADDR,
     IST_PORT_ADDR,
     IST_IMMADDR_PORT,
+    IST_ADDR_IMMADDR_ADDR,
+    IST_IMMADDR_ADDR_IMMADDR,
+    IST_ADDR_ADDR_IMMADDR,
 } InstSyntaxType;
 
 static InstSyntaxType inst_syntax_types[256] = {
     [TOKEN_INST_ZER] = IST_ADDR, [TOKEN_INST_INC] = IST_ADDR, [TOKEN_INST_DEC] = IST_ADDR, 
     [TOKEN_INST_NEG] = IST_ADDR, [TOKEN_INST_ADD] = IST_IMMADDR_ADDR, [TOKEN_INST_SUB] = IST_IMMADDR_ADDR, [TOKEN_INST_MUL] = IST_IMMADDR_ADDR, [TOKEN_INST_DIV] = IST_IMMADDR_ADDR, [TOKEN_INST_MOD] = IST_IMMADDR_ADDR, 
-    [TOKEN_INST_JMP] = IST_LABEL, [TOKEN_INST_JLE] = IST_ADDR_LABEL, [TOKEN_INST_JLZ] = IST_ADDR_LABEL, [TOKEN_INST_JEZ] = IST_ADDR_LABEL, [TOKEN_INST_JGE] = IST_ADDR_LABEL, [TOKEN_INST_JGZ] = IST_ADDR_LABEL, [TOKEN_INST_SJP] = IST_LABELDEREF_ADDR, [TOKEN_INST_LJP] = IST_ADDR, 
+    [TOKEN_INST_AND] = IST_IMMADDR_ADDR, [TOKEN_INST_OR] = IST_IMMADDR_ADDR, [TOKEN_INST_XOR] = IST_IMMADDR_ADDR, [TOKEN_INST_SHL] = IST_IMMADDR_ADDR, [TOKEN_INST_SHR] = IST_IMMADDR_ADDR, 
+    [TOKEN_INST_JMP] = IST_LABEL, [TOKEN_INST_JLE] = IST_ADDR_LABEL, [TOKEN_INST_JLZ] = IST_ADDR_LABEL, [TOKEN_INST_JEZ] = IST_ADDR_LABEL, [TOKEN_INST_JGE] = IST_ADDR_LABEL, [TOKEN_INST_JGZ] = IST_ADDR_LABEL, [TOKEN_INST_SJP] = IST_LABELDEREF_ADDR, [TOKEN_INST_LJP] = IST_ADDR, [TOKEN_INST_CAL] = IST_LABEL_ADDR, [TOKEN_INST_RET] = IST_ADDR, [TOKEN_INST_JTB] = IST_ADDR_LABELS, 
     [TOKEN_INST_MOV] = IST_IMMADDR_ADDR, [TOKEN_INST_ADR] = IST_ADDRDEREF_ADDR, [TOKEN_INST_DRD] = IST_IMMADDR_ADDR, [TOKEN_INST_DWT] = IST_IMMADDR_ADDR, 
+    [TOKEN_INST_LDX] = IST_ADDR_IMMADDR_ADDR, [TOKEN_INST_STX] = IST_IMMADDR_ADDR_IMMADDR, [TOKEN_INST_CPY] = IST_ADDR_ADDR_IMMADDR, [TOKEN_INST_FIL] = IST_IMMADDR_ADDR_IMMADDR, 
     [TOKEN_INST_INP] = IST_PORT_ADDR, [TOKEN_INST_OUT] = IST_IMMADDR_PORT, [TOKEN_INST_HLT] = IST_NONE,
 };
+static inline size_t inst_operands_count(TokenType inst) {
+    switch (inst_syntax_types[inst]) {
+    case IST_NONE: return 0;
+    case IST_ADDR: case IST_LABEL: case IST_ADDR_LABELS: return 1; // the labels of jtb are jtb_labels_count
+    case IST_ADDR_IMMADDR_ADDR: case IST_IMMADDR_ADDR_IMMADDR: case IST_ADDR_ADDR_IMMADDR: return 3;
+    default: return 2;
+    }
+}
 
 typedef enum {
-    I = 256, E, A, B, Z, M, O, P, Q, R, S, N
+    I = 256, E, A, B, Z, M, O, P, Q, R, S, N,
+    T, // the third operand (ldx, stx), the label of cal
+    L, // b as a code word, the jump of the ret cal writes the return address into
+    W, // the constant WORD_SIZE
+    H, // the constant with only the top bit set
+    K, // K + i is the i-th constant of a generated template
 } ABType;
 
 typedef struct {
@@ -105,7 +132,221 @@ static CodeGenType INST_DEC_code_gen[] = {{O, A, I}};
 static CodeGenType INST_NEG_code_gen[] = {{Z, Z, I}, {P, P, I}, {A, P, I}, {P, Z, I}, {A, A, I}, {Z, A, I}};
 static CodeGenType INST_ADD_code_gen[] = {{Z, Z, I}, {A, Z, I}, {Z, B, I}};
 static CodeGenType INST_SUB_code_gen[] = {{A, B, I}};
+// mul, div and mod go over the bits of an operand from the top, so they take the same time for every value.
+// a word is shifted left by adding it to itself and its top bit is tested with {X, Z, c} (jumps if X >= 0),
+// which reads -32768 as positive, so the shifted word always keeps a set bit below the ones still to be tested.
+// the top bit is handled before the loop, the loop does the other WORD_SIZE - 1 with s counting up from -WORD_SIZE + 1
 static CodeGenType INST_MUL_code_gen[] = {
+    {Z, Z, I}, {Q, Q, I}, {R, R, I}, {S, S, I}, // zer q, r, s
+    {B, R, I}, // mov -b r
+    {Z, A, 11}, // jle a @top
+    {A, Z, I}, {Z, Q, I}, {Z, Q, I}, {M, Q, I}, // mov 2a + 1 q, the 1 marks the end of the bits
+    {B, B, 18}, // zer b, jmp @count
+    {A, Z, I}, {Z, Q, I}, {M, Q, 15}, // $top, jle a + 1 @set
+    {B, B, E}, // a = 0, zer b, jmp @e
+    {Z, Q, I}, // $set, mov 2a + 1 q
+    {B, B, I}, {R, B, I}, // mov b b
+    {Z, Z, I}, {W, S, I}, {M, S, I}, // $count, mov -15 s
+    {M, S, 23}, {Z, Z, E}, // $loop, inc s, jle s @body, jmp @e
+    {B, Z, I}, {Z, B, I}, {Z, Z, I}, // $body, add b b
+    {Q, Z, 28}, {R, B, I}, // jge q @no_bit, add b_orig b
+    {Z, Q, I}, {Z, Z, 21} // $no_bit, add q q, jmp @loop
+};
+// restoring division of the magnitudes, q = -|a| and x = |a| - 1 - remainder (stays in [0, |a| - 1] so nothing overflows).
+// the bits of |b| are shifted out of the top of b while the inverted quotient bits are shifted in, b ends up as ~quotient.
+// |b| = 32768 (b = -32768) takes its top bit before the loop, p counts the negative operands
+static CodeGenType INST_DIV_code_gen[] = {
+    {Z, Z, I}, {P, P, I}, {Q, Q, I}, {R, R, I}, {S, S, I}, // zer p, q, r, s
+    {Z, A, 8}, // jle a @neg_a
+    {A, Q, I}, // mov -a q
+    {Z, Z, 12}, // jmp @b
+    {A, Z, I}, {Z, Q, I}, {M, P, I}, {Z, Z, I}, // $neg_a, mov a q, inc p
+    {Q, R, I}, {O, R, I}, // $b, mov |a| - 1 x
+    {Z, B, 16}, // jle b @neg_b
+    {B, Z, 22}, // mov -b z, jmp @shift
+    {M, P, I}, // $neg_b, inc p
+    {B, S, I}, {Z, S, 45}, // mov -b s, jle s @special
+    {S, Z, I}, {B, B, I}, {Z, B, I}, // mov -b b
+    {Z, B, I}, {M, B, I}, {Z, Z, I}, // $shift, mov 2b + 1 b
+    {R, Z, I}, // $init, mov -x z
+    {S, S, I}, {W, S, I}, {M, S, 30}, // $init2, mov -15 s, jmp @loop
+    {M, B, I}, // $one, inc b
+    {M, S, 32}, {Z, Z, 54}, // $loop, inc s, jle s @body, jmp @end
+    {Q, Z, I}, {O, Z, I}, {Z, R, I}, {Z, Z, I}, // $body, x = 2x - |a| + 1
+    {B, Z, 38}, {O, R, I}, // jge b @no_bit, dec x
+    {Z, B, I}, {Z, Z, I}, // $no_bit, add b b
+    {R, Z, 29}, // jge x @one
+    {Z, Z, I}, {Q, R, I}, {R, Z, 30}, // add |a| x, jmp @loop
+    {Z, Z, 54}, // only reached for a = 0, jmp @end
+    {M, S, 47}, {Z, Z, E}, // $special, b is 0 or -32768, jlz -b @big, jmp @e
+    {B, B, I}, {M, B, I}, {O, R, I}, // $big, mov 1 b, mov |a| - 2 x
+    {R, Z, 26}, // jge x @init2
+    {Z, Z, I}, {Q, R, I}, {O, B, 25}, // |a| = 1, mov 0 x, mov 0 b, jmp @init
+    {O, P, 56}, {Z, Z, 59}, // $end, dec p, jle p @sign, jmp @pos
+    {M, P, 59}, // $sign, inc p, jle p @pos
+    {M, B, I}, {Z, Z, E}, // mov ~b + 1 b (-quotient), jmp @e
+    {B, Z, I}, {O, Z, I}, {R, R, I}, {Z, R, I}, {B, B, I}, {R, B, I} // $pos, mov ~b b
+};
+// same loop as div, the remainder is |a| - 1 - x and has the sign of b
+static CodeGenType INST_MOD_code_gen[] = {
+    {Z, Z, I}, {P, P, I}, {Q, Q, I}, {R, R, I}, {S, S, I}, // zer p, q, r, s
+    {Z, A, 8}, // jle a @neg_a
+    {A, Q, I}, // mov -a q
+    {Z, Z, 11}, // jmp @b
+    {A, Z, I}, {Z, Q, I}, {Z, Z, I}, // $neg_a, mov a q
+    {Q, R, I}, {O, R, I}, // $b, mov |a| - 1 x
+    {Z, B, 15}, // jle b @neg_b
+    {B, Z, 21}, // mov -b z, jmp @shift
+    {M, P, I}, // $neg_b, inc p
+    {B, S, I}, {Z, S, 44}, // mov -b s, jle s @special
+    {S, Z, I}, {B, B, I}, {Z, B, I}, // mov -b b
+    {Z, B, I}, {M, B, I}, {Z, Z, I}, // $shift, mov 2b + 1 b
+    {R, Z, I}, // $init, mov -x z
+    {S, S, I}, {W, S, I}, {M, S, 29}, // $init2, mov -15 s, jmp @loop
+    {M, B, I}, // $one, inc b
+    {M, S, 31}, {Z, Z, 53}, // $loop, inc s, jle s @body, jmp @end
+    {Q, Z, I}, {O, Z, I}, {Z, R, I}, {Z, Z, I}, // $body, x = 2x - |a| + 1
+    {B, Z, 37}, {O, R, I}, // jge b @no_bit, dec x
+    {Z, B, I}, {Z, Z, I}, // $no_bit, add b b
+    {R, Z, 28}, // jge x @one
+    {Z, Z, I}, {Q, R, I}, {R, Z, 29}, // add |a| x, jmp @loop
+    {Z, Z, 53}, // only reached for a = 0, jmp @end
+    {M, S, 46}, {Z, Z, E}, // $special, b is 0 or -32768, jlz -b @big, jmp @e
+    {B, B, I}, {M, B, I}, {O, R, I}, // $big, mov 1 b, mov |a| - 2 x
+    {R, Z, 25}, // jge x @init2
+    {Z, Z, I}, {Q, R, I}, {O, B, 24}, // |a| = 1, mov 0 x, mov 0 b, jmp @init
+    {B, B, I}, // $end, zer b
+    {Z, P, 60}, // jle p @pos
+    {R, Z, I}, {Q, Z, I}, {Z, B, I}, {M, B, I}, {Z, Z, E}, // mov x - |a| + 1 b (-remainder), jmp @e
+    {Q, B, I}, {O, B, I}, {R, B, I} // $pos, mov |a| - 1 - x b
+};
+// and, or and xor share the bit loop of and: p = 2a + 1 and q = 2b + 1 keep a marker below the bits still to be tested
+// like mul, the top bits are tested before. every turn shifts the next bit of a and b out of the top of p and q and
+// the bit of a & b into the bottom of q, so q ends up as the low bits of a & b with the marker on top.
+// r is what the top bit of the result takes off that (0 or -32768, which are their own negation),
+// then or is a + b - (a & b) and xor is a + b - 2 * (a & b), where the top bit drops out
+#define BIT_LOOP_CODE_GEN \
+    {Z, Z, I}, {P, P, I}, {Q, Q, I}, {R, R, I}, {S, S, I}, {W, S, I}, {M, S, I}, {M, S, I}, /* zer p, q, r, mov -14 s */ \
+    {A, Z, I}, {Z, P, 13}, /* mov a p, jle a @a_le */ \
+    {Z, P, I}, {M, P, I}, {Z, Z, 26}, /* mov 2a + 1 p, jmp @b_any */ \
+    {M, P, 15}, {Z, Z, 26}, /* $a_le, jle a + 1 @a_neg, a = 0 is p = 1, jmp @b_any */ \
+    {Z, P, I}, {Z, Z, I}, /* $a_neg, mov 2a + 1 p */ \
+    {B, Z, I}, {Z, Q, 22}, /* mov b q, jle b @b_le */ \
+    {Z, Q, I}, {M, Q, I}, {Z, Z, 30}, /* mov 2b + 1 q, jmp @fix */ \
+    {M, Q, 24}, {Z, Z, 30}, /* $b_le, jle b + 1 @b_neg, b = 0 is q = 1, jmp @fix */ \
+    {Z, Q, I}, {Z, Z, 32}, /* $b_neg, mov 2b + 1 q, the top bit is set, jmp @body */ \
+    {B, Z, I}, {Z, Q, I}, {Z, Q, I}, {M, Q, I}, /* $b_any, mov 2b + 1 q */ \
+    {H, R, I}, {Z, Z, I}, /* $fix, mov -32768 r */ \
+    {P, Z, 41}, {Z, P, I}, {Z, Z, I}, /* $body, jge p @a_zero, add p p */ \
+    {Q, Z, 44}, {Z, Q, I}, {Z, Z, I}, {M, Q, I}, /* jge q @b_zero, add q q, inc q */ \
+    {M, S, 32}, {Z, Z, 47}, /* inc s, jle s @body, jmp @end */ \
+    {Z, P, I}, {Z, Z, I}, {Q, Z, I}, /* $a_zero, add p p */ \
+    {Z, Q, I}, {Z, Z, I}, /* $b_zero, add q q */ \
+    {M, S, 32} /* inc s, jle s @body, $end */
+static CodeGenType INST_AND_code_gen[] = {BIT_LOOP_CODE_GEN, {B, B, I}, {Q, Z, I}, {Z, B, I}, {R, B, I}};
+static CodeGenType INST_OR_code_gen[] = {BIT_LOOP_CODE_GEN, {A, Z, I}, {Z, B, I}, {Q, B, I}, {R, B, I}};
+static CodeGenType INST_XOR_code_gen[] = {BIT_LOOP_CODE_GEN, {A, Z, I}, {Z, B, I}, {Q, B, I}, {Q, B, I}};
+// shifts by a <= 0 leave b, by a >= WORD_SIZE clear it. shl doubles b a times, shr takes the top WORD_SIZE - a bits
+// of b into r from the top like the bit loop (an immediate shl is a mul by 1 << a, an immediate shr is generated)
+static CodeGenType INST_SHL_code_gen[] = {
+    {Z, Z, I}, {Q, Q, I}, {A, Q, I}, {Q, Z, E}, // mov -a q, jle a @e
+    {W, Z, 6}, {B, B, E}, // jle a - 16 @count, zer b, jmp @e
+    {M, Q, I}, {Z, Z, I}, // $count, mov 1 - a q
+    {B, Z, I}, {Z, B, I}, {Z, Z, I}, {M, Q, 8} // $loop, add b b, inc q, jle q @loop
+};
+static CodeGenType INST_SHR_code_gen[] = {
+    {Z, Z, I}, {S, S, I}, {A, Z, I}, {Z, S, E}, // mov a s, jle a @e
+    {W, S, I}, {M, S, 7}, {B, B, E}, // mov a - 15 s, jle s @bits, zer b, jmp @e
+    {Z, Z, I}, {P, P, I}, {R, R, I}, // $bits, zer p, r
+    {B, Z, I}, {Z, P, 15}, // mov b p, jle b @le
+    {Z, P, I}, {M, P, I}, {Z, Z, 20}, // mov 2b + 1 p, jmp @loop
+    {M, P, 17}, {Z, Z, 20}, // $le, jle b + 1 @neg, b = 0 is p = 1, jmp @loop
+    {Z, P, I}, {M, R, I}, {Z, Z, I}, // $neg, mov 2b + 1 p, inc r
+    {M, S, 22}, {Z, Z, 29}, // $loop, inc s, jle s @body, jmp @end
+    {R, Z, I}, {Z, R, I}, {Z, Z, I}, // $body, add r r
+    {P, Z, 27}, {M, R, I}, // jge p @zero, inc r
+    {Z, P, I}, {Z, Z, 20}, // $zero, add p p, jmp @loop
+    {B, B, I}, {R, Z, I}, {Z, B, I} // $end, mov r b
+};
+static CodeGenType INST_JMP_code_gen[] = {{Z, Z, A}};
+static CodeGenType INST_JLE_code_gen[] = {{Z, Z, I}, {Z, A, B}};
+static CodeGenType INST_JLZ_code_gen[] = {{Z, Z, I}, {P, P, I}, {A, P, I}, {Z, P, E}, {Z, Z, B}};
+static CodeGenType INST_JEZ_code_gen[] = {{Z, Z, I}, {P, P, I}, {Z, A, 4}, {Z, Z, E}, {A, P, I}, {Z, P, B}};
+static CodeGenType INST_JGE_code_gen[] = {{Z, Z, I}, {P, P, I}, {A, P, I}, {Z, P, B}};
+static CodeGenType INST_JGZ_code_gen[] = {{Z, Z, I}, {Z, A, E}, {Z, Z, B}};
+static CodeGenType INST_SJP_code_gen[] = {{Z, Z, I}, {A, Z, I}, {B, B, I}, {Z, B, I}};
+static CodeGenType INST_LJP_code_gen[] = {{Z, Z, I}, {14, 14, I}, {A, Z, I}, {Z, 14, I}, {Z, Z, 0}};
+// cal is sjp to the word after it (a is its >n word) and jmp, ret halts until a cal writes where it jumps
+static CodeGenType INST_CAL_code_gen[] = {{Z, Z, I}, {A, Z, I}, {B, B, I}, {Z, B, I}, {Z, Z, T}};
+static CodeGenType INST_RET_code_gen[] = {{Z, Z, N}};
+// jtb loads the entry at b (the address of its table) + a into its jump, like ldx into the c of ljp
+static CodeGenType INST_JTB_code_gen[] = {
+    {Z, Z, I}, {21, 21, I}, {29, 29, I},
+    {A, Z, I}, {B, Z, I}, {Z, 21, I}, {Z, Z, I}, // the address of the entry into the read
+    {0, Z, I}, {Z, 29, I}, // the entry into the jump
+    {Z, Z, 0}
+};
+static CodeGenType INST_MOV_code_gen[] = {{Z, Z, I}, {A, Z, I}, {B, B, I}, {Z, B, I}};
+static CodeGenType INST_ADR_code_gen[] = {{Z, Z, I}, {A, Z, I}, {B, B, I}, {Z, B, I}};
+static CodeGenType INST_DRD_code_gen[] = {{Z, Z, I}, {15, 15, I}, {A, Z, I}, {Z, 15, I}, {Z, Z, I}, {0, Z, I}, {B, B, I}, {Z, B, I}};
+static CodeGenType INST_DWT_code_gen[] = {{Z, Z, I}, {27, 27, I}, {28, 28, I}, {34, 34, I}, {B, Z, I}, {Z, 27, I}, {Z, 28, I}, {Z, 34, I}, {Z, Z, I}, {0, 0, I}, {A, Z, I}, {Z, 0, I}};
+// drd and dwt with the address summed straight into the patched words, no pointer variable to mov and add to first
+static CodeGenType INST_LDX_code_gen[] = {{Z, Z, I}, {18, 18, I}, {A, Z, I}, {B, Z, I}, {Z, 18, I}, {Z, Z, I}, {0, Z, I}, {T, T, I}, {Z, T, I}};
+static CodeGenType INST_STX_code_gen[] = {{Z, Z, I}, {30, 30, I}, {31, 31, I}, {37, 37, I}, {B, Z, I}, {T, Z, I}, {Z, 30, I}, {Z, 31, I}, {Z, 37, I}, {Z, Z, I}, {0, 0, I}, {A, Z, I}, {Z, 0, I}};
+// cpy and fil patch the addresses into the loop once and bump the patched words by 1 after every word,
+// q counts up from 1 - n to 1, nothing happens for n <= 0
+static CodeGenType INST_CPY_code_gen[] = {
+    {Z, Z, I}, {Q, Q, I}, {T, Q, I}, {Q, Z, E}, {M, Q, I}, // mov 1 - n q, jle n @e
+    {Z, Z, I}, {54, 54, I}, {57, 57, I}, {58, 58, I}, {61, 61, I}, // zer z and the address words
+    {A, Z, I}, {Z, 54, I}, {Z, Z, I}, // src into the read
+    {B, Z, I}, {Z, 57, I}, {Z, 58, I}, {Z, 61, I}, {Z, Z, I}, // dst into the write
+    {0, Z, I}, {0, 0, I}, {Z, 0, I}, {Z, Z, I}, // $loop, mov *src *dst
+    {M, 54, I}, {M, 57, I}, {M, 58, I}, {M, 61, I}, // inc src, inc dst
+    {M, Q, 18} // inc q, jle q @loop
+};
+static CodeGenType INST_FIL_code_gen[] = {
+    {Z, Z, I}, {Q, Q, I}, {T, Q, I}, {Q, Z, E}, {M, Q, I}, // mov 1 - n q, jle n @e
+    {Z, Z, I}, {R, R, I}, {A, R, I}, // mov -val r
+    {45, 45, I}, {46, 46, I}, {49, 49, I}, {B, Z, I}, {Z, 45, I}, {Z, 46, I}, {Z, 49, I}, // dst into the write
+    {0, 0, I}, {R, 0, I}, // $loop, mov val *dst
+    {M, 45, I}, {M, 46, I}, {M, 49, I}, // inc dst
+    {M, Q, 15} // inc q, jle q @loop
+};
+static CodeGenType INST_INP_code_gen[] = {{N, B, A}};
+static CodeGenType INST_OUT_code_gen[] = {{A, N, B}};
+static CodeGenType INST_HLT_code_gen[] = {{Z, Z, N}};
+
+// templates that are not an instruction of their own, choose_code_gen picks them for immediate operands
+typedef enum {
+    CODE_GEN_MOV_IMM = TOKEN__INST_END + 1, CODE_GEN_MOV_ZERO, CODE_GEN_FIL_ZERO, CODE_GEN_CAL_RET, CODE_GEN_JTB_CLAMP,
+    CODE_GEN_MUL_LOOP, CODE_GEN_DIV_LOOP, CODE_GEN_MOD_LOOP,
+    CODE_GEN_MUL_UNROLLED, CODE_GEN_DIV_UNROLLED, CODE_GEN_MOD_UNROLLED,
+    CODE_GEN__END
+} CodeGenVariant;
+static CodeGenType CODE_GEN_MOV_IMM_code_gen[] = {{B, B, I}, {A, B, I}}; // a is the constant -n
+static CodeGenType CODE_GEN_MOV_ZERO_code_gen[] = {{B, B, I}};
+static CodeGenType CODE_GEN_FIL_ZERO_code_gen[] = {
+    {Z, Z, I}, {Q, Q, I}, {T, Q, I}, {Q, Z, E}, {M, Q, I}, // mov 1 - n q, jle n @e
+    {Z, Z, I}, {33, 33, I}, {34, 34, I}, {B, Z, I}, {Z, 33, I}, {Z, 34, I}, // dst into the clear
+    {0, 0, I}, // $loop, zer *dst
+    {M, 33, I}, {M, 34, I}, // inc dst
+    {M, Q, 11} // inc q, jle q @loop
+};
+// cal of a link a ret jumps through, the return address goes straight into the jump of the ret
+static CodeGenType CODE_GEN_CAL_RET_code_gen[] = {{Z, Z, I}, {A, Z, I}, {L, L, I}, {Z, L, I}, {Z, Z, T}};
+// jtb with the index clamped to the table (--clamp-jtb), t holds 1 - the number of entries
+static CodeGenType CODE_GEN_JTB_CLAMP_code_gen[] = {
+    {Z, Z, I}, {P, P, I}, {A, Z, I}, {Z, P, 17}, // mov a p, jle p @low
+    {Z, Z, I}, {Q, Q, I}, {T, Q, I}, {P, Q, 19}, // jle n - 1 - p @high
+    {42, 42, I}, {50, 50, I}, // $index
+    {P, Z, I}, {B, Z, I}, {Z, 42, I}, {Z, Z, I},
+    {0, Z, I}, {Z, 50, I},
+    {Z, Z, 0},
+    {Z, Z, I}, {P, P, 8}, // $low, zer p, jmp @index
+    {P, P, I}, {T, P, I}, {Z, Z, 8} // $high, mov n - 1 p, jmp @index
+};
+// the original mul, div and mod that loop |a| or quotient many times (--loop-muldiv), fewer steps for small values
+static CodeGenType CODE_GEN_MUL_LOOP_code_gen[] = {
     {S, S, I}, {Q, Q, I},  // zer s, q
     {Z, Z, I}, {Z, A, 7}, // jle a @neg_q
     {A, Z, I}, {Z, Q, I}, // mov a q
@@ -117,7 +358,7 @@ static CodeGenType INST_MUL_code_gen[] = {
     {Z, S, E}, // $end, jle s @no_neg_b
     {P, P, I}, {B, P, I}, {P, Z, I}, {B, B, I}, {Z, B, I} // neg b, $no_neg_b
 };
-static CodeGenType INST_DIV_code_gen[] = {
+static CodeGenType CODE_GEN_DIV_LOOP_code_gen[] = {
     {S, S, I}, {Q, Q, I}, {R, R, I}, // zer s, q, r
     {Z, Z, I}, {Z, A, 8}, // jle a @neg_q
     {A, Z, I}, {Z, Q, I}, // mov a q
@@ -134,7 +375,7 @@ static CodeGenType INST_DIV_code_gen[] = {
     {Z, S, E}, // $end, jle s @no_neg_b
     {P, P, I}, {B, P, I}, {P, Z, I}, {B, B, I}, {Z, B, I} // neg b, $no_neg_b
 };
-static CodeGenType INST_MOD_code_gen[] = {
+static CodeGenType CODE_GEN_MOD_LOOP_code_gen[] = {
     {S, S, I}, {Q, Q, I}, {R, R, I}, // zer s, q, r
     {Z, Z, I}, {Z, A, 8}, // jle a @neg_q
     {A, Z, I}, {Z, Q, I}, // mov a q
@@ -152,21 +393,6 @@ static CodeGenType INST_MOD_code_gen[] = {
     {Z, Z, E},  // jmp @e
     {R, Z, I}, {Z, B, I}, // $neg_b, mov r b
 };
-static CodeGenType INST_JMP_code_gen[] = {{Z, Z, A}};
-static CodeGenType INST_JLE_code_gen[] = {{Z, Z, I}, {Z, A, B}};
-static CodeGenType INST_JLZ_code_gen[] = {{Z, Z, I}, {P, P, I}, {A, P, I}, {Z, P, E}, {Z, Z, B}};
-static CodeGenType INST_JEZ_code_gen[] = {{Z, Z, I}, {P, P, I}, {Z, A, 4}, {Z, Z, E}, {A, P, I}, {Z, P, B}};
-static CodeGenType INST_JGE_code_gen[] = {{Z, Z, I}, {P, P, I}, {A, P, I}, {Z, P, B}};
-static CodeGenType INST_JGZ_code_gen[] = {{Z, Z, I}, {Z, A, E}, {Z, Z, B}};
-static CodeGenType INST_SJP_code_gen[] = {{Z, Z, I}, {A, Z, I}, {B, B, I}, {Z, B, I}};
-static CodeGenType INST_LJP_code_gen[] = {{Z, Z, I}, {14, 14, I}, {A, Z, I}, {Z, 14, I}, {Z, Z, 0}};
-static CodeGenType INST_MOV_code_gen[] = {{Z, Z, I}, {A, Z, I}, {B, B, I}, {Z, B, I}};
-static CodeGenType INST_ADR_code_gen[] = {{Z, Z, I}, {A, Z, I}, {B, B, I}, {Z, B, I}};
-static CodeGenType INST_DRD_code_gen[] = {{Z, Z, I}, {15, 15, I}, {A, Z, I}, {Z, 15, I}, {Z, Z, I}, {0, Z, I}, {B, B, I}, {Z, B, I}};
-static CodeGenType INST_DWT_code_gen[] = {{Z, Z, I}, {27, 27, I}, {28, 28, I}, {34, 34, I}, {B, Z, I}, {Z, 27, I}, {Z, 28, I}, {Z, 34, I}, {Z, Z, I}, {0, 0, I}, {A, Z, I}, {Z, 0, I}};
-static CodeGenType INST_INP_code_gen[] = {{N, B, A}};
-static CodeGenType INST_OUT_code_gen[] = {{A, N, B}};
-static CodeGenType INST_HLT_code_gen[] = {{Z, Z, N}};
 
 static size_t inst_code_gen_sizes[256] = {
     [TOKEN_INST_ZER] = (sizeof(INST_ZER_code_gen)/sizeof(CodeGenType)), 
@@ -178,6 +404,11 @@ static size_t inst_code_gen_sizes[256] = {
     [TOKEN_INST_MUL] = (sizeof(INST_MUL_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_DIV] = (sizeof(INST_DIV_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_MOD] = (sizeof(INST_MOD_code_gen)/sizeof(CodeGenType)), 
+    [TOKEN_INST_AND] = (sizeof(INST_AND_code_gen)/sizeof(CodeGenType)), 
+    [TOKEN_INST_OR] = (sizeof(INST_OR_code_gen)/sizeof(CodeGenType)), 
+    [TOKEN_INST_XOR] = (sizeof(INST_XOR_code_gen)/sizeof(CodeGenType)), 
+    [TOKEN_INST_SHL] = (sizeof(INST_SHL_code_gen)/sizeof(CodeGenType)), 
+    [TOKEN_INST_SHR] = (sizeof(INST_SHR_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_JMP] = (sizeof(INST_JMP_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_JLE] = (sizeof(INST_JLE_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_JLZ] = (sizeof(INST_JLZ_code_gen)/sizeof(CodeGenType)), 
@@ -186,13 +417,28 @@ static size_t inst_code_gen_sizes[256] = {
     [TOKEN_INST_JGZ] = (sizeof(INST_JGZ_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_SJP] = (sizeof(INST_SJP_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_LJP] = (sizeof(INST_LJP_code_gen)/sizeof(CodeGenType)), 
+    [TOKEN_INST_CAL] = (sizeof(INST_CAL_code_gen)/sizeof(CodeGenType)), 
+    [TOKEN_INST_RET] = (sizeof(INST_RET_code_gen)/sizeof(CodeGenType)), 
+    [TOKEN_INST_JTB] = (sizeof(INST_JTB_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_MOV] = (sizeof(INST_MOV_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_ADR] = (sizeof(INST_ADR_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_DRD] = (sizeof(INST_DRD_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_DWT] = (sizeof(INST_DWT_code_gen)/sizeof(CodeGenType)), 
+    [TOKEN_INST_LDX] = (sizeof(INST_LDX_code_gen)/sizeof(CodeGenType)), 
+    [TOKEN_INST_STX] = (sizeof(INST_STX_code_gen)/sizeof(CodeGenType)), 
+    [TOKEN_INST_CPY] = (sizeof(INST_CPY_code_gen)/sizeof(CodeGenType)), 
+    [TOKEN_INST_FIL] = (sizeof(INST_FIL_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_INP] = (sizeof(INST_INP_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_OUT] = (sizeof(INST_OUT_code_gen)/sizeof(CodeGenType)), 
     [TOKEN_INST_HLT] = (sizeof(INST_HLT_code_gen)/sizeof(CodeGenType)),
+    [CODE_GEN_MOV_IMM] = (sizeof(CODE_GEN_MOV_IMM_code_gen)/sizeof(CodeGenType)),
+    [CODE_GEN_MOV_ZERO] = (sizeof(CODE_GEN_MOV_ZERO_code_gen)/sizeof(CodeGenType)),
+    [CODE_GEN_FIL_ZERO] = (sizeof(CODE_GEN_FIL_ZERO_code_gen)/sizeof(CodeGenType)),
+    [CODE_GEN_CAL_RET] = (sizeof(CODE_GEN_CAL_RET_code_gen)/sizeof(CodeGenType)),
+    [CODE_GEN_JTB_CLAMP] = (sizeof(CODE_GEN_JTB_CLAMP_code_gen)/sizeof(CodeGenType)),
+    [CODE_GEN_MUL_LOOP] = (sizeof(CODE_GEN_MUL_LOOP_code_gen)/sizeof(CodeGenType)),
+    [CODE_GEN_DIV_LOOP] = (sizeof(CODE_GEN_DIV_LOOP_code_gen)/sizeof(CodeGenType)),
+    [CODE_GEN_MOD_LOOP] = (sizeof(CODE_GEN_MOD_LOOP_code_gen)/sizeof(CodeGenType)),
 };
 
 static CodeGenType* inst_code_gen[256] = {
@@ -205,6 +451,11 @@ static CodeGenType* inst_code_gen[256] = {
     [TOKEN_INST_MUL] = INST_MUL_code_gen,
     [TOKEN_INST_DIV] = INST_DIV_code_gen,
     [TOKEN_INST_MOD] = INST_MOD_code_gen,
+    [TOKEN_INST_AND] = INST_AND_code_gen,
+    [TOKEN_INST_OR] = INST_OR_code_gen,
+    [TOKEN_INST_XOR] = INST_XOR_code_gen,
+    [TOKEN_INST_SHL] = INST_SHL_code_gen,
+    [TOKEN_INST_SHR] = INST_SHR_code_gen,
     [TOKEN_INST_JMP] = INST_JMP_code_gen,
     [TOKEN_INST_JLE] = INST_JLE_code_gen,
     [TOKEN_INST_JLZ] = INST_JLZ_code_gen,
@@ -213,78 +464,648 @@ static CodeGenType* inst_code_gen[256] = {
     [TOKEN_INST_JGZ] = INST_JGZ_code_gen,
     [TOKEN_INST_SJP] = INST_SJP_code_gen,
     [TOKEN_INST_LJP] = INST_LJP_code_gen,
+    [TOKEN_INST_CAL] = INST_CAL_code_gen,
+    [TOKEN_INST_RET] = INST_RET_code_gen,
+    [TOKEN_INST_JTB] = INST_JTB_code_gen,
     [TOKEN_INST_MOV] = INST_MOV_code_gen,
     [TOKEN_INST_ADR] = INST_ADR_code_gen,
     [TOKEN_INST_DRD] = INST_DRD_code_gen,
     [TOKEN_INST_DWT] = INST_DWT_code_gen,
+    [TOKEN_INST_LDX] = INST_LDX_code_gen,
+    [TOKEN_INST_STX] = INST_STX_code_gen,
+    [TOKEN_INST_CPY] = INST_CPY_code_gen,
+    [TOKEN_INST_FIL] = INST_FIL_code_gen,
     [TOKEN_INST_INP] = INST_INP_code_gen,
     [TOKEN_INST_OUT] = INST_OUT_code_gen,
     [TOKEN_INST_HLT] = INST_HLT_code_gen,
+    [CODE_GEN_MOV_IMM] = CODE_GEN_MOV_IMM_code_gen,
+    [CODE_GEN_MOV_ZERO] = CODE_GEN_MOV_ZERO_code_gen,
+    [CODE_GEN_FIL_ZERO] = CODE_GEN_FIL_ZERO_code_gen,
+    [CODE_GEN_CAL_RET] = CODE_GEN_CAL_RET_code_gen,
+    [CODE_GEN_JTB_CLAMP] = CODE_GEN_JTB_CLAMP_code_gen,
+    [CODE_GEN_MUL_LOOP] = CODE_GEN_MUL_LOOP_code_gen,
+    [CODE_GEN_DIV_LOOP] = CODE_GEN_DIV_LOOP_code_gen,
+    [CODE_GEN_MOD_LOOP] = CODE_GEN_MOD_LOOP_code_gen,
 };
 
-static inline void tokenize(void) {
-    PICOCT_tokenize(&ctx);
-    if (ctx.token_type == PICOCT_EOS) token = TOKEN_EOS;
-    else if (ctx.token_type == PICOCT_IDENTIFIER) token = TOKEN_IDENTIFIER;
-    else if (ctx.token_type == PICOCT_NUMBER) {
-        token = TOKEN_NUMBER;
-        token_number = (WORD_UTYPE)(WORD_STYPE)(ctx.token_number);
-    }
-    else if (ctx.token_type == PICOCT_MATCH && ctx.match_type == TOKEN_HYPHEN) { 
-        PICOCT_tokenize(&ctx);
-        if (ctx.token_type != PICOCT_NUMBER) { token = TOKEN_UNKNOWN; return; }
-        token = TOKEN_NUMBER;
-        token_number = (WORD_UTYPE)(WORD_STYPE)(-ctx.token_number);
+// templates generated for mul, div and mod by an immediate take the free slots of the tables above
+#define MAX_LOWERED_SIZE 256
+#define MAX_CODE_GEN_CONSTANTS 64
+typedef struct {
+    TokenType inst;
+    WORD_UTYPE number;
+    WORD_UTYPE constants[MAX_CODE_GEN_CONSTANTS];
+    size_t constants_count;
+} GeneratedCodeGen;
+static GeneratedCodeGen generated_code_gen[256 - CODE_GEN__END];
+static size_t generated_code_gen_count = 0;
+
+static inline uint16_t generated_constant(GeneratedCodeGen* generated, WORD_UTYPE number) {
+    for (size_t i = 0; i < generated->constants_count; ++i) if (generated->constants[i] == number) return (uint16_t)(K + i);
+    generated->constants[generated->constants_count] = number;
+    return (uint16_t)(K + generated->constants_count++);
+}
+
+// mul by a constant is a chain of {B, Z, I} and {Z, B, I}: with b = x * b0 and z = -y * b0 they add x to y and y to x,
+// so from (1, 0) they reach every coprime pair in as many steps as the quotients of euclid's algorithm on it add up to.
+// the constant n is x (or y for a negative constant, then it is moved from z to b) and the cheapest partner is searched
+static inline size_t mul_chain_steps(uint32_t x, uint32_t y) {
+    size_t steps = 0;
+    while (y) {
+        if (x > y) {
+            uint32_t q = x / y;
+            if (x % y == 0) { if (y != 1) return SIZE_MAX; q = x - 1; }
+            x -= q * y;
+            steps += q;
+        }
+        else {
+            if (!x) return SIZE_MAX;
+            uint32_t q = y / x;
+            if (y % x == 0) { if (x != 1) return SIZE_MAX; q = y; }
+            y -= q * x;
+            steps += q;
+        }
     }
-    else if (ctx.token_type == PICOCT_MATCH && ctx.match_type == TOKEN_LABEL_DECL) { 
-        PICOCT_tokenize(&ctx);
-        if (ctx.token_type != PICOCT_IDENTIFIER) { token = TOKEN_UNKNOWN; return; }
-        token = TOKEN_LABEL_DECL;
+    return x == 1 ? steps : SIZE_MAX;
+}
+static inline size_t mul_chain_partner(uint32_t n, bool n_is_x, size_t* best_steps) {
+    size_t best = 0;
+    *best_steps = SIZE_MAX;
+    for (uint32_t partner = 0; partner <= n; ++partner) {
+        size_t steps = n_is_x ? mul_chain_steps(n, partner) : mul_chain_steps(partner, n);
+        if (steps < *best_steps) { *best_steps = steps; best = partner; }
     }
-    else if (ctx.token_type == PICOCT_MATCH && ctx.match_type == TOKEN_LABEL_USE) { 
-        PICOCT_tokenize(&ctx);
-        if (ctx.token_type != PICOCT_IDENTIFIER) { token = TOKEN_UNKNOWN; return; }
-        token = TOKEN_LABEL_USE;
+    return best;
+}
+// writes the chain from (1, 0) to (x, y), going back from (x, y) gives the steps in reverse
+static inline size_t mul_chain(CodeGenType* code, uint32_t x, uint32_t y) {
+    size_t steps = mul_chain_steps(x, y);
+    size_t i = steps;
+    while (y) {
+        if (x > y) { x -= y; code[--i] = (CodeGenType){Z, B, I}; }
+        else { y -= x; code[--i] = (CodeGenType){B, Z, I}; }
     }
-    else if (ctx.token_type == PICOCT_MATCH) token = ctx.match_type;
-    else token = TOKEN_UNKNOWN;
+    return steps;
+}
+static inline size_t generate_mul_code_gen(CodeGenType* code, WORD_UTYPE number) {
+    size_t x_steps, y_steps;
+    uint32_t x_partner = (uint32_t)mul_chain_partner(number, true, &x_steps);
+    uint32_t y_partner = (uint32_t)mul_chain_partner((WORD_UTYPE)-number, false, &y_steps);
+    size_t size = 0;
+    if (x_steps == 0) return 0;
+    code[size++] = (CodeGenType){Z, Z, I};
+    if (x_steps + 2 <= y_steps + 7) {
+        size += mul_chain(code + size, number, x_partner);
+    }
+    else {
+        code[size++] = (CodeGenType){P, P, I};
+        size += mul_chain(code + size, y_partner, (WORD_UTYPE)-number);
+        code[size++] = (CodeGenType){Z, P, I}; // mov -z b
+        code[size++] = (CodeGenType){B, B, I};
+        code[size++] = (CodeGenType){P, B, I};
+        code[size++] = (CodeGenType){P, P, I};
+    }
+    code[size++] = (CodeGenType){Z, Z, I};
+    return size;
 }
 
-// hash table interface - assosiative array for now
-#define HTI_SIZE 256
-char hti_ar_str[HTI_SIZE][MAX_IDENTIFIER_LENGTH] = {0};
-WORD_UTYPE hti_ar_val[HTI_SIZE] = {0};
-static inline void hti_set(const char* identifier, WORD_UTYPE value) {
-    for (size_t i = 0; i < HTI_SIZE; i++) {
-        if (hti_ar_str[i][0] == '\0') {
-            strcpy(hti_ar_str[i], identifier);
-            hti_ar_val[i] = value;
-            return;
-        }
-        else if (strcmp(hti_ar_str[i], identifier) == 0) {
-            hti_ar_val[i] = value;
-            return;
-        }
+// div and mod by a constant d (|d| >= 2) keep z = -|b| and try to take every multiple c = |d| << i that fits in a word
+// from the top: z += c is <= 0 exactly when |b| >= c, else it is undone with z -= c (which always jumps as z <= 0).
+// the quotient collects in q as -q, s is 1 for b > 0 and b = 0 leaves right away
+static inline size_t generate_divmod_code_gen(CodeGenType* code, GeneratedCodeGen* generated, TokenType inst, WORD_UTYPE number) {
+    bool div = inst == TOKEN_INST_DIV;
+    bool negative = (WORD_STYPE)number < 0;
+    uint32_t d = negative ? (WORD_UTYPE)-number : number;
+    int top = 0;
+    while ((d << (top + 1)) <= 32768u) ++top;
+    size_t size = 0;
+    code[size++] = (CodeGenType){Z, Z, I};
+    code[size++] = (CodeGenType){P, P, I};
+    if (div) code[size++] = (CodeGenType){Q, Q, I};
+    code[size++] = (CodeGenType){S, S, I};
+    size_t jle_b = size++; // jle b @neg_b
+    code[size++] = (CodeGenType){B, Z, I}; // mov -b z
+    code[size++] = (CodeGenType){M, S, I}; // inc s
+    size_t steps = size;
+    for (int i = top; i >= 0; --i) {
+        WORD_UTYPE c = (WORD_UTYPE)(d << i);
+        uint16_t next = (uint16_t)(size + (div ? 3 : 2));
+        code[size] = (CodeGenType){generated_constant(generated, (WORD_UTYPE)-c), Z, (uint16_t)(size + 2)}; // add c z, jle z @taken
+        code[size + 1] = (CodeGenType){generated_constant(generated, c), Z, next}; // sub c z, jmp @next
+        if (div) code[size + 2] = (CodeGenType){generated_constant(generated, (WORD_UTYPE)(1u << i)), Q, I}; // $taken, sub 1 << i q
+        size += div ? 3 : 2;
     }
-    PICOCT_error_printf(&ctx, "Symbol table full");
+    // $end, s <= 0 for b < 0
+    if (div) code[size++] = (CodeGenType){Z, Z, I};
+    code[size++] = (CodeGenType){P, P, I};
+    code[size++] = (CodeGenType){B, B, I};
+    size_t jle_s = size++;
+    for (int b_negative = 0; b_negative <= 1; ++b_negative) {
+        if (b_negative) code[jle_s] = (CodeGenType){P, S, (uint16_t)size};
+        if (div && (b_negative != negative)) { code[size++] = (CodeGenType){Q, P, I}; code[size++] = (CodeGenType){P, B, E}; } // mov -quotient b
+        else if (div) { code[size++] = (CodeGenType){Q, B, I}; code[size++] = (CodeGenType){Z, Z, E}; } // mov quotient b
+        else if (b_negative) { code[size++] = (CodeGenType){Z, P, I}; code[size++] = (CodeGenType){P, B, E}; } // mov -remainder b
+        else { code[size++] = (CodeGenType){Z, B, I}; code[size++] = (CodeGenType){Z, Z, E}; } // mov remainder b
+    }
+    code[jle_b] = (CodeGenType){Z, B, (uint16_t)size};
+    code[size] = (CodeGenType){M, B, (uint16_t)(size + 2)}; // $neg_b, jle b + 1 @real (b < 0)
+    code[size + 1] = (CodeGenType){O, B, E}; // b = 0, dec b, jmp @e
+    code[size + 2] = (CodeGenType){O, B, I}; // $real, dec b
+    code[size + 3] = (CodeGenType){B, P, I};
+    code[size + 4] = (CodeGenType){P, Z, (uint16_t)steps}; // mov b z, jmp @steps
+    return size + 5;
+}
+
+// shr by a constant n (1 to WORD_SIZE - 1) is a div of the low bits by 1 << n the way above: z = -b, or -(b + 32768) with
+// 1 << (15 - n) already in -q for b < 0, takes every 1 << (n + i) that fits from the top and q collects -(b >> n)
+static inline size_t generate_shr_code_gen(CodeGenType* code, GeneratedCodeGen* generated, WORD_UTYPE number) {
+    size_t size = 0;
+    code[size++] = (CodeGenType){Z, Z, I};
+    code[size++] = (CodeGenType){Q, Q, I};
+    code[size++] = (CodeGenType){Z, B, 4}; // jle b @neg_b
+    code[size++] = (CodeGenType){B, Z, 10}; // mov -b z, jmp @steps
+    code[size++] = (CodeGenType){M, B, 6}; // $neg_b, jle b + 1 @real (b < 0)
+    code[size++] = (CodeGenType){O, B, E}; // b = 0, dec b, jmp @e
+    code[size++] = (CodeGenType){O, B, I}; // $real, dec b
+    code[size++] = (CodeGenType){B, Z, I};
+    code[size++] = (CodeGenType){generated_constant(generated, (WORD_UTYPE)1 << (WORD_SIZE - 1)), Z, I}; // mov -(b + 32768) z
+    code[size++] = (CodeGenType){generated_constant(generated, (WORD_UTYPE)1 << (WORD_SIZE - 1 - number)), Q, I};
+    for (int i = WORD_SIZE - 2 - number; i >= 0; --i) { // $steps
+        WORD_UTYPE c = (WORD_UTYPE)(1u << (number + i));
+        code[size] = (CodeGenType){generated_constant(generated, (WORD_UTYPE)-c), Z, (uint16_t)(size + 2)}; // add c z, jle z @taken
+        code[size + 1] = (CodeGenType){generated_constant(generated, c), Z, (uint16_t)(size + 3)}; // sub c z, jmp @next
+        code[size + 2] = (CodeGenType){generated_constant(generated, (WORD_UTYPE)(1u << i)), Q, I}; // $taken, sub 1 << i q
+        size += 3;
+    }
+    code[size++] = (CodeGenType){B, B, I};
+    code[size++] = (CodeGenType){Q, B, I}; // mov -q b
+    return size;
+}
+
+// the template of an immediate mul, div, mod or shr, generated the first time it is asked for, or 0 to use the generic one
+static inline size_t generated_code_gen_for(TokenType inst, WORD_UTYPE number) {
+    for (size_t i = 0; i < generated_code_gen_count; ++i) {
+        if (generated_code_gen[i].inst == inst && generated_code_gen[i].number == number) return CODE_GEN__END + i;
+    }
+    if (generated_code_gen_count == sizeof(generated_code_gen) / sizeof(generated_code_gen[0])) return 0;
+    GeneratedCodeGen* generated = &generated_code_gen[generated_code_gen_count];
+    *generated = (GeneratedCodeGen){inst, number, {0}, 0};
+    CodeGenType code[MAX_LOWERED_SIZE];
+    size_t size;
+    if (inst == TOKEN_INST_MUL) size = generate_mul_code_gen(code, number);
+    else if (inst == TOKEN_INST_SHR) size = generate_shr_code_gen(code, generated, number);
+    else size = generate_divmod_code_gen(code, generated, inst, number);
+    size_t code_gen = CODE_GEN__END + generated_code_gen_count++;
+    inst_code_gen[code_gen] = malloc(size ? size * sizeof(CodeGenType) : 1);
+    if (!inst_code_gen[code_gen]) { fprintf(stderr, "Code gen memory alloc failed\n"); exit(1); }
+    memcpy(inst_code_gen[code_gen], code, size * sizeof(CodeGenType));
+    inst_code_gen_sizes[code_gen] = size;
+    return code_gen;
 }
-static inline void hti_get(const char* identifier, WORD_UTYPE* value) {
-    for (size_t i = 0; i < HTI_SIZE; i++) {
-        if (strcmp(hti_ar_str[i], identifier) == 0) {
-            *value = hti_ar_val[i];
-            return;
+static inline GeneratedCodeGen* generated_code_gen_of(size_t code_gen) {
+    return code_gen >= CODE_GEN__END ? &generated_code_gen[code_gen - CODE_GEN__END] : NULL;
+}
+
+// the speed forms of mul, div and mod (--profile picks them for hot instructions) unroll the bit loop into WORD_SIZE - 1 copies,
+// which saves counting and testing s on every bit for about 4 times the size. the code around the loop stays the same
+static inline size_t generate_unrolled_mul(CodeGenType* code) {
+    static const CodeGenType head[] = {
+        {Z, Z, I}, {Q, Q, I}, {R, R, I}, // zer q, r
+        {B, R, I}, // mov -b r
+        {Z, A, 10}, // jle a @top
+        {A, Z, I}, {Z, Q, I}, {Z, Q, I}, {M, Q, I}, // mov 2a + 1 q, the 1 marks the end of the bits
+        {B, B, 17}, // zer b, jmp @bits
+        {A, Z, I}, {Z, Q, I}, {M, Q, 14}, // $top, jle a + 1 @set
+        {B, B, E}, // a = 0, zer b, jmp @e
+        {Z, Q, I}, // $set, mov 2a + 1 q
+        {B, B, I}, {R, B, I}, // mov b b
+        {Z, Z, I}, // $bits
+    };
+    size_t size = sizeof(head) / sizeof(head[0]);
+    memcpy(code, head, sizeof(head));
+    for (int bit = 1; bit < WORD_SIZE; ++bit) {
+        code[size++] = (CodeGenType){B, Z, I}; code[size++] = (CodeGenType){Z, B, I}; code[size++] = (CodeGenType){Z, Z, I}; // add b b
+        code[size] = (CodeGenType){Q, Z, (uint16_t)(size + 2)}; // jge q @no_bit
+        code[size + 1] = (CodeGenType){R, B, I}; // add b_orig b
+        size += 2;
+        if (bit < WORD_SIZE - 1) code[size++] = (CodeGenType){Z, Q, I}; // $no_bit, add q q
+        code[size++] = (CodeGenType){Z, Z, I};
+    }
+    return size;
+}
+// div and mod: [0, init2) is the setup up to where s was set, [special, end) the b = 0 / -32768 case,
+// [end, pos) the sign of the result up to its jump to e and [pos, size) the rest. a bit keeps z = -x like the loop,
+// for a = 0 it goes on to $one instead of leaving, which ends just as unspecified
+static inline size_t generate_unrolled_divmod(CodeGenType* code, const CodeGenType* loop, size_t loop_size, size_t init2, size_t special, size_t end, size_t pos) {
+    size_t bits_end = init2 + (WORD_SIZE - 1) * 13;
+    size_t new_end = bits_end + 1, new_special = new_end + (pos - end), new_pos = new_special + (end - special);
+    size_t size = init2;
+    for (size_t bit = 1; bit < WORD_SIZE; ++bit) {
+        code[size + 0] = (CodeGenType){Q, Z, I}; code[size + 1] = (CodeGenType){O, Z, I};
+        code[size + 2] = (CodeGenType){Z, R, I}; code[size + 3] = (CodeGenType){Z, Z, I}; // x = 2x - |a| + 1
+        code[size + 4] = (CodeGenType){B, Z, (uint16_t)(size + 6)}; code[size + 5] = (CodeGenType){O, R, I}; // jge b @no_bit, dec x
+        code[size + 6] = (CodeGenType){Z, B, I}; code[size + 7] = (CodeGenType){Z, Z, I}; // $no_bit, add b b
+        code[size + 8] = (CodeGenType){R, Z, (uint16_t)(size + 12)}; // jge x @one
+        code[size + 9] = (CodeGenType){Z, Z, I}; code[size + 10] = (CodeGenType){Q, R, I}; // add |a| x
+        code[size + 11] = (CodeGenType){R, Z, (uint16_t)(size + 13)}; // jge x @next
+        code[size + 12] = (CodeGenType){M, B, I}; // $one, inc b
+        size += 13;
+    }
+    code[bits_end] = (CodeGenType){Z, Z, I}; // the loop left through a jmp, the code after it reads z as 0
+    for (size_t i = 0; i < loop_size; ++i) {
+        size_t at;
+        if (i < init2) at = i;
+        else if (i >= special && i < end) at = new_special + (i - special);
+        else if (i >= end && i < pos) at = new_end + (i - end);
+        else if (i >= pos) at = new_pos + (i - pos);
+        else continue;
+        CodeGenType copied = loop[i];
+        if (copied.c < I) {
+            if (copied.c >= special && copied.c < end) copied.c = (uint16_t)(new_special + (copied.c - special));
+            else if (copied.c >= end && copied.c < pos) copied.c = (uint16_t)(new_end + (copied.c - end));
+            else if (copied.c >= pos) copied.c = (uint16_t)(new_pos + (copied.c - pos));
         }
+        code[at] = copied;
     }
+    return new_pos + (loop_size - pos);
+}
+// the speed form of a generic mul, div or mod, generated the first time it is asked for
+static inline size_t unrolled_code_gen_for(size_t code_gen) {
+    size_t unrolled;
+    if (code_gen == TOKEN_INST_MUL) unrolled = CODE_GEN_MUL_UNROLLED;
+    else if (code_gen == TOKEN_INST_DIV) unrolled = CODE_GEN_DIV_UNROLLED;
+    else if (code_gen == TOKEN_INST_MOD) unrolled = CODE_GEN_MOD_UNROLLED;
+    else return code_gen;
+    if (inst_code_gen[unrolled]) return unrolled;
+    CodeGenType code[MAX_LOWERED_SIZE];
+    size_t size;
+    if (unrolled == CODE_GEN_MUL_UNROLLED) size = generate_unrolled_mul(code);
+    else if (unrolled == CODE_GEN_DIV_UNROLLED) size = generate_unrolled_divmod(code, INST_DIV_code_gen, inst_code_gen_sizes[TOKEN_INST_DIV], 26, 45, 54, 59);
+    else size = generate_unrolled_divmod(code, INST_MOD_code_gen, inst_code_gen_sizes[TOKEN_INST_MOD], 25, 44, 53, 60);
+    inst_code_gen[unrolled] = malloc(size * sizeof(CodeGenType));
+    if (!inst_code_gen[unrolled]) { fprintf(stderr, "Code gen memory alloc failed\n"); exit(1); }
+    memcpy(inst_code_gen[unrolled], code, size * sizeof(CodeGenType));
+    inst_code_gen_sizes[unrolled] = size;
+    return unrolled;
 }
-static inline bool hti_exist(const char* identifier) {
-    for (size_t i = 0; i < HTI_SIZE; i++) {
-        if (strcmp(hti_ar_str[i], identifier) == 0) return true;
+
+// immediate a operands of add, sub and mov don't need to go through Z: adding n is subtracting the constant -n
+// and mov clears b and subtracts -n (or only clears it for 0), first_pass creates the constant the choice reads
+typedef struct {
+    size_t code_gen;
+    bool immediate;
+    WORD_UTYPE constant;
+} CodeGenChoice;
+
+static bool loop_muldiv = false;
+static bool clamp_jtb = false;
+
+static inline CodeGenChoice choose_code_gen(TokenType inst, bool immediate, WORD_UTYPE number) {
+    if (loop_muldiv && inst == TOKEN_INST_MUL) return (CodeGenChoice){CODE_GEN_MUL_LOOP, immediate, number};
+    if (loop_muldiv && inst == TOKEN_INST_DIV) return (CodeGenChoice){CODE_GEN_DIV_LOOP, immediate, number};
+    if (loop_muldiv && inst == TOKEN_INST_MOD) return (CodeGenChoice){CODE_GEN_MOD_LOOP, immediate, number};
+    if (clamp_jtb && inst == TOKEN_INST_JTB) return (CodeGenChoice){CODE_GEN_JTB_CLAMP, false, 0};
+    if (!immediate) return (CodeGenChoice){inst, false, 0};
+    if (inst == TOKEN_INST_MUL && number == 0) return (CodeGenChoice){CODE_GEN_MOV_ZERO, true, 0};
+    if (inst == TOKEN_INST_MOD && (number == 1 || number == (WORD_UTYPE)-1)) return (CodeGenChoice){CODE_GEN_MOV_ZERO, true, 0};
+    if (inst == TOKEN_INST_DIV && (number == 1 || number == (WORD_UTYPE)-1)) inst = TOKEN_INST_MUL;
+    if ((inst == TOKEN_INST_MUL || ((inst == TOKEN_INST_DIV || inst == TOKEN_INST_MOD) && number != 0))) {
+        size_t code_gen = generated_code_gen_for(inst, number);
+        if (code_gen) return (CodeGenChoice){code_gen, true, number};
+    }
+    if ((inst == TOKEN_INST_SHL || inst == TOKEN_INST_SHR) && (WORD_STYPE)number >= WORD_SIZE) return (CodeGenChoice){CODE_GEN_MOV_ZERO, true, 0};
+    // a shift by 0 or less is a mul by 1, which is no code
+    if ((inst == TOKEN_INST_SHL || inst == TOKEN_INST_SHR) && (WORD_STYPE)number <= 0) number = 0, inst = TOKEN_INST_SHL;
+    if (inst == TOKEN_INST_SHL || inst == TOKEN_INST_SHR) {
+        size_t code_gen = inst == TOKEN_INST_SHL ? generated_code_gen_for(TOKEN_INST_MUL, (WORD_UTYPE)(1u << number)) : generated_code_gen_for(inst, number);
+        if (code_gen) return (CodeGenChoice){code_gen, true, number};
+    }
+    if (inst == TOKEN_INST_ADD) return (CodeGenChoice){TOKEN_INST_SUB, true, (WORD_UTYPE)-number};
+    if (inst == TOKEN_INST_MOV && number == 0) return (CodeGenChoice){CODE_GEN_MOV_ZERO, true, 0};
+    if (inst == TOKEN_INST_MOV) return (CodeGenChoice){CODE_GEN_MOV_IMM, true, (WORD_UTYPE)-number};
+    if (inst == TOKEN_INST_FIL && number == 0) return (CodeGenChoice){CODE_GEN_FIL_ZERO, true, 0};
+    return (CodeGenChoice){inst, true, number};
+}
+static inline bool code_gen_uses(size_t code_gen, uint16_t operand) {
+    for (size_t i = 0; i < inst_code_gen_sizes[code_gen]; ++i) {
+        CodeGenType code = inst_code_gen[code_gen][i];
+        if (code.a == operand || code.b == operand || code.c == operand) return true;
     }
     return false;
 }
 
+// zero register tracking - the scratch registers Z, P, Q, R and S are only written by code gen templates,
+// so which of them are known to be zero can be followed from template to template.
+// A template is lowered for the set known to be zero when it starts: a dataflow pass over its instructions
+// (including its own jumps and loops) finds the set at every instruction, clears {X, X, I} of a register that is
+// already zero there are dropped and the jumps and self modifying offsets of the rest are renumbered.
+// Labels reset the set since anything may jump there, the code start has every register zero from the header.
+typedef uint8_t ZeroSet;
+#define ZERO_ALL 0x1F
+
+typedef struct {
+    CodeGenType code[MAX_LOWERED_SIZE];
+    bool patched[MAX_LOWERED_SIZE * 3];
+    size_t size;
+    ZeroSet exit;
+} LoweredInst;
+
+static inline ZeroSet register_bit(uint16_t operand) {
+    switch (operand) {
+    case Z: return 1 << 0;
+    case P: return 1 << 1;
+    case Q: return 1 << 2;
+    case R: return 1 << 3;
+    case S: return 1 << 4;
+    default: return 0;
+    }
+}
+static inline ZeroSet zero_transfer(ZeroSet zero, CodeGenType code) {
+    ZeroSet written = register_bit(code.b);
+    if (!written) return zero;
+    if (code.a == code.b) return zero | written;
+    if (register_bit(code.a) & zero) return zero;
+    return zero & (ZeroSet)~written;
+}
+
+static inline void lower_code_gen(const CodeGenType* code, size_t size, ZeroSet entry, LoweredInst* lowered) {
+    // zero[i] is the set at instruction i, zero[size] the set at the end of the template
+    ZeroSet zero[MAX_LOWERED_SIZE + 1];
+    bool reached[MAX_LOWERED_SIZE + 1] = {0};
+    // numeric a and b are words of the template the code writes to, those fields are placeholders (e.g. the 0s in drd),
+    // instructions holding them must stay and their placeholder values are neither references nor jump targets
+    bool patched[MAX_LOWERED_SIZE * 3] = {0};
+    bool referenced[MAX_LOWERED_SIZE] = {0};
+    zero[0] = entry;
+    reached[0] = true;
+    for (size_t i = 0; i < size; ++i) {
+        if (code[i].a < I) patched[code[i].a] = true;
+        if (code[i].b < I) patched[code[i].b] = true;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (code[i].a < I && !patched[i * 3]) referenced[code[i].a / 3] = true;
+        if (code[i].b < I && !patched[i * 3 + 1]) referenced[code[i].b / 3] = true;
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < size; ++i) {
+            if (!reached[i]) continue;
+            ZeroSet out = zero_transfer(zero[i], code[i]);
+            size_t successors[2], successors_count = 0;
+            bool io = code[i].a == N || code[i].b == N;
+            if (io) successors[successors_count++] = i + 1;
+            else if (code[i].c == N) {}
+            else {
+                // a - a is 0 so {X, X, c} always jumps
+                if (code[i].a != code[i].b || code[i].c == I) successors[successors_count++] = i + 1;
+                if (code[i].c == E) successors[successors_count++] = size;
+                else if (code[i].c < I && !patched[i * 3 + 2]) successors[successors_count++] = code[i].c;
+            }
+            for (size_t j = 0; j < successors_count; ++j) {
+                size_t next = successors[j];
+                if (!reached[next]) { reached[next] = true; zero[next] = out; changed = true; }
+                else if ((zero[next] & out) != zero[next]) { zero[next] &= out; changed = true; }
+            }
+        }
+    }
+    size_t new_index[MAX_LOWERED_SIZE + 1];
+    bool keep[MAX_LOWERED_SIZE];
+    lowered->size = 0;
+    for (size_t i = 0; i < size; ++i) {
+        new_index[i] = lowered->size;
+        ZeroSet cleared = code[i].a == code[i].b && code[i].c == I ? register_bit(code[i].a) : 0;
+        keep[i] = !(cleared && reached[i] && (zero[i] & cleared) && !referenced[i]);
+        if (keep[i]) ++lowered->size;
+    }
+    new_index[size] = lowered->size;
+    for (size_t i = 0; i < size; ++i) {
+        if (!keep[i]) continue;
+        CodeGenType renumbered = code[i];
+        if (renumbered.a < I && !patched[i * 3]) renumbered.a = (uint16_t)(new_index[renumbered.a / 3] * 3 + renumbered.a % 3);
+        if (renumbered.b < I && !patched[i * 3 + 1]) renumbered.b = (uint16_t)(new_index[renumbered.b / 3] * 3 + renumbered.b % 3);
+        if (renumbered.c < I && !patched[i * 3 + 2] && renumbered.a != N && renumbered.b != N) renumbered.c = (uint16_t)new_index[renumbered.c];
+        lowered->code[new_index[i]] = renumbered;
+        for (size_t field = 0; field < 3; ++field) lowered->patched[new_index[i] * 3 + field] = patched[i * 3 + field];
+    }
+    // nothing falls out of the end (e.g. jmp), the next instruction is only reached through a label
+    lowered->exit = reached[size] ? zero[size] : ZERO_ALL;
+}
+
+static LoweredInst* lowered_cache[256][ZERO_ALL + 1];
+static inline const LoweredInst* lower_inst(size_t code_gen, ZeroSet entry) {
+    if (!lowered_cache[code_gen][entry]) {
+        lowered_cache[code_gen][entry] = malloc(sizeof(LoweredInst));
+        if (!lowered_cache[code_gen][entry]) { fprintf(stderr, "Code gen memory alloc failed\n"); exit(1); }
+        lower_code_gen(inst_code_gen[code_gen], inst_code_gen_sizes[code_gen], entry, lowered_cache[code_gen][entry]);
+    }
+    return lowered_cache[code_gen][entry];
+}
+
+// symbol table - every identifier is interned once into an arena, an open addressing hash table maps names to symbol ids
+// ids are dense and in order of first use, a symbol exists (hti_exist) once a value was set for it
+typedef uint32_t SymbolId;
+#define SYMBOL_NONE UINT32_MAX
+
+typedef struct {
+    size_t offset, length;
+    uint32_t hash;
+    WORD_UTYPE value;
+    bool defined;
+    uint16_t bank; // 1 + the bank of a banked allocation, 0 for the rest
+    bool returned; // a link that a ret goes through, see scan_links
+} Symbol;
+
+static char* symbol_arena = NULL;
+static size_t symbol_arena_size = 0, symbol_arena_capacity = 0;
+static Symbol* symbols = NULL;
+static size_t symbols_count = 0, symbols_capacity = 0;
+static SymbolId* symbol_slots = NULL;
+static size_t symbol_slots_capacity = 0;
+
+static inline uint32_t symbol_hash(const char* name, size_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    return hash;
+}
+static inline const char* symbol_name(SymbolId id) {
+    return symbol_arena + symbols[id].offset;
+}
+static inline size_t symbol_slot(const char* name, size_t length, uint32_t hash) {
+    size_t mask = symbol_slots_capacity - 1;
+    size_t slot = hash & mask;
+    while (symbol_slots[slot] != SYMBOL_NONE) {
+        Symbol* symbol = &symbols[symbol_slots[slot]];
+        if (symbol->hash == hash && symbol->length == length && memcmp(symbol_arena + symbol->offset, name, length) == 0) break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+static inline void symbol_grow_slots(void) {
+    // kept at most half full so probes stay short
+    free(symbol_slots);
+    symbol_slots_capacity = symbol_slots_capacity ? symbol_slots_capacity * 2 : 1024;
+    symbol_slots = malloc(symbol_slots_capacity * sizeof(SymbolId));
+    if (!symbol_slots) { fprintf(stderr, "Symbol table alloc failed\n"); exit(1); }
+    memset(symbol_slots, 0xFF, symbol_slots_capacity * sizeof(SymbolId));
+    for (SymbolId id = 0; id < symbols_count; ++id) {
+        size_t slot = symbols[id].hash & (symbol_slots_capacity - 1);
+        while (symbol_slots[slot] != SYMBOL_NONE) slot = (slot + 1) & (symbol_slots_capacity - 1);
+        symbol_slots[slot] = id;
+    }
+}
+static inline SymbolId symbol_find(const char* name, size_t length) {
+    if (!symbol_slots_capacity) return SYMBOL_NONE;
+    return symbol_slots[symbol_slot(name, length, symbol_hash(name, length))];
+}
+static inline SymbolId symbol_intern(const char* name, size_t length) {
+    if ((symbols_count + 1) * 2 > symbol_slots_capacity) symbol_grow_slots();
+    uint32_t hash = symbol_hash(name, length);
+    size_t slot = symbol_slot(name, length, hash);
+    if (symbol_slots[slot] != SYMBOL_NONE) return symbol_slots[slot];
+    if (symbols_count == symbols_capacity) {
+        symbols_capacity = symbols_capacity ? symbols_capacity * 2 : 1024;
+        symbols = realloc(symbols, symbols_capacity * sizeof(Symbol));
+        if (!symbols) { fprintf(stderr, "Symbol table alloc failed\n"); exit(1); }
+    }
+    while (symbol_arena_size + length + 1 > symbol_arena_capacity) {
+        symbol_arena_capacity = symbol_arena_capacity ? symbol_arena_capacity * 2 : 16384;
+        symbol_arena = realloc(symbol_arena, symbol_arena_capacity);
+        if (!symbol_arena) { fprintf(stderr, "Symbol arena alloc failed\n"); exit(1); }
+    }
+    memcpy(symbol_arena + symbol_arena_size, name, length);
+    symbol_arena[symbol_arena_size + length] = '\0';
+    symbols[symbols_count] = (Symbol){.offset = symbol_arena_size, .length = length, .hash = hash};
+    symbol_arena_size += length + 1;
+    symbol_slots[slot] = (SymbolId)symbols_count;
+    return (SymbolId)symbols_count++;
+}
+
+static inline bool symbol_exist(SymbolId id) {
+    return id != SYMBOL_NONE && symbols[id].defined;
+}
+static inline void symbol_set(SymbolId id, WORD_UTYPE value) {
+    symbols[id].value = value;
+    symbols[id].defined = true;
+}
+// generated symbols, #n for the constant n, ^label for the word holding a label address, &variable for the word holding a variable address,
+// >n for the word holding the return address of the cal at token n, ~link for the word the ret of link jumps through,
+// %n for the word holding the address of the table of the jtb at token n
+static inline SymbolId symbol_constant(WORD_UTYPE number) {
+    char name[16];
+    int length = snprintf(name, sizeof(name), "#%d", number);
+    return symbol_intern(name, (size_t)length);
+}
+static inline SymbolId symbol_prefixed(char prefix, SymbolId id) {
+    static char name[MAX_IDENTIFIER_LENGTH + 2];
+    name[0] = prefix;
+    memcpy(name + 1, symbol_name(id), symbols[id].length);
+    return symbol_intern(name, symbols[id].length + 1);
+}
+static inline SymbolId symbol_return(size_t cal_token) {
+    char name[24];
+    int length = snprintf(name, sizeof(name), ">%zu", cal_token);
+    return symbol_intern(name, (size_t)length);
+}
+static inline SymbolId symbol_jump_table(size_t jtb_token) {
+    char name[24];
+    int length = snprintf(name, sizeof(name), "%%%zu", jtb_token);
+    return symbol_intern(name, (size_t)length);
+}
+
+// token stream - the source is lexed once into tokens that every pass walks by index,
+// -number, $label and @label are already folded into one token and identifiers are interned
+typedef struct {
+    TokenType type;
+    SymbolId symbol;
+    WORD_UTYPE number;
+    size_t position;
+} Token;
+
+static Token* tokens = NULL;
+static size_t tokens_count = 0, tokens_capacity = 0;
+static size_t token_index = 0;
+TokenType token = TOKEN_UNKNOWN;
+static SymbolId token_symbol = SYMBOL_NONE;
+static WORD_UTYPE token_number = 0;
+
+// the a operand is an immediate the template may be chosen by
+static inline bool inst_immediate(TokenType inst, const Token* operand) {
+    return (inst_syntax_types[inst] == IST_IMMADDR_ADDR || inst_syntax_types[inst] == IST_IMMADDR_ADDR_IMMADDR) && operand->type == TOKEN_NUMBER;
+}
+
+// jump tables - "jtb index @l0, @l1, ..." jumps to the label at index through a table of the label addresses in the data,
+// after the word with the address of the table (and with --clamp-jtb the word 1 - the number of labels). the entries are
+// code addresses like the ^label words, so the labels stay entry points of the control flow pass and follow its layout
+static inline size_t jtb_labels_count(size_t first_label) {
+    size_t count = 0;
+    for (size_t at = first_label; at < tokens_count && tokens[at].type == TOKEN_LABEL_USE; at += 2) {
+        ++count;
+        if (at + 1 >= tokens_count || tokens[at + 1].type != TOKEN_COMMA) break;
+    }
+    return count;
+}
+
+static inline void push_token(TokenType type, SymbolId symbol, WORD_UTYPE number) {
+    if (tokens_count == tokens_capacity) {
+        tokens_capacity = tokens_capacity ? tokens_capacity * 2 : 4096;
+        tokens = realloc(tokens, tokens_capacity * sizeof(Token));
+        if (!tokens) { fprintf(stderr, "Token memory alloc failed\n"); exit(1); }
+    }
+    tokens[tokens_count++] = (Token){type, symbol, number, ctx.old_cursor.i};
+}
+// the names derived from an identifier (symbol_prefixed) are built in buffers of MAX_IDENTIFIER_LENGTH
+static inline SymbolId intern_token_string(void) {
+    if (ctx.token_length > MAX_IDENTIFIER_LENGTH) PICOCT_error_printf(&ctx, "Identifiers are limited to %d characters", MAX_IDENTIFIER_LENGTH);
+    return symbol_intern(ctx.source + ctx.token_start, ctx.token_length);
+}
+static inline void lex_source(void) {
+    while (true) {
+        PICOCT_tokenize(&ctx);
+        if (ctx.token_type == PICOCT_EOS) { push_token(TOKEN_EOS, SYMBOL_NONE, 0); return; }
+        else if (ctx.token_type == PICOCT_IDENTIFIER) push_token(TOKEN_IDENTIFIER, intern_token_string(), 0);
+        else if (ctx.token_type == PICOCT_NUMBER) push_token(TOKEN_NUMBER, SYMBOL_NONE, (WORD_UTYPE)(WORD_STYPE)(ctx.token_number));
+        else if (ctx.token_type == PICOCT_MATCH && (ctx.match_type == TOKEN_HYPHEN || ctx.match_type == TOKEN_LABEL_DECL || ctx.match_type == TOKEN_LABEL_USE)) {
+            TokenType type = ctx.match_type == TOKEN_HYPHEN ? TOKEN_NUMBER : (TokenType)ctx.match_type;
+            PICOCT_tokenize(&ctx);
+            if (type == TOKEN_NUMBER && ctx.token_type != PICOCT_NUMBER) break;
+            if (type != TOKEN_NUMBER && ctx.token_type != PICOCT_IDENTIFIER) break;
+            if (type == TOKEN_NUMBER) push_token(TOKEN_NUMBER, SYMBOL_NONE, (WORD_UTYPE)(WORD_STYPE)(-ctx.token_number));
+            else push_token(type, intern_token_string(), 0);
+        }
+        else if (ctx.token_type == PICOCT_MATCH) push_token(ctx.match_type, SYMBOL_NONE, 0);
+        else break;
+    }
+    // the lexer can not go on after an unknown token, the passes report it once they reach it
+    push_token(TOKEN_UNKNOWN, SYMBOL_NONE, 0);
+    push_token(TOKEN_EOS, SYMBOL_NONE, 0);
+}
+
+static inline void tokenize(void) {
+    Token* current = &tokens[token_index];
+    if (current->type != TOKEN_EOS) ++token_index;
+    token = current->type;
+    token_symbol = current->symbol;
+    token_number = current->number;
+    ctx.old_cursor.i = current->position;
+}
+
 
 WORD_UTYPE *binary = NULL;
+// words holding a code address (jump targets, template words patched by the code, ^label words and the header jump),
+// they are the ones to rewrite when the code moves
+bool *relocatable = NULL;
+// data words holding a data address (array and allocation heads, &variable words), an object (-c) relocates them with its data
+bool *data_relocatable = NULL;
+// where the instruction at an address came from: its instruction token, the template and the zero set it was lowered for
+// and its index in the lowered template, fall marks a goto the layout added for the fall-through of that instruction
+typedef struct {
+    uint32_t token;
+    uint8_t code_gen, zero, index;
+    bool fall;
+} CodeOrigin;
+CodeOrigin *code_origin = NULL;
 size_t binary_capacity = 0;
 size_t binary_idx = 0;
 
@@ -293,10 +1114,15 @@ static inline void binary_reserve(void) {
     if (binary_idx >= WORD_MAX) { fprintf(stderr, "Binary size exceeded max\n"); exit(1); }
     binary_capacity = binary_capacity ? binary_capacity * 2 : 4096;
     binary = realloc(binary, binary_capacity * sizeof(WORD_UTYPE));
-    if (!binary) { fprintf(stderr, "Binary memory alloc failed\n"); exit(1); }
+    relocatable = realloc(relocatable, binary_capacity * sizeof(bool));
+    data_relocatable = realloc(data_relocatable, binary_capacity * sizeof(bool));
+    code_origin = realloc(code_origin, binary_capacity * sizeof(CodeOrigin));
+    if (!binary || !relocatable || !data_relocatable || !code_origin) { fprintf(stderr, "Binary memory alloc failed\n"); exit(1); }
 }
 static inline void binary_push(WORD_UTYPE val) {
     binary_reserve();
+    relocatable[binary_idx] = false;
+    data_relocatable[binary_idx] = false;
     binary[binary_idx++] = val;
 }
 
@@ -319,24 +1145,28 @@ static inline void add_binary_header(void){
     binary_push(0);
     binary_push(0);
     binary_push(0);
+    relocatable[2] = true;
 }
 static inline void add_value(WORD_UTYPE value) {
     binary_push(value);
     ++binary[2];
 }
-static inline void add_variable(const char* identifier, WORD_UTYPE value) {
-    hti_set(identifier, binary_idx);
+static inline void add_variable(SymbolId id, WORD_UTYPE value) {
+    symbol_set(id, binary_idx);
     add_value(value);
 }
-static inline void add_inst(WORD_UTYPE a, WORD_UTYPE b, WORD_UTYPE c) {
+static inline void add_inst(WORD_UTYPE a, WORD_UTYPE b, WORD_UTYPE c, bool a_code, bool b_code, bool c_code) {
     binary_push(a);
+    relocatable[binary_idx - 1] = a_code;
     binary_push(b);
+    relocatable[binary_idx - 1] = b_code;
     binary_push(c);
+    relocatable[binary_idx - 1] = c_code;
 }
 
 static inline void print_state(void) {
     printf("{ ");
-    for (size_t i = 0; i < HTI_SIZE; ++i) if (hti_ar_str[i][0] != '\0') printf("%s : %d, ", hti_ar_str[i], hti_ar_val[i]);
+    for (SymbolId id = 0; id < symbols_count; ++id) if (symbols[id].defined) printf("%s : %d, ", symbol_name(id), symbols[id].value);
     printf("}\n");
     for (size_t i = 0; i < binary_idx; ++i) printf("%d ", binary[i]);
     printf("\n");
@@ -353,26 +1183,215 @@ static inline void expect_token(TokenType type){
 static inline void valid_token(){
     if (token == TOKEN_UNKNOWN || token == TOKEN__INST_BEGIN || token == TOKEN__INST_END) PICOCT_error_printf(&ctx, "Unknown token type encountered");
 }
-static inline void expect_identifier_exist(const char* identifier) {
-    if (!hti_exist(identifier)) PICOCT_error_printf(&ctx, "Undeclared identifier \'%s\' encountered", identifier);
+static inline void expect_identifier_exist(SymbolId id) {
+    if (!symbol_exist(id)) PICOCT_error_printf(&ctx, "Undeclared identifier \'%s\' encountered", symbol_name(id));
+}
+static inline void expect_identifier_addr_exist(SymbolId id) {
+    if (!symbol_exist(id)) PICOCT_error_printf(&ctx, "Undeclared identifier address \'%s\' encountered", symbol_name(id));
+}
+static inline void expect_label_exist(SymbolId id) {
+    if (!symbol_exist(id)) PICOCT_error_printf(&ctx, "Undeclared label \'%s\' encountered", symbol_name(id));
+}
+static inline void expect_label_addr_exist(SymbolId id) {
+    if (!symbol_exist(id)) PICOCT_error_printf(&ctx, "Undeclared label address \'%s\' encountered", symbol_name(id));
+}
+
+// execution profile (--profile): the counts per address of emulate --profile joined with the map (--map) of the build
+// that ran, so they stay with the instruction they were counted for when the code moves. an instruction taking at least
+// 1 / PROFILE_HOT_SHARE of the profiled steps is hot and gets the speed form of its template, the hottest first
+// while they add up to at most PROFILE_SPEED_WORDS more words
+#define PROFILE_HOT_SHARE 100
+#define PROFILE_SPEED_WORDS 4096
+typedef struct {
+    CodeOrigin origin;
+    uint64_t count;
+} ProfileEntry;
+static ProfileEntry* profile = NULL;
+static size_t profile_size = 0;
+static uint64_t profile_total = 0;
+static uint64_t* profile_token_steps = NULL;
+static bool* profile_token_hot = NULL;
+
+static inline int compare_origins(const CodeOrigin* x, const CodeOrigin* y) {
+    if (x->token != y->token) return x->token < y->token ? -1 : 1;
+    if (x->fall != y->fall) return x->fall < y->fall ? -1 : 1;
+    if (x->index != y->index) return x->index < y->index ? -1 : 1;
+    if (x->code_gen != y->code_gen) return x->code_gen < y->code_gen ? -1 : 1;
+    if (x->zero != y->zero) return x->zero < y->zero ? -1 : 1;
+    return 0;
+}
+static inline int compare_profile_entries(const void* x, const void* y) {
+    return compare_origins(&((const ProfileEntry*)x)->origin, &((const ProfileEntry*)y)->origin);
+}
+static inline bool profile_load(const char* counts_path, const char* map_path) {
+    uint64_t* counts = calloc(WORD_MAX + 1, sizeof(uint64_t));
+    FILE* counts_file = fopen(counts_path, "r");
+    FILE* map_file = fopen(map_path, "r");
+    bool ok = counts && counts_file && map_file;
+    unsigned long address;
+    unsigned long long count;
+    while (ok && fscanf(counts_file, "%lu %llu", &address, &count) == 2) {
+        if (address > WORD_MAX) { ok = false; break; }
+        counts[address] += count;
+        profile_total += count;
+    }
+    if (ok && !feof(counts_file)) ok = false;
+    size_t capacity = 0;
+    unsigned long token;
+    unsigned code_gen, zero, index, fall;
+    while (ok && fscanf(map_file, "%lu %lu %u %u %u %u", &address, &token, &code_gen, &zero, &index, &fall) == 6) {
+        if (address > WORD_MAX || token > UINT32_MAX || code_gen > UINT8_MAX || zero > ZERO_ALL || index > UINT8_MAX || fall > 1) { ok = false; break; }
+        if (profile_size == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            profile = realloc(profile, capacity * sizeof(ProfileEntry));
+            if (!profile) { fprintf(stderr, "Profile memory alloc failed\n"); exit(1); }
+        }
+        profile[profile_size++] = (ProfileEntry){{(uint32_t)token, (uint8_t)code_gen, (uint8_t)zero, (uint8_t)index, fall != 0}, counts[address]};
+    }
+    if (ok && !feof(map_file)) ok = false;
+    if (counts_file) fclose(counts_file);
+    if (map_file) fclose(map_file);
+    free(counts);
+    if (ok) qsort(profile, profile_size, sizeof(ProfileEntry), compare_profile_entries);
+    return ok;
 }
-static inline void expect_identifier_addr_exist(const char* identifier) {
-    if (!hti_exist(identifier)) PICOCT_error_printf(&ctx, "Undeclared identifier address \'%s\' encountered", identifier);
+static inline int compare_token_steps(const void* x, const void* y) {
+    uint64_t a = profile_token_steps[*(const size_t*)x], b = profile_token_steps[*(const size_t*)y];
+    if (a != b) return a > b ? -1 : 1;
+    return *(const size_t*)x < *(const size_t*)y ? -1 : 1;
+}
+// the steps of every instruction token summed over the instructions of its template, and which of them are hot
+static inline void profile_count_tokens(void) {
+    profile_token_steps = calloc(tokens_count, sizeof(uint64_t));
+    profile_token_hot = calloc(tokens_count, sizeof(bool));
+    size_t* candidates = malloc(tokens_count * sizeof(size_t));
+    if (!profile_token_steps || !profile_token_hot || !candidates) { fprintf(stderr, "Profile memory alloc failed\n"); exit(1); }
+    for (size_t i = 0; i < profile_size; ++i) {
+        if (profile[i].origin.token < tokens_count) profile_token_steps[profile[i].origin.token] += profile[i].count;
+    }
+    size_t candidates_count = 0;
+    for (size_t i = 0; i + 1 < tokens_count; ++i) {
+        if (tokens[i].type <= TOKEN__INST_BEGIN || tokens[i].type >= TOKEN__INST_END) continue;
+        if (profile_token_steps[i] * PROFILE_HOT_SHARE < profile_total || !profile_total) continue;
+        size_t code_gen = choose_code_gen(tokens[i].type, inst_immediate(tokens[i].type, &tokens[i + 1]), tokens[i + 1].number).code_gen;
+        if (unrolled_code_gen_for(code_gen) != code_gen) candidates[candidates_count++] = i;
+    }
+    qsort(candidates, candidates_count, sizeof(size_t), compare_token_steps);
+    size_t words = 0;
+    for (size_t i = 0; i < candidates_count; ++i) {
+        size_t code_gen = tokens[candidates[i]].type;
+        size_t extra = (inst_code_gen_sizes[unrolled_code_gen_for(code_gen)] - inst_code_gen_sizes[code_gen]) * 3;
+        if (words + extra > PROFILE_SPEED_WORDS) break;
+        words += extra;
+        profile_token_hot[candidates[i]] = true;
+    }
+    free(candidates);
 }
-static inline void expect_label_exist(const char* label) {
-    if (!hti_exist(label)) PICOCT_error_printf(&ctx, "Undeclared label \'%s\' encountered", label);
+static inline bool profile_hot(size_t token_at) {
+    return profile_token_hot && token_at < tokens_count && profile_token_hot[token_at];
 }
-static inline void expect_label_addr_exist(const char* label) {
-    if (!hti_exist(label)) PICOCT_error_printf(&ctx, "Undeclared label address \'%s\' encountered", label);
+// false if the profiled build had no instruction of that origin (the source or the template changed)
+static inline bool profile_lookup(CodeOrigin origin, uint64_t* count) {
+    ProfileEntry key = {origin, 0};
+    const ProfileEntry* found = profile ? bsearch(&key, profile, profile_size, sizeof(ProfileEntry), compare_profile_entries) : NULL;
+    if (found) *count = found->count;
+    return found != NULL;
 }
 
 bool debug_mode = true;
-static WORD_UTYPE temp_hti_get_value = 0;
 static bool start_found = false;
-PICOCT_Cursor saved_cursor = {0};
+size_t code_start_token = 0;
+size_t rodata_start = 0; // the constants and address words the first pass adds after the data
 size_t code_gen_offset = 0;
+ZeroSet zero_registers = ZERO_ALL;
 TokenType inst = TOKEN_UNKNOWN;
-WORD_UTYPE inst_a = 0, inst_b = 0;
+WORD_UTYPE inst_a = 0, inst_b = 0, inst_t = 0;
+
+// relocatable objects (-c) - an identifier or label the source uses but does not declare is an import, another object
+// exports it and sqld puts its address in. until then its words hold a placeholder, the imports count down from
+// just below N_ADDR. names starting with _ stay in their object, the other variables and labels are exported
+static bool object_mode = false;
+static SymbolId* imports = NULL;
+static size_t imports_count = 0;
+
+// the import a placeholder stands for, SIZE_MAX if the value is none
+static inline size_t import_of(WORD_UTYPE value) {
+    return value < N_ADDR && (size_t)(N_ADDR - value) <= imports_count ? (size_t)(N_ADDR - 1 - value) : SIZE_MAX;
+}
+static inline bool exported(SymbolId id) {
+    return symbol_name(id)[0] != '_';
+}
+// subroutines - "cal @fn link" jumps to fn with the address after it in the jump of "ret link", so ret is a single jump.
+// the first ret of a link owns its word, the others jump to it. a link of another object (or none in a program that
+// has no ret of it) goes through the link variable instead, cal then stores there like sjp and ret is ljp link
+static inline SymbolId link_slot(const Token* link) {
+    if (link->type != TOKEN_IDENTIFIER || (object_mode && exported(link->symbol))) return SYMBOL_NONE;
+    return symbol_prefixed('~', link->symbol);
+}
+static inline void import_undeclared(TokenType type) {
+    for (size_t i = code_start_token; i < tokens_count; ++i) {
+        SymbolId id = tokens[i].symbol;
+        if (tokens[i].type != type || symbol_exist(id)) continue;
+        if (!exported(id)) { ctx.old_cursor.i = tokens[i].position; PICOCT_error_printf(&ctx, "Undeclared local name '%s' encountered", symbol_name(id)); }
+        imports = realloc(imports, (imports_count + 1) * sizeof(SymbolId));
+        if (!imports) { fprintf(stderr, "Import memory alloc failed\n"); exit(1); }
+        if (debug_mode) printf("IMPORT: %s\n", symbol_name(id));
+        symbol_set(id, (WORD_UTYPE)(N_ADDR - 1 - imports_count));
+        imports[imports_count++] = id;
+        SymbolId label_address = symbol_prefixed('^', id);
+        if (symbol_exist(label_address)) binary[symbols[label_address].value] = symbols[id].value;
+    }
+}
+
+static inline const char* inst_name(TokenType type) {
+    for (size_t i = 0; i < sizeof(keyword_table) / sizeof(keyword_table[0]); ++i) if (keyword_table[i].match_type == (size_t)type) return keyword_table[i].match_str;
+    return "?";
+}
+
+// banked memory - "name | size @bank" puts the buffer of an allocation into the named bank instead of the data, the
+// emulator shows one bank at a time in the window from BANK_BASE up (SUBLANQ_BANK_BASE) and switches on BANK_PORT
+// (bank.select in the presets). name stays in the data and points into the window. an instruction that uses the name
+// of a banked allocation is preceded by an out of its bank to BANK_PORT, unless that bank is known to be selected
+// (the last switch since the last label, an out to BANK_PORT forgets it)
+#define BANK_BASE 0xC000
+#define BANK_WORDS (N_ADDR - BANK_BASE)
+#define BANK_COUNT 256
+#define BANK_PORT 4
+#define BANK_NONE SIZE_MAX
+static SymbolId bank_names[BANK_COUNT];
+static size_t bank_used[BANK_COUNT];
+static size_t banks_count = 0;
+static size_t bank_selected = BANK_NONE;
+
+static inline size_t bank_of_name(SymbolId name) {
+    for (size_t bank = 0; bank < banks_count; ++bank) if (bank_names[bank] == name) return bank;
+    if (banks_count == BANK_COUNT) PICOCT_error_printf(&ctx, "More than %d banks", BANK_COUNT);
+    bank_names[banks_count] = name;
+    return banks_count++;
+}
+// the bank of the banked allocations among the operands of the instruction in token, one window shows one bank so
+// they have to be in the same one, a move between banks goes through memory that is not banked
+static inline size_t operand_bank(void) {
+    size_t bank = BANK_NONE;
+    for (size_t i = 0; i < inst_operands_count(token); ++i) {
+        const Token* operand = &tokens[token_index + i];
+        if (operand->type != TOKEN_IDENTIFIER || !symbol_exist(operand->symbol) || !symbols[operand->symbol].bank) continue;
+        size_t operand_bank = symbols[operand->symbol].bank - 1;
+        if (bank != BANK_NONE && operand_bank != bank) {
+            PICOCT_error_printf(&ctx, "The operands of %s are in the banks %s and %s, only one is shown at a time", inst_name(token), symbol_name(bank_names[bank]), symbol_name(bank_names[operand_bank]));
+        }
+        bank = operand_bank;
+    }
+    return bank;
+}
+// the bank to switch to before the instruction in token, BANK_NONE if it needs no switch
+static inline size_t bank_switch(void) {
+    size_t bank = operand_bank(), selected = bank_selected;
+    const Token* port = &tokens[token_index + 1];
+    if (token == TOKEN_INST_OUT && port->type == TOKEN_NUMBER && port->number == BANK_PORT) bank_selected = BANK_NONE;
+    else if (bank != BANK_NONE) bank_selected = bank;
+    return bank != selected ? bank : BANK_NONE;
+}
 
 static inline bool data_section_pass(void) {
     valid_token();
@@ -382,21 +1401,21 @@ static inline bool data_section_pass(void) {
         return false;
     }
     expect_token(TOKEN_IDENTIFIER);
-    if (hti_exist(token_string_buffer)) PICOCT_error_printf(&ctx, "Redeclaration of identifier %s", token_string_buffer);
-    if (debug_mode) printf("IDENTIFIER: %s\n", token_string_buffer);
-    strncpy(temp_token_string_buffer, token_string_buffer, sizeof(temp_token_string_buffer));
+    if (symbol_exist(token_symbol)) PICOCT_error_printf(&ctx, "Redeclaration of identifier %s", symbol_name(token_symbol));
+    if (debug_mode) printf("IDENTIFIER: %s\n", symbol_name(token_symbol));
+    SymbolId variable = token_symbol;
     tokenize();
     if (token == TOKEN_ASSIGN) {
         tokenize();
         expect_token(TOKEN_NUMBER);
         if (debug_mode) printf("ASSIGN NUMBER: %d (%d)\n", token_number, (WORD_STYPE)token_number);
-        add_variable(temp_token_string_buffer, token_number);
+        add_variable(variable, token_number);
         tokenize();
     }
     else if (token == TOKEN_ARRAY) {
-        add_variable(temp_token_string_buffer, 0);
-        hti_get(temp_token_string_buffer, &temp_hti_get_value);
-        binary[temp_hti_get_value] = temp_hti_get_value + 1;
+        add_variable(variable, 0);
+        binary[symbols[variable].value] = symbols[variable].value + 1;
+        data_relocatable[symbols[variable].value] = true;
         tokenize();
         while (true) {
             expect_token(TOKEN_NUMBER);
@@ -408,29 +1427,42 @@ static inline bool data_section_pass(void) {
         }
     }
     else if (token == TOKEN_ALLOC) {
-        add_variable(temp_token_string_buffer, 0);
-        hti_get(temp_token_string_buffer, &temp_hti_get_value);
-        binary[temp_hti_get_value] = temp_hti_get_value + 1;
+        add_variable(variable, 0);
+        binary[symbols[variable].value] = symbols[variable].value + 1;
+        data_relocatable[symbols[variable].value] = true;
         tokenize();
         expect_token(TOKEN_NUMBER);
         if (debug_mode) printf("ALLOCATION SIZE: %d (%d)\n", token_number, (WORD_STYPE)token_number);
         if ((WORD_STYPE)token_number < 0) PICOCT_error_printf(&ctx, "Cannot allocate a buffer of size of a negative number");
-        for (size_t i = 0; i < (size_t)(token_number - 1); ++i) add_value(0);
+        size_t size = token_number;
         tokenize();
+        if (token == TOKEN_LABEL_USE) {
+            // objects do not say which words are bank numbers, sqld could not place the banks of several of them
+            if (object_mode) PICOCT_error_printf(&ctx, "Banked allocations can not be assembled into an object (-c)");
+            size_t bank = bank_of_name(token_symbol);
+            if (debug_mode) printf("ALLOCATION BANK: %s %zu\n", symbol_name(token_symbol), bank);
+            if (bank_used[bank] + (size ? size - 1 : 0) > BANK_WORDS) PICOCT_error_printf(&ctx, "Bank %s is full, it holds %d words", symbol_name(token_symbol), BANK_WORDS);
+            binary[symbols[variable].value] = (WORD_UTYPE)(BANK_BASE + bank_used[bank]);
+            data_relocatable[symbols[variable].value] = false;
+            symbols[variable].bank = (uint16_t)(bank + 1);
+            bank_used[bank] += size ? size - 1 : 0;
+            tokenize();
+        }
+        else for (size_t i = 0; i < (size_t)(size - 1); ++i) add_value(0);
     }
     else if (token == TOKEN_COMMA) {
-        add_variable(temp_token_string_buffer, 0);
+        add_variable(variable, 0);
         tokenize();
         expect_token(TOKEN_IDENTIFIER);
-        if (debug_mode) printf("MULTI DECL IDENTIFIER: %s \n", token_string_buffer);
-        add_variable(token_string_buffer, 0);
+        if (debug_mode) printf("MULTI DECL IDENTIFIER: %s \n", symbol_name(token_symbol));
+        add_variable(token_symbol, 0);
         tokenize();
         while (true) {
             if (token != TOKEN_COMMA) break;
             tokenize();
             expect_token(TOKEN_IDENTIFIER);
-            if (debug_mode) printf("MULTI DECL IDENTIFIER: %s \n", token_string_buffer);
-            add_variable(token_string_buffer, 0);
+            if (debug_mode) printf("MULTI DECL IDENTIFIER: %s \n", symbol_name(token_symbol));
+            add_variable(token_symbol, 0);
             tokenize();
         }
     }
@@ -438,41 +1470,103 @@ static inline bool data_section_pass(void) {
     return true;
 }
 
+// 1 and -1 are already in the header as O and M
+static inline bool constant_in_header(WORD_UTYPE number) {
+    return number == 1 || number == (WORD_UTYPE)-1;
+}
+static inline void add_constant(WORD_UTYPE number) {
+    if (constant_in_header(number)) return;
+    SymbolId constant = symbol_constant(number);
+    if (debug_mode) printf("CONSTANT: %s %d \n", symbol_name(constant), number);
+    if (!symbol_exist(constant)) add_variable(constant, number);
+}
+
+// the constants a template reads besides its a operand
+static inline void add_code_gen_constants(size_t code_gen) {
+    if (code_gen_uses(code_gen, W)) add_constant(WORD_SIZE);
+    if (code_gen_uses(code_gen, H)) add_constant((WORD_UTYPE)1 << (WORD_SIZE - 1));
+    GeneratedCodeGen* generated = generated_code_gen_of(code_gen);
+    if (generated) for (size_t i = 0; i < generated->constants_count; ++i) add_constant(generated->constants[i]);
+}
+
+// a link that a ret goes through becomes a return slot, cal writes the return address into the jump of the ret and
+// never into the variable, so an ljp or sjp of the same link would go through a stale word. decided before the passes,
+// every cal of the link is then a CODE_GEN_CAL_RET in all of them
+static inline void scan_links(void) {
+    for (size_t i = code_start_token; i + 1 < tokens_count; ++i) {
+        if (tokens[i].type == TOKEN_INST_RET && link_slot(&tokens[i + 1]) != SYMBOL_NONE) symbols[tokens[i + 1].symbol].returned = true;
+    }
+    for (size_t i = code_start_token; i + 1 < tokens_count; ++i) {
+        const Token* link = tokens[i].type == TOKEN_INST_LJP ? &tokens[i + 1] : tokens[i].type == TOKEN_INST_SJP && i + 2 < tokens_count ? &tokens[i + 2] : NULL;
+        if (!link || link->type != TOKEN_IDENTIFIER || !symbols[link->symbol].returned) continue;
+        ctx.old_cursor.i = link->position;
+        PICOCT_error_printf(&ctx, "'%s' is the link of a ret, it can not also be used by %s", symbol_name(link->symbol), inst_name(tokens[i].type));
+    }
+}
+
+// the template for the instruction in token, the a operand is the next token
+static inline CodeGenChoice choose_inst_code_gen(void) {
+    const Token* operand = &tokens[token_index];
+    CodeGenChoice choice = choose_code_gen(token, inst_immediate(token, operand), operand->number);
+    if (profile_hot(token_index - 1)) choice.code_gen = unrolled_code_gen_for(choice.code_gen);
+    if (token == TOKEN_INST_CAL && token_index + 1 < tokens_count && tokens[token_index + 1].type == TOKEN_IDENTIFIER && symbols[tokens[token_index + 1].symbol].returned) {
+        choice.code_gen = CODE_GEN_CAL_RET;
+    }
+    if (token == TOKEN_INST_RET && link_slot(operand) == SYMBOL_NONE) choice.code_gen = TOKEN_INST_LJP;
+    return choice;
+}
+
 static inline void first_pass(void) {
     valid_token();
-    if ((token > TOKEN__INST_BEGIN && token < TOKEN__INST_END) && inst_syntax_types[token] == IST_PORT_ADDR) { 
+    if (token > TOKEN__INST_BEGIN && token < TOKEN__INST_END) add_code_gen_constants(choose_inst_code_gen().code_gen);
+    if (token > TOKEN__INST_BEGIN && token < TOKEN__INST_END && operand_bank() != BANK_NONE) add_constant(operand_bank());
+    if ((token > TOKEN__INST_BEGIN && token < TOKEN__INST_END) && inst_syntax_types[token] == IST_IMMADDR_ADDR) {
+        CodeGenChoice choice = choose_inst_code_gen();
+        tokenize();
+        if (choice.immediate && code_gen_uses(choice.code_gen, A)) add_constant(choice.constant);
+    }
+    else if ((token > TOKEN__INST_BEGIN && token < TOKEN__INST_END) && inst_syntax_types[token] == IST_PORT_ADDR) { 
         tokenize(); 
     }
     else if ((token > TOKEN__INST_BEGIN && token < TOKEN__INST_END) && inst_syntax_types[token] == IST_IMMADDR_PORT) {
         tokenize();
-        if (token == TOKEN_NUMBER) {
-            snprintf(temp_token_string_buffer, sizeof(temp_token_string_buffer), "#%d", token_number);
-            if (debug_mode) printf("CONSTANT: %s %d \n", temp_token_string_buffer, token_number);
-            if (!hti_exist(temp_token_string_buffer)) add_variable(temp_token_string_buffer, token_number);
-        }
+        if (token == TOKEN_NUMBER) add_constant(token_number);
         tokenize();
     }
     else if ((token > TOKEN__INST_BEGIN && token < TOKEN__INST_END) && inst_syntax_types[token] == IST_LABELDEREF_ADDR) {
         tokenize();
         expect_token(TOKEN_LABEL_USE);
-        snprintf(temp_token_string_buffer, sizeof(temp_token_string_buffer), "^%s", token_string_buffer);
-        if (debug_mode) printf("LABEL ADDRESS: %s \n", temp_token_string_buffer);
-        add_variable(temp_token_string_buffer, 0);
+        SymbolId label_address = symbol_prefixed('^', token_symbol);
+        if (debug_mode) printf("LABEL ADDRESS: %s \n", symbol_name(label_address));
+        add_variable(label_address, 0);
+        relocatable[symbols[label_address].value] = true;
+    }
+    else if (token == TOKEN_INST_CAL) {
+        SymbolId return_address = symbol_return(token_index - 1);
+        add_variable(return_address, 0);
+        relocatable[symbols[return_address].value] = true;
+    }
+    else if (token == TOKEN_INST_JTB) {
+        size_t count = jtb_labels_count(token_index + 1);
+        SymbolId table = symbol_jump_table(token_index - 1);
+        add_variable(table, binary_idx + 1 + clamp_jtb);
+        data_relocatable[symbols[table].value] = true;
+        if (clamp_jtb) add_value((WORD_UTYPE)(1 - count));
+        for (size_t i = 0; i < count; ++i) {
+            add_value(0);
+            relocatable[binary_idx - 1] = true;
+        }
     }
     else if ((token > TOKEN__INST_BEGIN && token < TOKEN__INST_END) && inst_syntax_types[token] == IST_ADDRDEREF_ADDR) {
         tokenize();
         expect_token(TOKEN_IDENTIFIER);
-        if (!hti_exist(token_string_buffer)) PICOCT_error_printf(&ctx, "Cannot get address of an undeclared identifier");
-        hti_get(token_string_buffer, &temp_hti_get_value);
-        snprintf(temp_token_string_buffer, sizeof(temp_token_string_buffer), "&%s", token_string_buffer);
-        if (debug_mode) printf("IDENTIFIER ADDRESS: %s %d \n", temp_token_string_buffer, temp_hti_get_value);
-        add_variable(temp_token_string_buffer, temp_hti_get_value);
-    }
-    else if (token == TOKEN_NUMBER) {
-        snprintf(temp_token_string_buffer, sizeof(temp_token_string_buffer), "#%d", token_number);
-        if (debug_mode) printf("CONSTANT: %s %d \n", temp_token_string_buffer, token_number);
-        if (!hti_exist(temp_token_string_buffer)) add_variable(temp_token_string_buffer, token_number);
+        if (!symbol_exist(token_symbol)) PICOCT_error_printf(&ctx, "Cannot get address of an undeclared identifier");
+        SymbolId variable_address = symbol_prefixed('&', token_symbol);
+        if (debug_mode) printf("IDENTIFIER ADDRESS: %s %d \n", symbol_name(variable_address), symbols[token_symbol].value);
+        add_variable(variable_address, symbols[token_symbol].value);
+        data_relocatable[symbols[variable_address].value] = true;
     }
+    else if (token == TOKEN_NUMBER) add_constant(token_number);
     tokenize();
 }
 
@@ -480,122 +1574,207 @@ static inline void second_pass(void) {
     valid_token();
     if ((token > TOKEN__INST_BEGIN && token < TOKEN__INST_END)) {
         if (debug_mode) printf("INSTRUCTION: %s\n", token_type_names[token]);
-        code_gen_offset += inst_code_gen_sizes[token] * 3;
+        if (bank_switch() != BANK_NONE) code_gen_offset += 3;
+        if (token == TOKEN_INST_RET) {
+            SymbolId slot = link_slot(&tokens[token_index]);
+            if (slot != SYMBOL_NONE && !symbol_exist(slot)) symbol_set(slot, binary_idx + code_gen_offset + 2);
+        }
+        SymbolId return_address = token == TOKEN_INST_CAL ? symbol_return(token_index - 1) : SYMBOL_NONE;
+        const LoweredInst* lowered = lower_inst(choose_inst_code_gen().code_gen, zero_registers);
+        code_gen_offset += lowered->size * 3;
+        zero_registers = lowered->exit;
+        if (return_address != SYMBOL_NONE) {
+            // the callee comes back like to a label, but through a ret or ljp, which both leave Z clear
+            binary[symbols[return_address].value] = binary_idx + code_gen_offset;
+            zero_registers = register_bit(Z);
+            bank_selected = BANK_NONE;
+        }
     }
     else if (token == TOKEN_LABEL_DECL) {
-        if (debug_mode) printf("LABEL DECLARATION: %s %zu \n", token_string_buffer, binary_idx + code_gen_offset);
-        if (hti_exist(token_string_buffer)) PICOCT_error_printf(&ctx, "Redeclaration of label %s", token_string_buffer);
-        hti_set(token_string_buffer, binary_idx + code_gen_offset);
-        snprintf(temp_token_string_buffer, sizeof(temp_token_string_buffer), "^%s", token_string_buffer);
-        if (hti_exist(temp_token_string_buffer)) {
-            hti_get(temp_token_string_buffer, &temp_hti_get_value);
-            if (debug_mode) printf("UPDATE LABEL ADDRESS: %s %d %zu \n", temp_token_string_buffer, temp_hti_get_value, binary_idx + code_gen_offset);
-            binary[temp_hti_get_value] = binary_idx + code_gen_offset;
+        zero_registers = 0;
+        bank_selected = BANK_NONE;
+        if (debug_mode) printf("LABEL DECLARATION: %s %zu \n", symbol_name(token_symbol), binary_idx + code_gen_offset);
+        if (symbol_exist(token_symbol)) PICOCT_error_printf(&ctx, "Redeclaration of label %s", symbol_name(token_symbol));
+        symbol_set(token_symbol, binary_idx + code_gen_offset);
+        SymbolId label_address = symbol_prefixed('^', token_symbol);
+        if (symbol_exist(label_address)) {
+            if (debug_mode) printf("UPDATE LABEL ADDRESS: %s %d %zu \n", symbol_name(label_address), symbols[label_address].value, binary_idx + code_gen_offset);
+            binary[symbols[label_address].value] = binary_idx + code_gen_offset;
         }
     }
     tokenize();
 }
 
+static inline WORD_UTYPE constant_address(WORD_UTYPE number) {
+    if (number == 1) return O_ADDR;
+    if (number == (WORD_UTYPE)-1) return M_ADDR;
+    SymbolId constant = symbol_constant(number);
+    expect_identifier_exist(constant);
+    return symbols[constant].value;
+}
+// reads an identifier operand, or an immediate through its #n constant
+static inline WORD_UTYPE immediate_or_identifier_operand(void) {
+    if (token != TOKEN_NUMBER && token != TOKEN_IDENTIFIER) PICOCT_error_printf(&ctx, "Expected an immediate or identifier");
+    if (token == TOKEN_NUMBER) return constant_address(token_number);
+    expect_identifier_exist(token_symbol);
+    return symbols[token_symbol].value;
+}
+static inline WORD_UTYPE identifier_operand(void) {
+    expect_token(TOKEN_IDENTIFIER);
+    expect_identifier_exist(token_symbol);
+    return symbols[token_symbol].value;
+}
+static inline WORD_UTYPE label_operand(void) {
+    expect_token(TOKEN_LABEL_USE);
+    expect_label_exist(token_symbol);
+    return symbols[token_symbol].value;
+}
+
 static inline void third_pass(void) {
     valid_token();
     if (token == TOKEN_LABEL_DECL) { 
-        if (debug_mode) printf("LABEL DECLARATION: %s\n", token_string_buffer);
+        if (debug_mode) printf("LABEL DECLARATION: %s\n", symbol_name(token_symbol));
+        zero_registers = 0;
+        bank_selected = BANK_NONE;
         tokenize(); 
         return; 
     }
     if (token < TOKEN__INST_BEGIN || token > TOKEN__INST_END) PICOCT_error_printf(&ctx, "Syntax: Unknown instruction keyword encountered");
     if (debug_mode) printf("INSTRUCTION: %s\n", token_type_names[token]);
     inst = token;
+    uint32_t inst_token = (uint32_t)(token_index - 1);
+    CodeGenChoice choice = choose_inst_code_gen();
+    size_t bank = bank_switch();
     if (inst_syntax_types[token] == IST_NONE) {}
     else if (inst_syntax_types[token] == IST_ADDR) {
         tokenize();
-        expect_token(TOKEN_IDENTIFIER);
-        expect_identifier_exist(token_string_buffer);
-        hti_get(token_string_buffer, &inst_a);
+        inst_a = identifier_operand();
     }
     else if (inst_syntax_types[token] == IST_IMMADDR_ADDR) {
         tokenize();
-        if (token != TOKEN_NUMBER && token != TOKEN_IDENTIFIER) PICOCT_error_printf(&ctx, "Expected an immediate or identifier");
-        if (token == TOKEN_NUMBER) snprintf(temp_token_string_buffer, sizeof(temp_token_string_buffer), "#%d", token_number);
-        else strncpy(temp_token_string_buffer, token_string_buffer, sizeof(temp_token_string_buffer));
-        expect_identifier_exist(temp_token_string_buffer);
-        hti_get(temp_token_string_buffer, &inst_a);
+        if (!choice.immediate) inst_a = immediate_or_identifier_operand();
+        else if (code_gen_uses(choice.code_gen, A)) inst_a = constant_address(choice.constant);
         tokenize();
-        expect_token(TOKEN_IDENTIFIER);
-        expect_identifier_exist(token_string_buffer);
-        hti_get(token_string_buffer, &inst_b);
+        inst_b = identifier_operand();
     }
     else if (inst_syntax_types[token] == IST_LABEL) {
         tokenize();
-        expect_token(TOKEN_LABEL_USE);
-        expect_label_exist(token_string_buffer);
-        hti_get(token_string_buffer, &inst_a);
+        inst_a = label_operand();
     }
     else if (inst_syntax_types[token] == IST_ADDR_LABEL) {
         tokenize();
-        expect_token(TOKEN_IDENTIFIER);
-        expect_identifier_exist(token_string_buffer);
-        hti_get(token_string_buffer, &inst_a);
+        inst_a = identifier_operand();
         tokenize();
-        expect_token(TOKEN_LABEL_USE);
-        expect_label_exist(token_string_buffer);
-        hti_get(token_string_buffer, &inst_b);
+        inst_b = label_operand();
+    }
+    else if (inst_syntax_types[token] == IST_LABEL_ADDR) {
+        tokenize();
+        inst_t = label_operand();
+        inst_a = symbols[symbol_return(inst_token)].value;
+        tokenize();
+        inst_b = identifier_operand();
+        if (choice.code_gen == CODE_GEN_CAL_RET) inst_b = symbols[link_slot(&tokens[token_index - 1])].value;
+    }
+    else if (inst_syntax_types[token] == IST_ADDR_LABELS) {
+        tokenize();
+        inst_a = identifier_operand();
+        size_t count = jtb_labels_count(token_index);
+        if (!count) PICOCT_error_printf(&ctx, "Expected the labels of the jump table");
+        inst_b = symbols[symbol_jump_table(inst_token)].value;
+        inst_t = inst_b + 1;
+        for (size_t i = 0; i < count; ++i) {
+            if (i) tokenize();
+            tokenize();
+            binary[binary[inst_b] + i] = label_operand();
+        }
     }
     else if (inst_syntax_types[token] == IST_LABELDEREF_ADDR) {
         tokenize();
         expect_token(TOKEN_LABEL_USE);
-        expect_label_exist(token_string_buffer);
-        snprintf(temp_token_string_buffer, sizeof(temp_token_string_buffer), "^%s", token_string_buffer);
-        expect_label_addr_exist(temp_token_string_buffer);
-        hti_get(temp_token_string_buffer, &inst_a);
+        expect_label_exist(token_symbol);
+        SymbolId label_address = symbol_prefixed('^', token_symbol);
+        expect_label_addr_exist(label_address);
+        inst_a = symbols[label_address].value;
         tokenize();
-        expect_token(TOKEN_IDENTIFIER);
-        expect_identifier_exist(token_string_buffer);
-        hti_get(token_string_buffer, &inst_b);
+        inst_b = identifier_operand();
     }
     else if (inst_syntax_types[token] == IST_ADDRDEREF_ADDR) {
         tokenize();
         expect_token(TOKEN_IDENTIFIER);
-        expect_identifier_exist(token_string_buffer);
-        snprintf(temp_token_string_buffer, sizeof(temp_token_string_buffer), "&%s", token_string_buffer);
-        expect_identifier_addr_exist(temp_token_string_buffer);
-        hti_get(temp_token_string_buffer, &inst_a);
+        expect_identifier_exist(token_symbol);
+        SymbolId variable_address = symbol_prefixed('&', token_symbol);
+        expect_identifier_addr_exist(variable_address);
+        inst_a = symbols[variable_address].value;
         tokenize();
-        expect_token(TOKEN_IDENTIFIER);
-        expect_identifier_exist(token_string_buffer);
-        hti_get(token_string_buffer, &inst_b);
+        inst_b = identifier_operand();
     }
     else if (inst_syntax_types[token] == IST_PORT_ADDR) {
         tokenize();
         expect_token(TOKEN_NUMBER);
         inst_a = token_number;
         tokenize();
-        expect_token(TOKEN_IDENTIFIER);
-        expect_identifier_exist(token_string_buffer);
-        hti_get(token_string_buffer, &inst_b);
+        inst_b = identifier_operand();
     }
     else if (inst_syntax_types[token] == IST_IMMADDR_PORT) {
         tokenize();
-        if (token != TOKEN_NUMBER && token != TOKEN_IDENTIFIER) PICOCT_error_printf(&ctx, "Expected an immediate or identifier");
-        if (token == TOKEN_NUMBER) snprintf(temp_token_string_buffer, sizeof(temp_token_string_buffer), "#%d", token_number);
-        else strncpy(temp_token_string_buffer, token_string_buffer, sizeof(temp_token_string_buffer));
-        expect_identifier_exist(temp_token_string_buffer);
-        hti_get(temp_token_string_buffer, &inst_a);
+        inst_a = immediate_or_identifier_operand();
         tokenize();
         expect_token(TOKEN_NUMBER);
         inst_b = token_number;
     }
+    else if (inst_syntax_types[token] == IST_ADDR_IMMADDR_ADDR) {
+        tokenize();
+        inst_a = identifier_operand();
+        tokenize();
+        inst_b = immediate_or_identifier_operand();
+        tokenize();
+        inst_t = identifier_operand();
+    }
+    else if (inst_syntax_types[token] == IST_IMMADDR_ADDR_IMMADDR) {
+        tokenize();
+        inst_a = immediate_or_identifier_operand();
+        tokenize();
+        inst_b = identifier_operand();
+        tokenize();
+        inst_t = immediate_or_identifier_operand();
+    }
+    else if (inst_syntax_types[token] == IST_ADDR_ADDR_IMMADDR) {
+        tokenize();
+        inst_a = identifier_operand();
+        tokenize();
+        inst_b = identifier_operand();
+        tokenize();
+        inst_t = immediate_or_identifier_operand();
+    }
     else PICOCT_error_printf(&ctx, "Syntax: Unknown instruction keyword encountered");
 
+    if (bank != BANK_NONE) {
+        // code_gen 0 is no template, so the switch has an origin of its own
+        add_inst(constant_address(bank), N_ADDR, BANK_PORT, false, false, false);
+        code_origin[binary_idx - 3] = (CodeOrigin){inst_token, 0, 0, 0, false};
+    }
+    if (choice.code_gen == TOKEN_INST_RET && symbols[link_slot(&tokens[token_index - 1])].value != binary_idx + 2) {
+        choice.code_gen = TOKEN_INST_JMP;
+        inst_a = symbols[link_slot(&tokens[token_index - 1])].value - 2;
+    }
     size_t cisp = binary_idx;
     size_t cicp = binary_idx;
     WORD_UTYPE code_gen_a = 0, code_gen_b = 0, code_gen_c = 0;
-    for (size_t i = 0; i < inst_code_gen_sizes[inst]; ++i) {
+    ZeroSet entry = zero_registers;
+    const LoweredInst* lowered = lower_inst(choice.code_gen, entry);
+    zero_registers = lowered->exit;
+    if (inst == TOKEN_INST_CAL) {
+        zero_registers = register_bit(Z);
+        bank_selected = BANK_NONE;
+    }
+    for (size_t i = 0; i < lowered->size; ++i) {
         if (debug_mode) printf("PRE CODE GEN: %zu, %zu\n", cisp, cicp);
         cicp += 3;
-        switch (inst_code_gen[inst][i].a){
+        switch (lowered->code[i].a){
         case A: code_gen_a = inst_a; break;
         case B: code_gen_a = inst_b; break;
+        case T: code_gen_a = inst_t; break;
+        case L: code_gen_a = inst_b; break;
         case Z: code_gen_a = Z_ADDR; break;
         case M: code_gen_a = M_ADDR; break;
         case O: code_gen_a = O_ADDR; break;
@@ -604,11 +1783,18 @@ static inline void third_pass(void) {
         case R: code_gen_a = R_ADDR; break;
         case S: code_gen_a = S_ADDR; break;
         case N: code_gen_a = N_ADDR; break;
-        default: code_gen_a = cisp + inst_code_gen[inst][i].a; break;
+        case W: code_gen_a = constant_address(WORD_SIZE); break;
+        case H: code_gen_a = constant_address((WORD_UTYPE)1 << (WORD_SIZE - 1)); break;
+        default:
+            if (lowered->code[i].a >= K) code_gen_a = constant_address(generated_code_gen_of(choice.code_gen)->constants[lowered->code[i].a - K]);
+            else code_gen_a = cisp + lowered->code[i].a;
+            break;
         }
-        switch (inst_code_gen[inst][i].b){
+        switch (lowered->code[i].b){
         case A: code_gen_b = inst_a; break;
         case B: code_gen_b = inst_b; break;
+        case T: code_gen_b = inst_t; break;
+        case L: code_gen_b = inst_b; break;
         case Z: code_gen_b = Z_ADDR; break;
         case M: code_gen_b = M_ADDR; break;
         case O: code_gen_b = O_ADDR; break;
@@ -617,41 +1803,857 @@ static inline void third_pass(void) {
         case R: code_gen_b = R_ADDR; break;
         case S: code_gen_b = S_ADDR; break;
         case N: code_gen_b = N_ADDR; break;
-        default: code_gen_b = cisp + inst_code_gen[inst][i].b; break;
+        default: code_gen_b = cisp + lowered->code[i].b; break;
         }
-        switch (inst_code_gen[inst][i].c){
+        // numeric a and b are words of the template, c is a code address unless it is a port or the halt,
+        // placeholders the code writes at run time are neither
+        bool a_code = (lowered->code[i].a < I && !lowered->patched[i * 3]) || lowered->code[i].a == L;
+        bool b_code = (lowered->code[i].b < I && !lowered->patched[i * 3 + 1]) || lowered->code[i].b == L;
+        bool c_code = lowered->code[i].a != N && lowered->code[i].b != N && lowered->code[i].c != N && !lowered->patched[i * 3 + 2];
+        switch (lowered->code[i].c){
         case I: code_gen_c = cicp; break;
-        case E: code_gen_c = cisp + inst_code_gen_sizes[inst] * 3; break;
+        case E: code_gen_c = cisp + lowered->size * 3; break;
         case A: code_gen_c = inst_a; break;
         case B: code_gen_c = inst_b; break;
+        case T: code_gen_c = inst_t; break;
         case N: code_gen_c = N_ADDR; break;
-        default: code_gen_c = cisp + inst_code_gen[inst][i].c * 3; break;
+        default: code_gen_c = cisp + lowered->code[i].c * 3; break;
         }
-        add_inst(code_gen_a, code_gen_b, code_gen_c);
+        add_inst(code_gen_a, code_gen_b, code_gen_c, a_code, b_code, c_code);
+        code_origin[binary_idx - 3] = (CodeOrigin){inst_token, (uint8_t)choice.code_gen, entry, (uint8_t)i, false};
         if (debug_mode) printf("CODE GEN: %d, %d, %d\n", code_gen_a, code_gen_b, code_gen_c);
     }
     tokenize();
 }
 
+// control flow pass - the code the third pass wrote is read back as a graph of subleq instructions and laid out again.
+// - liveness of the scratch registers over the whole program: {X, X, c} of a register that is dead at c only jumps (a goto),
+//   jumps to a goto are threaded to where it goes and the gotos are dropped, as is code that nothing reaches
+// - every instruction that can fall through wants the instruction it reaches next right after it. wants are granted by
+//   loop depth (back-edges in source order) and then source order, the rest get a goto of a register dead at the target.
+//   a conditional jump over a goto is inverted this way: its fall-through becomes the goto's target.
+//   with a profile the wants go by how often they fell through in the profiled run first
+// - instructions whose words the code patches are kept, a patched c (ljp, ret, jtb) can go to any label sjp or a jump
+//   table exposed or the return of any cal, and the ^label, >n and table words are rewritten to where they end up
+// - in an object (-c) the exported labels are entry points too, and a jump to an import or an ljp may go to another object,
+//   which may read any register
+#define CFG_NONE SIZE_MAX
+#define CFG_VISITING (SIZE_MAX - 1)
+#define REGISTERS_ALL 0x1F
+
+typedef struct {
+    size_t target; // the instruction c jumps to, cfg_count is the end of the code
+    size_t fall; // the instruction reached by not jumping, CFG_NONE if it always jumps or halts
+    bool dynamic; // c is patched, it goes to any exposed label
+    bool external; // c is an import, it goes to another object
+    bool pinned; // the code patches one of its words
+    bool kept;
+    bool in_order; // fall is the next kept instruction in source order
+    ZeroSet use, kill, live;
+    size_t forward; // where a jump to it ends up, itself unless it is a goto
+    size_t depth;
+    uint64_t weight; // times it fell through in the profile
+    size_t chain_next, chain_prev, chain_parent;
+    size_t address; // in the new layout
+} CfgInst;
+
+static bool source_order = false;
+static CfgInst* cfg = NULL;
+static size_t cfg_count = 0, cfg_code_start = 0, cfg_entry = 0;
+static size_t* cfg_exposed = NULL;
+static size_t cfg_exposed_count = 0;
+
+static inline ZeroSet register_at(WORD_UTYPE address) {
+    switch (address) {
+    case Z_ADDR: return register_bit(Z);
+    case P_ADDR: return register_bit(P);
+    case Q_ADDR: return register_bit(Q);
+    case R_ADDR: return register_bit(R);
+    case S_ADDR: return register_bit(S);
+    default: return 0;
+    }
+}
+static inline WORD_UTYPE register_address(ZeroSet dead) {
+    if (dead & register_bit(Z)) return Z_ADDR;
+    if (dead & register_bit(P)) return P_ADDR;
+    if (dead & register_bit(Q)) return Q_ADDR;
+    if (dead & register_bit(R)) return R_ADDR;
+    return S_ADDR;
+}
+static inline size_t cfg_index(size_t address) {
+    if (address < cfg_code_start || (address - cfg_code_start) % 3 || (address - cfg_code_start) / 3 > cfg_count) return CFG_NONE;
+    return (address - cfg_code_start) / 3;
+}
+
+// false if the code does something the pass does not understand, it is then left as it is
+static inline bool cfg_build(void) {
+    for (size_t w = cfg_code_start; w < binary_idx; ++w) {
+        if (!relocatable[w] || (w - cfg_code_start) % 3 == 2) continue;
+        if (binary[w] < cfg_code_start || binary[w] >= binary_idx) return false;
+        cfg[(binary[w] - cfg_code_start) / 3].pinned = true;
+    }
+    cfg_entry = cfg_index(binary[2]);
+    if (cfg_entry == CFG_NONE) return false;
+    for (size_t w = 0; w < cfg_code_start; ++w) {
+        if (!relocatable[w] || w == 2 || import_of(binary[w]) != SIZE_MAX) continue;
+        cfg_exposed[cfg_exposed_count] = cfg_index(binary[w]);
+        if (cfg_exposed[cfg_exposed_count++] == CFG_NONE) return false;
+    }
+    bool* patched = calloc(binary_idx - cfg_code_start, sizeof(bool));
+    if (!patched) { fprintf(stderr, "Control flow memory alloc failed\n"); exit(1); }
+    for (size_t w = cfg_code_start; w < binary_idx; ++w) {
+        if (relocatable[w] && (w - cfg_code_start) % 3 != 2) patched[binary[w] - cfg_code_start] = true;
+    }
+    bool ok = true;
+    for (size_t k = 0; k < cfg_count && ok; ++k) {
+        size_t w = cfg_code_start + k * 3;
+        WORD_UTYPE a = binary[w], b = binary[w + 1], c = binary[w + 2];
+        bool a_patched = patched[k * 3], b_patched = patched[k * 3 + 1];
+        CfgInst* inst = &cfg[k];
+        inst->target = inst->fall = CFG_NONE;
+        inst->chain_next = inst->chain_prev = CFG_NONE;
+        if (!a_patched && a == N_ADDR) { inst->fall = k + 1; inst->kill = b_patched ? 0 : register_at(b); continue; }
+        if (!b_patched && b == N_ADDR) { inst->fall = k + 1; inst->use = a_patched ? 0 : register_at(a); continue; }
+        // the halt of a ret is patched by its cal
+        if (!patched[k * 3 + 2] && !relocatable[w + 2] && c == N_ADDR) continue;
+        if (patched[k * 3 + 2]) inst->dynamic = true;
+        else if (relocatable[w + 2] && import_of(c) != SIZE_MAX) inst->external = true;
+        else if (!relocatable[w + 2] || (inst->target = cfg_index(c)) == CFG_NONE) ok = false;
+        // b - b is 0 whatever b was, so {X, X, c} always jumps and only writes X
+        if (!a_patched && !b_patched && a == b) inst->kill = register_at(b);
+        else {
+            inst->fall = k + 1;
+            inst->use = (a_patched ? 0 : register_at(a)) | (b_patched ? 0 : register_at(b));
+        }
+    }
+    free(patched);
+    cfg[cfg_count].target = cfg[cfg_count].fall = CFG_NONE;
+    cfg[cfg_count].chain_next = cfg[cfg_count].chain_prev = CFG_NONE;
+    return ok;
+}
+
+static inline void cfg_liveness(void) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        ZeroSet exposed_live = 0;
+        for (size_t i = 0; i < cfg_exposed_count; ++i) exposed_live |= cfg[cfg_exposed[i]].live;
+        for (size_t k = cfg_count; k-- > 0;) {
+            ZeroSet out = cfg[k].dynamic ? exposed_live : 0;
+            if (cfg[k].external || (cfg[k].dynamic && object_mode)) out = REGISTERS_ALL;
+            if (cfg[k].fall != CFG_NONE) out |= cfg[cfg[k].fall].live;
+            if (cfg[k].target != CFG_NONE) out |= cfg[cfg[k].target].live;
+            ZeroSet live = cfg[k].use | (out & (ZeroSet)~cfg[k].kill);
+            if (live != cfg[k].live) { cfg[k].live = live; changed = true; }
+        }
+    }
+}
+
+static inline bool cfg_is_goto(size_t k) {
+    const CfgInst* inst = &cfg[k];
+    return k < cfg_count && !inst->pinned && !inst->dynamic && inst->fall == CFG_NONE && inst->target != CFG_NONE
+        && inst->kill && !(cfg[inst->target].live & inst->kill);
+}
+// forward of every instruction, a cycle of gotos keeps the one it was entered at
+static inline void cfg_thread(void) {
+    size_t* path = malloc((cfg_count + 1) * sizeof(size_t));
+    if (!path) { fprintf(stderr, "Control flow memory alloc failed\n"); exit(1); }
+    for (size_t k = 0; k <= cfg_count; ++k) cfg[k].forward = CFG_NONE;
+    for (size_t k = 0; k <= cfg_count; ++k) {
+        size_t path_size = 0, i = k;
+        while (cfg[i].forward == CFG_NONE && cfg_is_goto(i)) { cfg[i].forward = CFG_VISITING; path[path_size++] = i; i = cfg[i].target; }
+        size_t end = cfg[i].forward == CFG_NONE || cfg[i].forward == CFG_VISITING ? i : cfg[i].forward;
+        cfg[end].forward = end;
+        for (size_t j = 0; j < path_size; ++j) if (path[j] != end) cfg[path[j]].forward = end;
+    }
+    free(path);
+    for (size_t k = 0; k < cfg_count; ++k) {
+        if (cfg[k].forward != k) continue;
+        if (cfg[k].target != CFG_NONE) cfg[k].target = cfg[cfg[k].target].forward;
+        if (cfg[k].fall != CFG_NONE) cfg[k].fall = cfg[cfg[k].fall].forward;
+    }
+    cfg_entry = cfg[cfg_entry].forward;
+    for (size_t i = 0; i < cfg_exposed_count; ++i) cfg_exposed[i] = cfg[cfg_exposed[i]].forward;
+}
+
+static inline void cfg_visit(size_t k, size_t* stack, size_t* stack_size) {
+    if (k == CFG_NONE || cfg[k].kept) return;
+    cfg[k].kept = true;
+    stack[(*stack_size)++] = k;
+}
+// what is left of the code: the instructions the entry, the exposed or exported labels or patched code reach
+static inline void cfg_reach(void) {
+    size_t* stack = malloc((cfg_count + 1) * sizeof(size_t));
+    if (!stack) { fprintf(stderr, "Control flow memory alloc failed\n"); exit(1); }
+    size_t stack_size = 0;
+    cfg_visit(cfg_entry, stack, &stack_size);
+    for (size_t i = code_start_token; i < tokens_count && object_mode; ++i) {
+        if (tokens[i].type == TOKEN_LABEL_DECL && exported(tokens[i].symbol)) cfg_visit(cfg[cfg_index(symbols[tokens[i].symbol].value)].forward, stack, &stack_size);
+    }
+    for (size_t i = 0; i < cfg_exposed_count; ++i) cfg_visit(cfg_exposed[i], stack, &stack_size);
+    for (size_t k = 0; k < cfg_count; ++k) if (cfg[k].pinned) cfg_visit(k, stack, &stack_size);
+    while (stack_size) {
+        size_t k = stack[--stack_size];
+        cfg_visit(cfg[k].fall, stack, &stack_size);
+        cfg_visit(cfg[k].target, stack, &stack_size);
+        if (cfg[k].dynamic) for (size_t i = 0; i < cfg_exposed_count; ++i) cfg_visit(cfg_exposed[i], stack, &stack_size);
+    }
+    cfg[cfg_count].kept = true;
+    free(stack);
+}
+
+// loop depth of the kept instructions, every back-edge in source order spans a loop
+static inline void cfg_depth(void) {
+    long* delta = calloc(cfg_count + 2, sizeof(long));
+    if (!delta) { fprintf(stderr, "Control flow memory alloc failed\n"); exit(1); }
+    for (size_t k = 0; k < cfg_count; ++k) {
+        if (!cfg[k].kept) continue;
+        if (cfg[k].fall != CFG_NONE && cfg[k].fall <= k) { ++delta[cfg[k].fall]; --delta[k + 1]; }
+        if (cfg[k].target != CFG_NONE && cfg[k].target <= k) { ++delta[cfg[k].target]; --delta[k + 1]; }
+    }
+    long depth = 0;
+    for (size_t k = 0; k <= cfg_count; ++k) {
+        depth += delta[k];
+        cfg[k].depth = (size_t)depth;
+    }
+    free(delta);
+    size_t next = cfg_count;
+    for (size_t k = cfg_count; k-- > 0;) {
+        cfg[k].in_order = cfg[k].fall == next;
+        if (cfg[k].kept) next = k;
+    }
+}
+
+// a goto the profiled layout added after an instruction counted its fall-throughs exactly,
+// else it fell through at most as often as it and the instruction it falls to ran
+static inline void cfg_weigh(void) {
+    for (size_t k = 0; k < cfg_count; ++k) {
+        if (!cfg[k].kept || cfg[k].fall == CFG_NONE) continue;
+        CodeOrigin origin = code_origin[cfg_code_start + k * 3];
+        uint64_t count, fall_count;
+        origin.fall = true;
+        if (profile_lookup(origin, &count)) { cfg[k].weight = count; continue; }
+        origin.fall = false;
+        if (!profile_lookup(origin, &count)) continue;
+        if (cfg[k].fall < cfg_count && profile_lookup(code_origin[cfg_code_start + cfg[k].fall * 3], &fall_count) && fall_count < count) count = fall_count;
+        cfg[k].weight = count;
+    }
+}
+
+static inline size_t cfg_chain_find(size_t k) {
+    while (cfg[k].chain_parent != k) {
+        cfg[k].chain_parent = cfg[cfg[k].chain_parent].chain_parent;
+        k = cfg[k].chain_parent;
+    }
+    return k;
+}
+// places the instruction k falls to right after it, unless that is taken or closes a cycle
+static inline bool cfg_link(size_t k) {
+    size_t fall = cfg[k].fall;
+    if (cfg[fall].chain_prev != CFG_NONE || fall == cfg_entry) return false;
+    size_t chain = cfg_chain_find(k), fall_chain = cfg_chain_find(fall);
+    if (chain == fall_chain) return false;
+    cfg[fall_chain].chain_parent = chain;
+    cfg[k].chain_next = fall;
+    cfg[fall].chain_prev = k;
+    return true;
+}
+static inline int cfg_compare_wants(const void* x, const void* y) {
+    const CfgInst* a = &cfg[*(const size_t*)x];
+    const CfgInst* b = &cfg[*(const size_t*)y];
+    if (a->weight != b->weight) return a->weight > b->weight ? -1 : 1;
+    if (a->depth != b->depth) return a->depth > b->depth ? -1 : 1;
+    if (a->in_order != b->in_order) return a->in_order ? -1 : 1;
+    return *(const size_t*)x < *(const size_t*)y ? -1 : 1;
+}
+static inline bool cfg_layout(void) {
+    size_t* wants = malloc((cfg_count + 1) * sizeof(size_t));
+    if (!wants) { fprintf(stderr, "Control flow memory alloc failed\n"); exit(1); }
+    size_t wants_count = 0;
+    for (size_t k = 0; k <= cfg_count; ++k) {
+        cfg[k].chain_parent = k;
+        if (k < cfg_count && cfg[k].kept && cfg[k].fall != CFG_NONE) wants[wants_count++] = k;
+    }
+    qsort(wants, wants_count, sizeof(size_t), cfg_compare_wants);
+    // without a dead register there is no goto to the instruction, falling through is the only way there
+    bool ok = true;
+    for (size_t i = 0; i < wants_count && ok; ++i) {
+        if ((cfg[cfg[wants[i]].fall].live & REGISTERS_ALL) == REGISTERS_ALL) ok = cfg_link(wants[i]);
+    }
+    for (size_t i = 0; i < wants_count && ok; ++i) {
+        if ((cfg[cfg[wants[i]].fall].live & REGISTERS_ALL) != REGISTERS_ALL) cfg_link(wants[i]);
+    }
+    free(wants);
+    return ok;
+}
+
+static inline WORD_UTYPE cfg_relocate(WORD_UTYPE address) {
+    return (WORD_UTYPE)cfg[cfg[cfg_index(address)].forward].address;
+}
+static inline WORD_UTYPE cfg_relocate_word(WORD_UTYPE word) {
+    return (WORD_UTYPE)(cfg[(word - cfg_code_start) / 3].address + (word - cfg_code_start) % 3);
+}
+static inline size_t cfg_chain_head(size_t k) {
+    while (cfg[k].chain_prev != CFG_NONE) k = cfg[k].chain_prev;
+    return k;
+}
+// chains in the order entry, the others by where they start in the source, the one ending in the end of the code last
+static inline size_t cfg_chain_order(size_t* heads) {
+    size_t end_head = cfg_chain_head(cfg_count);
+    size_t heads_count = 0;
+    if (cfg_entry != end_head) heads[heads_count++] = cfg_entry;
+    for (size_t k = 0; k < cfg_count; ++k) {
+        if (cfg[k].kept && cfg[k].chain_prev == CFG_NONE && k != cfg_entry && k != end_head) heads[heads_count++] = k;
+    }
+    heads[heads_count++] = end_head;
+    return heads_count;
+}
+static inline void cfg_emit(void) {
+    size_t* heads = malloc((cfg_count + 1) * sizeof(size_t));
+    WORD_UTYPE* code = malloc((binary_idx - cfg_code_start) * sizeof(WORD_UTYPE));
+    bool* code_relocatable = malloc((binary_idx - cfg_code_start) * sizeof(bool));
+    CodeOrigin* origins = malloc((binary_idx - cfg_code_start) * sizeof(CodeOrigin));
+    if (!heads || !code || !code_relocatable || !origins) { fprintf(stderr, "Control flow memory alloc failed\n"); exit(1); }
+    memcpy(code, binary + cfg_code_start, (binary_idx - cfg_code_start) * sizeof(WORD_UTYPE));
+    memcpy(code_relocatable, relocatable + cfg_code_start, (binary_idx - cfg_code_start) * sizeof(bool));
+    memcpy(origins, code_origin + cfg_code_start, (binary_idx - cfg_code_start) * sizeof(CodeOrigin));
+    size_t heads_count = cfg_chain_order(heads);
+    size_t address = cfg_code_start, gotos = 0;
+    for (size_t i = 0; i < heads_count; ++i) {
+        for (size_t k = heads[i]; k != CFG_NONE; k = cfg[k].chain_next) {
+            cfg[k].address = address;
+            if (k == cfg_count) break;
+            address += 3;
+            if (cfg[k].fall != CFG_NONE && cfg[k].chain_next != cfg[k].fall) { address += 3; ++gotos; }
+        }
+    }
+    for (size_t k = 0; k < cfg_count; ++k) if (!cfg[k].kept) cfg[k].address = cfg[cfg[k].forward].address;
+    if (debug_mode) printf("CONTROL FLOW: %zu instructions, %zu after layout with %zu gotos\n", cfg_count, (address - cfg_code_start) / 3, gotos);
+    binary_idx = cfg_code_start;
+    for (size_t i = 0; i < heads_count; ++i) {
+        for (size_t k = heads[i]; k != cfg_count && k != CFG_NONE; k = cfg[k].chain_next) {
+            WORD_UTYPE* fields = code + k * 3;
+            bool* fields_relocatable = code_relocatable + k * 3;
+            WORD_UTYPE a = fields_relocatable[0] ? cfg_relocate_word(fields[0]) : fields[0];
+            WORD_UTYPE b = fields_relocatable[1] ? cfg_relocate_word(fields[1]) : fields[1];
+            WORD_UTYPE c = fields[2];
+            if (cfg[k].target != CFG_NONE) c = (WORD_UTYPE)cfg[cfg[k].target].address;
+            add_inst(a, b, c, fields_relocatable[0], fields_relocatable[1], fields_relocatable[2]);
+            code_origin[binary_idx - 3] = origins[k * 3];
+            if (cfg[k].fall == CFG_NONE || cfg[k].chain_next == cfg[k].fall) continue;
+            WORD_UTYPE dead = register_address((ZeroSet)(~cfg[cfg[k].fall].live & REGISTERS_ALL));
+            add_inst(dead, dead, (WORD_UTYPE)cfg[cfg[k].fall].address, false, false, true);
+            code_origin[binary_idx - 3] = origins[k * 3];
+            code_origin[binary_idx - 3].fall = true;
+        }
+    }
+    for (size_t w = 0; w < cfg_code_start; ++w) if (relocatable[w] && import_of(binary[w]) == SIZE_MAX) binary[w] = cfg_relocate(binary[w]);
+    for (size_t i = code_start_token; i < tokens_count; ++i) {
+        if (tokens[i].type == TOKEN_LABEL_DECL) symbols[tokens[i].symbol].value = cfg_relocate(symbols[tokens[i].symbol].value);
+    }
+    free(heads);
+    free(code);
+    free(code_relocatable);
+    free(origins);
+}
+
+static inline void control_flow_pass(void) {
+    cfg_code_start = binary[2];
+    cfg_count = (binary_idx - cfg_code_start) / 3;
+    cfg_exposed_count = 0;
+    cfg = calloc(cfg_count + 1, sizeof(CfgInst));
+    cfg_exposed = malloc((cfg_code_start + 1) * sizeof(size_t));
+    if (!cfg || !cfg_exposed) { fprintf(stderr, "Control flow memory alloc failed\n"); exit(1); }
+    if (cfg_build()) {
+        cfg_liveness();
+        cfg_thread();
+        cfg_reach();
+        cfg_depth();
+        if (profile) cfg_weigh();
+        if (cfg_layout()) cfg_emit();
+    }
+    free(cfg);
+    free(cfg_exposed);
+    cfg = NULL;
+    cfg_exposed = NULL;
+}
+
+// worst case execution time (--wcet) - the finished code is read back as a graph of subleq instructions (a step each)
+// and the longest path over it is bounded. a loop is a strongly connected part entered at a single instruction, which
+// runs at most bound times every time the loop is entered, so the loop costs (bound - 1) times its longest pass and
+// then its longest way out. the bounds come from
+// - "; wcet loop <n>" on the line of the label the loop is entered at
+// - the template for the loops of mul, div, mod and the bitwise instructions: WORD_SIZE for the bit loops, the
+//   --loop-muldiv ones depend on their operands, and the count of cpy and fil. a variable can declare what it holds
+//   with "; wcet range <min> <max>" on its line (else any word)
+// ljp, ret and jtb are taken to go to any label sjp or a jump table took or the return of any cal. reported are the whole program and every label, from the label until
+// the program ends or the label is reached again (a pass of a loop it starts)
+#define WCET_NONE UINT64_MAX
+#define WCET_MAX (UINT64_MAX - 1)
+
+typedef struct {
+    size_t node;
+    uint64_t steps;
+} WcetPath;
+typedef struct {
+    WcetPath* paths;
+    size_t count, capacity;
+} WcetPaths;
+
+static bool wcet = false;
+// instructions are 0 to wcet_count - 1, wcet_count is the end of the program and wcet_count + 1 the jump to the code at address 0
+static size_t wcet_count = 0;
+static size_t *wcet_first = NULL, *wcet_successors = NULL;
+static size_t *wcet_label = NULL;
+static size_t *wcet_region = NULL, wcet_regions = 0;
+static size_t *wcet_headed = NULL;
+static bool wcet_designate = false;
+static uint64_t *wcet_in = NULL;
+static size_t *wcet_visit = NULL, wcet_visits = 0;
+static size_t *wcet_index = NULL, *wcet_low = NULL, *wcet_stack = NULL, *wcet_call = NULL, *wcet_edge = NULL;
+static bool *wcet_on_stack = NULL;
+static char wcet_error[256];
+
+static inline uint64_t wcet_sum(uint64_t a, uint64_t b) {
+    return a > WCET_MAX - b ? WCET_MAX : a + b;
+}
+static inline uint64_t wcet_times(uint64_t a, uint64_t b) {
+    return b && a > WCET_MAX / b ? WCET_MAX : a * b;
+}
+
+// the position of a token is where the lexer started to look for it, before the whitespace and comments in front of it
+static inline size_t token_start(size_t position) {
+    while (position < ctx.source_length) {
+        char c = ctx.source[position];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') ++position;
+        else if (c == ';') {
+            const char* comment_end = memchr(ctx.source + position, '\n', ctx.source_length - position);
+            position = comment_end ? (size_t)(comment_end - ctx.source) : ctx.source_length;
+        }
+        else break;
+    }
+    return position;
+}
+static inline size_t source_line(size_t position) {
+    size_t line, column, line_start;
+    PICOCT_position(&ctx, token_start(position), &line, &column, &line_start);
+    return line + 1;
+}
+// reads the numbers of "wcet <key>" from the comment on the line of a token
+static inline bool wcet_annotation(size_t position, const char* key, long* values, size_t count) {
+    position = token_start(position);
+    const char* line_end = memchr(ctx.source + position, '\n', ctx.source_length - position);
+    size_t end = line_end ? (size_t)(line_end - ctx.source) : ctx.source_length;
+    const char* comment = memchr(ctx.source + position, ';', end - position);
+    if (!comment) return false;
+    char text[256];
+    size_t length = (size_t)(ctx.source + end - comment);
+    if (length >= sizeof(text)) length = sizeof(text) - 1;
+    memcpy(text, comment, length);
+    text[length] = '\0';
+    char* at = strstr(text, "wcet ");
+    size_t key_length = strlen(key);
+    while (at && (strncmp(at + 5, key, key_length) != 0 || at[5 + key_length] != ' ')) at = strstr(at + 5, "wcet ");
+    if (!at) return false;
+    char* cursor = at + 5 + key_length;
+    for (size_t i = 0; i < count; ++i) {
+        char* number_end;
+        values[i] = strtol(cursor, &number_end, 10);
+        if (number_end == cursor) return false;
+        cursor = number_end;
+    }
+    return true;
+}
+// the range of an operand token, a number is itself and a variable what its declaration says
+static inline void wcet_range(const Token* operand, long* min, long* max) {
+    *min = -32768;
+    *max = 32767;
+    if (operand->type == TOKEN_NUMBER) { *min = *max = (WORD_STYPE)operand->number; return; }
+    for (size_t i = 0; i < code_start_token; ++i) {
+        if (tokens[i].type != TOKEN_IDENTIFIER || tokens[i].symbol != operand->symbol) continue;
+        long range[2];
+        if (wcet_annotation(tokens[i].position, "range", range, 2) && range[0] <= range[1]) {
+            *min = range[0] < -32768 ? -32768 : range[0];
+            *max = range[1] > 32767 ? 32767 : range[1];
+        }
+        return;
+    }
+}
+static inline long wcet_magnitude_max(long min, long max) {
+    return -min > max ? -min : max;
+}
+static inline long wcet_magnitude_min(long min, long max) {
+    if (min <= 0 && max >= 0) return 0;
+    return min > 0 ? min : -max;
+}
+
+static inline void wcet_describe(size_t k, char* text, size_t size) {
+    if (wcet_label[k] != SIZE_MAX) {
+        const Token* label = &tokens[wcet_label[k]];
+        snprintf(text, size, "$%s (line %zu)", symbol_name(label->symbol), source_line(label->position));
+        return;
+    }
+    const Token* inst_token = &tokens[code_origin[binary[2] + k * 3].token];
+    snprintf(text, size, "the %s at line %zu", inst_name(inst_token->type), source_line(inst_token->position));
+}
+static inline bool wcet_fail(size_t k, const char* reason) {
+    if (wcet_error[0]) return false;
+    char where[128];
+    wcet_describe(k, where, sizeof(where));
+    snprintf(wcet_error, sizeof(wcet_error), "the loop at %s %s", where, reason);
+    return false;
+}
+
+// how many times the header k of the loop order[begin, end) runs every time the loop is entered, only reported if asked to.
+// a template bounds its loops only if they are all in it
+static inline bool wcet_loop_bound(size_t k, const size_t* order, size_t begin, size_t end, uint64_t* bound, bool report) {
+    if (wcet_label[k] != SIZE_MAX) {
+        for (size_t i = wcet_label[k]; i < tokens_count && tokens[i].type == TOKEN_LABEL_DECL; ++i) {
+            long value;
+            if (wcet_annotation(tokens[i].position, "loop", &value, 1) && value > 0) { *bound = (uint64_t)value; return true; }
+        }
+        return report && wcet_fail(k, "has no bound, add ; wcet loop <n> to its label");
+    }
+    CodeOrigin origin = code_origin[binary[2] + k * 3];
+    for (size_t i = begin; i < end; ++i) {
+        if (order[i] >= wcet_count || code_origin[binary[2] + order[i] * 3].token != origin.token) return report && wcet_fail(k, "has no bound");
+    }
+    long a_min, a_max, b_min, b_max;
+    wcet_range(&tokens[origin.token + 1], &a_min, &a_max);
+    wcet_range(&tokens[origin.token + 2], &b_min, &b_max);
+    switch (origin.code_gen) {
+    case TOKEN_INST_MUL: case TOKEN_INST_DIV: case TOKEN_INST_MOD:
+    case TOKEN_INST_AND: case TOKEN_INST_OR: case TOKEN_INST_XOR: case TOKEN_INST_SHL: case TOKEN_INST_SHR:
+        *bound = WORD_SIZE;
+        return true;
+    // the loop runs n times, n is the third operand
+    case TOKEN_INST_CPY: case TOKEN_INST_FIL: case CODE_GEN_FIL_ZERO: {
+        long n_min, n_max;
+        wcet_range(&tokens[origin.token + 3], &n_min, &n_max);
+        *bound = n_max > 0 ? (uint64_t)n_max : 1;
+        return true;
+    }
+    case CODE_GEN_MUL_LOOP:
+        *bound = (uint64_t)wcet_magnitude_max(a_min, a_max) + 1;
+        return true;
+    case CODE_GEN_DIV_LOOP: case CODE_GEN_MOD_LOOP:
+        if (!wcet_magnitude_min(a_min, a_max)) return report && wcet_fail(k, "may divide by 0, declare a range without 0 for the divisor");
+        if (a_min == -32768) return report && wcet_fail(k, "may not end for the divisor -32768, declare a range without it");
+        *bound = (uint64_t)(wcet_magnitude_max(b_min, b_max) / wcet_magnitude_min(a_min, a_max)) + 1;
+        return true;
+    default:
+        // the immediate and unrolled templates only jump back to redo a part of them once
+        if (origin.code_gen < CODE_GEN_MUL_UNROLLED) return report && wcet_fail(k, "has no bound");
+        *bound = 2;
+        return true;
+    }
+}
+
+static inline void wcet_path(WcetPaths* paths, size_t node, uint64_t steps) {
+    if (paths->count == paths->capacity) {
+        paths->capacity = paths->capacity ? paths->capacity * 2 : 16;
+        paths->paths = realloc(paths->paths, paths->capacity * sizeof(WcetPath));
+        if (!paths->paths) { fprintf(stderr, "WCET memory alloc failed\n"); exit(1); }
+    }
+    paths->paths[paths->count++] = (WcetPath){node, steps};
+}
+
+// the strongly connected parts of the region that h reaches without an edge back into h, in topological order:
+// order holds their instructions and part_end where every part ends in it
+static inline size_t wcet_parts(size_t h, size_t region, size_t* order, size_t* part_end, size_t* parts) {
+    size_t visit = ++wcet_visits;
+    size_t counter = 0, ordered = 0, stack_size = 0, call_size = 0;
+    *parts = 0;
+    wcet_visit[h] = visit;
+    wcet_index[h] = wcet_low[h] = counter++;
+    wcet_stack[stack_size++] = h;
+    wcet_on_stack[h] = true;
+    wcet_call[call_size] = h;
+    wcet_edge[call_size++] = wcet_first[h];
+    while (call_size) {
+        size_t v = wcet_call[call_size - 1];
+        if (wcet_edge[call_size - 1] < wcet_first[v + 1]) {
+            size_t w = wcet_successors[wcet_edge[call_size - 1]++];
+            if (w == h || wcet_region[w] != region) continue;
+            if (wcet_visit[w] != visit) {
+                wcet_visit[w] = visit;
+                wcet_index[w] = wcet_low[w] = counter++;
+                wcet_stack[stack_size++] = w;
+                wcet_on_stack[w] = true;
+                wcet_call[call_size] = w;
+                wcet_edge[call_size++] = wcet_first[w];
+            }
+            else if (wcet_on_stack[w] && wcet_index[w] < wcet_low[v]) wcet_low[v] = wcet_index[w];
+            continue;
+        }
+        if (wcet_low[v] == wcet_index[v]) {
+            size_t w;
+            do {
+                w = wcet_stack[--stack_size];
+                wcet_on_stack[w] = false;
+                order[ordered++] = w;
+            } while (w != v);
+            part_end[(*parts)++] = ordered;
+        }
+        if (--call_size) {
+            size_t u = wcet_call[call_size - 1];
+            if (wcet_low[v] < wcet_low[u]) wcet_low[u] = wcet_low[v];
+        }
+    }
+    // tarjan finds a part after every part it reaches, so the reverse is the topological order.
+    // reversed, the part that ended at part_end[i] starts at ordered - part_end[i]
+    for (size_t i = 0, j = ordered; i < j--; ++i) { size_t t = order[i]; order[i] = order[j]; order[j] = t; }
+    for (size_t i = 0, j = *parts; i < j--; ++i) { size_t t = part_end[i]; part_end[i] = part_end[j]; part_end[j] = t; }
+    for (size_t i = 0; i + 1 < *parts; ++i) part_end[i] = ordered - part_end[i + 1];
+    if (*parts) part_end[*parts - 1] = ordered;
+    return ordered;
+}
+
+static inline void wcet_route(size_t h, size_t region, size_t target, uint64_t steps, uint64_t* iteration, WcetPaths* exits) {
+    if (target == h) { if (steps > *iteration) *iteration = steps; }
+    else if (wcet_region[target] == region) { if (wcet_in[target] == WCET_NONE || steps > wcet_in[target]) wcet_in[target] = steps; }
+    else wcet_path(exits, target, steps);
+}
+static inline bool wcet_analyze(size_t h, size_t region, const WcetPaths* entries, uint64_t* iteration, WcetPaths* exits);
+// a loop is the part order[begin, end) entered at the instructions with a wcet_in. seen from the start of the program its header
+// is the entry with a bound, else the one most of the loop jumps back to, and is remembered in wcet_headed with the size of the loop.
+// from a label the loop can be entered in the middle, then the header is the one of the biggest loop it is in
+// and the way from where it is entered to the header is added in front
+static inline bool wcet_loop(size_t h, size_t region, const size_t* order, size_t begin, size_t end, uint64_t* iteration, WcetPaths* exits) {
+    WcetPaths entries = {0};
+    size_t header = SIZE_MAX, header_rank = 0;
+    size_t inner = ++wcet_regions;
+    for (size_t i = begin; i < end; ++i) wcet_region[order[i]] = inner;
+    for (size_t i = begin; i < end; ++i) {
+        size_t v = order[i];
+        if (wcet_in[v] != WCET_NONE) wcet_path(&entries, v, wcet_in[v]);
+        size_t rank = 0;
+        uint64_t unused;
+        if (wcet_headed[v]) rank = 2 * (wcet_count + 2) + wcet_headed[v];
+        else if (wcet_in[v] != WCET_NONE) {
+            rank = 1;
+            for (size_t u = begin; u < end; ++u) {
+                for (size_t e = wcet_first[order[u]]; e < wcet_first[order[u] + 1]; ++e) rank += wcet_successors[e] == v;
+            }
+            if (wcet_loop_bound(v, order, begin, end, &unused, false)) rank += wcet_count + 2;
+        }
+        if (rank > header_rank) { header = v; header_rank = rank; }
+    }
+    if (wcet_designate && end - begin > wcet_headed[header]) wcet_headed[header] = end - begin;
+    // the loops in it are still gone through without a bound, to find their headers
+    uint64_t bound = 1, pass, arrival = wcet_in[header] == WCET_NONE ? 0 : wcet_in[header];
+    WcetPaths first_exits = {0}, loop_exits = {0};
+    bool ok = wcet_loop_bound(header, order, begin, end, &bound, true);
+    if (entries.count > 1 || entries.paths[0].node != header) {
+        ok &= wcet_analyze(header, inner, &entries, &pass, &first_exits);
+        if (pass > arrival) arrival = pass;
+        for (size_t i = begin; i < end; ++i) wcet_region[order[i]] = inner;
+    }
+    ok &= wcet_analyze(header, inner, NULL, &pass, &loop_exits);
+    uint64_t before = wcet_sum(arrival, wcet_times(bound - 1, pass));
+    for (size_t i = 0; i < first_exits.count && ok; ++i) wcet_route(h, region, first_exits.paths[i].node, first_exits.paths[i].steps, iteration, exits);
+    for (size_t i = 0; i < loop_exits.count && ok; ++i) {
+        wcet_route(h, region, loop_exits.paths[i].node, wcet_sum(before, loop_exits.paths[i].steps), iteration, exits);
+    }
+    free(entries.paths);
+    free(first_exits.paths);
+    free(loop_exits.paths);
+    return ok;
+}
+// the longest paths from h (or from entries) through its region: the longest back to h in iteration, the longest to every way out in exits
+static inline bool wcet_analyze(size_t h, size_t region, const WcetPaths* entries, uint64_t* iteration, WcetPaths* exits) {
+    size_t* order = malloc((wcet_count + 2) * sizeof(size_t));
+    size_t* part_end = malloc((wcet_count + 2) * sizeof(size_t));
+    if (!order || !part_end) { fprintf(stderr, "WCET memory alloc failed\n"); exit(1); }
+    size_t parts;
+    size_t ordered = wcet_parts(h, region, order, part_end, &parts);
+    for (size_t i = 0; i < ordered; ++i) wcet_in[order[i]] = WCET_NONE;
+    if (entries) for (size_t i = 0; i < entries->count; ++i) wcet_in[entries->paths[i].node] = entries->paths[i].steps;
+    else wcet_in[h] = 0;
+    *iteration = 0;
+    bool ok = true;
+    for (size_t part = 0, begin = 0; part < parts; begin = part_end[part++]) {
+        size_t end = part_end[part];
+        size_t v = order[begin];
+        bool loop = end - begin > 1;
+        for (size_t e = wcet_first[v]; e < wcet_first[v + 1] && !loop; ++e) loop = wcet_successors[e] == v && v != h;
+        if (loop) {
+            bool entered = false;
+            for (size_t i = begin; i < end; ++i) entered |= wcet_in[order[i]] != WCET_NONE;
+            if (entered) ok &= wcet_loop(h, region, order, begin, end, iteration, exits);
+            continue;
+        }
+        if (wcet_in[v] == WCET_NONE) continue;
+        uint64_t steps = wcet_sum(wcet_in[v], v == wcet_count ? 0 : 1);
+        for (size_t e = wcet_first[v]; e < wcet_first[v + 1]; ++e) wcet_route(h, region, wcet_successors[e], steps, iteration, exits);
+    }
+    free(order);
+    free(part_end);
+    return ok;
+}
+
+static inline void wcet_report(const char* name, size_t start) {
+    size_t region = ++wcet_regions;
+    for (size_t k = 0; k < wcet_count + 2; ++k) wcet_region[k] = region;
+    wcet_region[wcet_count] = 0;
+    wcet_error[0] = '\0';
+    uint64_t iteration = 0, steps = 0;
+    WcetPaths exits = {0};
+    bool ok = start == wcet_count || wcet_analyze(start, region, NULL, &iteration, &exits);
+    if (ok) {
+        steps = iteration;
+        for (size_t i = 0; i < exits.count; ++i) if (exits.paths[i].steps > steps) steps = exits.paths[i].steps;
+    }
+    free(exits.paths);
+    if (!ok) printf("WCET %s: unbounded, %s\n", name, wcet_error);
+    else if (steps == WCET_MAX) printf("WCET %s: more than %llu steps\n", name, (unsigned long long)WCET_MAX);
+    else printf("WCET %s: %llu steps\n", name, (unsigned long long)steps);
+}
+
+static inline void wcet_pass(void) {
+    size_t code_start = binary[2];
+    wcet_count = (binary_idx - code_start) / 3;
+    size_t nodes = wcet_count + 2;
+    wcet_first = calloc(nodes + 1, sizeof(size_t));
+    wcet_label = malloc(nodes * sizeof(size_t));
+    wcet_region = calloc(nodes, sizeof(size_t));
+    wcet_headed = calloc(nodes, sizeof(size_t));
+    wcet_in = malloc(nodes * sizeof(uint64_t));
+    wcet_visit = calloc(nodes, sizeof(size_t));
+    wcet_index = malloc(nodes * sizeof(size_t));
+    wcet_low = malloc(nodes * sizeof(size_t));
+    wcet_stack = malloc(nodes * sizeof(size_t));
+    wcet_call = malloc(nodes * sizeof(size_t));
+    wcet_edge = malloc(nodes * sizeof(size_t));
+    wcet_on_stack = calloc(nodes, sizeof(bool));
+    size_t* exposed = malloc((code_start + 1) * sizeof(size_t));
+    bool* patched = calloc(binary_idx - code_start + 1, sizeof(bool));
+    if (!wcet_first || !wcet_label || !wcet_region || !wcet_headed || !wcet_in || !wcet_visit || !wcet_index || !wcet_low || !wcet_stack
+        || !wcet_call || !wcet_edge || !wcet_on_stack || !exposed || !patched) { fprintf(stderr, "WCET memory alloc failed\n"); exit(1); }
+    size_t exposed_count = 0;
+    for (size_t w = 0; w < code_start; ++w) if (relocatable[w] && w != 2) exposed[exposed_count++] = (binary[w] - code_start) / 3;
+    for (size_t w = code_start; w < binary_idx; ++w) if (relocatable[w] && (w - code_start) % 3 != 2) patched[binary[w] - code_start] = true;
+    // the successors, counted first and then filled in
+    for (int fill = 0; fill < 2; ++fill) {
+        size_t edges = 0;
+        for (size_t k = 0; k < nodes; ++k) {
+            size_t successors[2], successors_count = 0;
+            bool dynamic = false;
+            if (k == wcet_count + 1) successors[successors_count++] = (binary[2] - code_start) / 3;
+            else if (k < wcet_count) {
+                size_t w = code_start + k * 3;
+                WORD_UTYPE a = binary[w], b = binary[w + 1], c = binary[w + 2];
+                bool a_patched = patched[k * 3], b_patched = patched[k * 3 + 1];
+                if ((!a_patched && a == N_ADDR) || (!b_patched && b == N_ADDR)) successors[successors_count++] = k + 1;
+                else if (!patched[k * 3 + 2] && !relocatable[w + 2] && c == N_ADDR) successors[successors_count++] = wcet_count;
+                else {
+                    if (a_patched || b_patched || a != b) successors[successors_count++] = k + 1;
+                    if (patched[k * 3 + 2]) dynamic = true;
+                    else successors[successors_count++] = c >= code_start && c < binary_idx ? (size_t)(c - code_start) / 3 : wcet_count;
+                }
+            }
+            if (!fill) { wcet_first[k + 1] = wcet_first[k] + successors_count + (dynamic ? exposed_count : 0); continue; }
+            for (size_t i = 0; i < successors_count; ++i) wcet_successors[edges++] = successors[i];
+            if (dynamic) for (size_t i = 0; i < exposed_count; ++i) wcet_successors[edges++] = exposed[i];
+        }
+        if (!fill) {
+            wcet_successors = malloc((wcet_first[nodes] + 1) * sizeof(size_t));
+            if (!wcet_successors) { fprintf(stderr, "WCET memory alloc failed\n"); exit(1); }
+        }
+    }
+    for (size_t k = 0; k < nodes; ++k) wcet_label[k] = SIZE_MAX;
+    for (size_t i = code_start_token; i < tokens_count; ++i) {
+        if (tokens[i].type != TOKEN_LABEL_DECL) continue;
+        WORD_UTYPE address = symbols[tokens[i].symbol].value;
+        if (address < code_start || address > binary_idx) continue;
+        size_t k = (address - code_start) / 3;
+        if (wcet_label[k] == SIZE_MAX) wcet_label[k] = i;
+    }
+    // the program goes first, it decides the headers of the loops
+    wcet_designate = true;
+    wcet_report("program", wcet_count + 1);
+    wcet_designate = false;
+    for (size_t i = code_start_token; i < tokens_count; ++i) {
+        if (tokens[i].type != TOKEN_LABEL_DECL) continue;
+        char name[MAX_IDENTIFIER_LENGTH + 2];
+        snprintf(name, sizeof(name), "$%s", symbol_name(tokens[i].symbol));
+        WORD_UTYPE address = symbols[tokens[i].symbol].value;
+        // the control flow pass drops the code nothing reaches
+        if (address < code_start || address > binary_idx) printf("WCET %s: never reached\n", name);
+        else wcet_report(name, (address - code_start) / 3);
+    }
+    free(exposed);
+    free(patched);
+    free(wcet_first); free(wcet_successors); free(wcet_label); free(wcet_region); free(wcet_headed); free(wcet_in); free(wcet_visit);
+    free(wcet_index); free(wcet_low); free(wcet_stack); free(wcet_call); free(wcet_edge); free(wcet_on_stack);
+}
+
+// --time-passes: the wall time of every pass and the peak memory of the assembler once it is done
+static bool time_passes = false;
+static struct timespec time_mark;
+static inline void time_start(void) {
+    timespec_get(&time_mark, TIME_UTC);
+}
+static inline void time_pass(const char* name) {
+    if (!time_passes) return;
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    double ms = (double)(now.tv_sec - time_mark.tv_sec) * 1e3 + (double)(now.tv_nsec - time_mark.tv_nsec) / 1e6;
+    long peak_kib = -1;
+    #if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    // bytes on macOS, KiB elsewhere
+    if (getrusage(RUSAGE_SELF, &usage) == 0) peak_kib = usage.ru_maxrss;
+    #if defined(__APPLE__)
+    peak_kib /= 1024;
+    #endif
+    #endif
+    if (peak_kib >= 0) printf("TIME %-14s %10.3f ms, peak %ld KiB\n", name, ms, peak_kib);
+    else printf("TIME %-14s %10.3f ms\n", name, ms);
+    timespec_get(&time_mark, TIME_UTC);
+}
+
 static inline void assemble(void) {
     if (debug_mode) printf("%s\n", ctx.source);
     add_binary_header();
+    lex_source();
+    time_pass("lex");
+    if (profile) profile_count_tokens();
     if (debug_mode) printf("===========DATA SECTION (variables, arrays, allocs)===========\n");
     tokenize();
     while (token != TOKEN_EOS) { if (!data_section_pass()) break; }
     if (!start_found) PICOCT_error_printf(&ctx, "__start__ symbol not found");
+    time_pass("data pass");
     if (debug_mode) printf("===========FIRST PASS (immediate collection)===========\n");
-    saved_cursor = ctx.cursor;
+    code_start_token = token_index;
+    rodata_start = binary_idx;
+    if (object_mode) import_undeclared(TOKEN_IDENTIFIER);
+    scan_links();
     tokenize();
     while (token != TOKEN_EOS) { first_pass(); }
+    time_pass("first pass");
     if (debug_mode) printf("===========SECOND PASS (label collection)===========\n");
-    ctx.cursor = saved_cursor;
+    token_index = code_start_token;
+    zero_registers = ZERO_ALL;
+    bank_selected = BANK_NONE;
     tokenize();
     while (token != TOKEN_EOS) { second_pass(); }
+    if (object_mode) import_undeclared(TOKEN_LABEL_USE);
+    time_pass("second pass");
     if (debug_mode) printf("===========THIRD PASS (syntax check and code gen)===========\n");
-    ctx.cursor = saved_cursor;
+    token_index = code_start_token;
+    zero_registers = ZERO_ALL;
+    bank_selected = BANK_NONE;
     tokenize();
     while (token != TOKEN_EOS) { third_pass(); }
+    time_pass("third pass");
+    if (!source_order) {
+        if (debug_mode) printf("===========CONTROL FLOW PASS (jump threading and layout)===========\n");
+        control_flow_pass();
+        time_pass("control flow");
+    }
+    if (banks_count && binary_idx > BANK_BASE) { fprintf(stderr, "Program of %zu words reaches into the bank window at %d\n", binary_idx, BANK_BASE); exit(1); }
+    if (object_mode && binary_idx > N_ADDR - imports_count) { fprintf(stderr, "Object too large for its imports\n"); exit(1); }
     if (debug_mode) printf("==================================================\n");
     if (debug_mode) print_inst_costs();
     if (debug_mode) print_state();
@@ -675,25 +2677,305 @@ static inline bool read_entire_file(const char* file_path, FileBytes* file_bytes
     fclose(file_handle);
     return ok;
 }
-static inline bool write_binary(const char* file_path) {
-    FILE* file = fopen(file_path, "wb");
+static inline int compare_image_symbols(const void* x, const void* y) {
+    return (int)((const ImageSymbol*)x)->address - (int)((const ImageSymbol*)y)->address;
+}
+// a sectioned image, see image_format.c, with the variables and labels when symbols is set
+static inline bool write_binary(const char* file_path, bool symbols_section) {
+    ImageSymbol* image_symbols = NULL;
+    size_t image_symbols_count = 0;
+    if (symbols_section) {
+        image_symbols = malloc((symbols_count + 1) * sizeof(ImageSymbol));
+        bool* label = calloc(symbols_count + 1, sizeof(bool));
+        if (!image_symbols || !label) { fprintf(stderr, "Binary memory alloc failed\n"); exit(1); }
+        for (size_t i = code_start_token; i < tokens_count; ++i) if (tokens[i].type == TOKEN_LABEL_DECL) label[tokens[i].symbol] = true;
+        for (SymbolId id = 0; id < symbols_count; ++id) {
+            const char* name = symbol_name(id);
+            if (!symbols[id].defined || name[0] == '#' || name[0] == '^' || name[0] == '&' || name[0] == '>' || name[0] == '~' || name[0] == '%') continue;
+            // the control flow pass moves the labels of code it dropped to 0
+            if (label[id] && symbols[id].value < binary[2]) continue;
+            image_symbols[image_symbols_count++] = (ImageSymbol){label[id] ? IMAGE_CODE : IMAGE_DATA, symbols[id].value, name};
+        }
+        free(label);
+        qsort(image_symbols, image_symbols_count, sizeof(ImageSymbol), compare_image_symbols);
+    }
+    bool ok = image_write(file_path, binary, binary_idx, rodata_start, binary[2], image_symbols, image_symbols_count);
+    free(image_symbols);
+    return ok;
+}
+// one "<address> <token> <code_gen> <zero> <index> <fall>" line per instruction, see CodeOrigin
+static inline bool write_map(const char* file_path) {
+    FILE* file = fopen(file_path, "w");
     if (file == NULL) return false;
-    size_t written = fwrite(binary, sizeof(WORD_UTYPE), binary_idx, file);
-    fclose(file);
-    return written == binary_idx;
+    bool ok = true;
+    for (size_t address = binary[2]; address + 2 < binary_idx && ok; address += 3) {
+        CodeOrigin origin = code_origin[address];
+        ok = fprintf(file, "%zu %u %u %u %u %d\n", address, origin.token, origin.code_gen, origin.zero, origin.index, origin.fall) > 0;
+    }
+    if (fclose(file) != 0) ok = false;
+    return ok;
+}
+
+// native c backend (--emit-c) - every source instruction becomes the c statement with the result of its template, so the
+// compiler sees a mul instead of its steps. the generated file is built into the emulator, which keeps the devices and
+// their bindings: gcc -I. -DSUBLANQ_NATIVE='"program.c"' emulator/emulate.c. memory starts as the assembled image, so
+// addresses, adr and sjp are the same as in program.sq. the results are the ones of the templates where c differs:
+// jlz, jez and jge test the negated word so -32768 counts as not negative, and div and mod by 0 give what the bit loop
+// leaves. ljp to a label whose address sjp takes stays native, to any other address it continues in the interpreter
+static inline void c_operand(FILE* file, const Token* operand) {
+    if (operand->type == TOKEN_NUMBER) fprintf(file, (WORD_STYPE)operand->number < 0 ? "(%d)" : "%d", (WORD_STYPE)operand->number);
+    else fprintf(file, "m[%u]", symbols[operand->symbol].value);
+}
+static inline void c_statement(FILE* file, const char* format, const Token* operands) {
+    // %a, %b and %t are the operands, %l the label in b, %p the port in a or b
+    fputs("    ", file);
+    for (const char* c = format; *c; ++c) {
+        if (*c != '%') { fputc(*c, file); continue; }
+        ++c;
+        const Token* operand = &operands[*c == 'a' ? 0 : *c == 't' ? 2 : 1];
+        if (*c == 'a' || *c == 'b' || *c == 't') c_operand(file, operand);
+        else if (*c == 'l') fprintf(file, "l%u", operands[inst_syntax_types[inst] == IST_LABEL || inst_syntax_types[inst] == IST_LABEL_ADDR ? 0 : 1].symbol);
+        else if (*c == 'p') fprintf(file, "%u", operands[inst == TOKEN_INST_INP ? 0 : 1].number);
+    }
+    fputc('\n', file);
+}
+static inline bool write_c(const char* file_path, const char* source_path) {
+    FILE* file = fopen(file_path, "w");
+    if (file == NULL) return false;
+    bool* used = calloc(symbols_count + 1, sizeof(bool));
+    if (!used) { fprintf(stderr, "Emit memory alloc failed\n"); exit(1); }
+    // a label is only written when something jumps to it, sjp alone does not without an ljp
+    bool dispatch = false;
+    bool* tabled = calloc(symbols_count + 1, sizeof(bool));
+    if (!tabled) { fprintf(stderr, "Emit memory alloc failed\n"); exit(1); }
+    for (size_t i = code_start_token; i < tokens_count; ++i) {
+        dispatch |= tokens[i].type == TOKEN_INST_LJP || tokens[i].type == TOKEN_INST_RET || tokens[i].type == TOKEN_INST_JTB;
+        if (tokens[i].type != TOKEN_INST_JTB) continue;
+        for (size_t l = 0; l < jtb_labels_count(i + 2); ++l) tabled[tokens[i + 2 + 2 * l].symbol] = true;
+    }
+    for (size_t i = code_start_token + 1; i < tokens_count; ++i) {
+        if (tokens[i].type == TOKEN_LABEL_USE && tokens[i - 1].type != TOKEN_INST_SJP) used[tokens[i].symbol] = true;
+        if (tokens[i].type == TOKEN_LABEL_DECL && dispatch && symbol_exist(symbol_prefixed('^', tokens[i].symbol))) used[tokens[i].symbol] = true;
+    }
+    // the addresses the dispatch has a label case for, a return to one of them goes through that case and gets no label
+    bool* taken = calloc(binary_idx + 1, sizeof(bool));
+    if (!taken) { fprintf(stderr, "Emit memory alloc failed\n"); exit(1); }
+    for (size_t i = code_start_token; i < tokens_count && dispatch; ++i) {
+        if (tokens[i].type == TOKEN_LABEL_DECL && (symbol_exist(symbol_prefixed('^', tokens[i].symbol)) || tabled[tokens[i].symbol])) taken[symbols[tokens[i].symbol].value] = true;
+    }
+    fprintf(file, "// generated by asm --emit-c from %s, see write_c in assembler/asm.c\n", source_path);
+    fprintf(file, "static const WORD_UTYPE sublanq_native_image[%zu] = {", binary_idx);
+    for (size_t i = 0; i < binary_idx; ++i) fprintf(file, "%s%u,", i % 16 ? " " : "\n    ", binary[i]);
+    fprintf(file, "\n};\n#define sublanq_native_size %zu\n\n", binary_idx);
+    fprintf(file, "static inline WORD_STYPE sublanq_native_div(WORD_STYPE b, WORD_STYPE a) {\n"
+                  "    if (a == 0) return b == 0 ? 0 : b == -32768 ? -1 : (WORD_STYPE)(b > 0 ? 4 * b + 3 : -(-4 * b + 3));\n"
+                  "    return (WORD_STYPE)(b / a);\n}\n"
+                  "static inline WORD_STYPE sublanq_native_mod(WORD_STYPE b, WORD_STYPE a) {\n"
+                  "    if (a == 0) return b == -32768 ? -2 : b >= 16384 ? 1 : b <= -16384 ? -1 : 0;\n"
+                  "    return (WORD_STYPE)(b %% a);\n}\n"
+                  "static inline WORD_STYPE sublanq_native_shl(WORD_STYPE b, WORD_STYPE a) {\n"
+                  "    return a <= 0 ? b : a >= WORD_SIZE ? 0 : (WORD_STYPE)((WORD_UTYPE)b << a);\n}\n"
+                  "static inline WORD_STYPE sublanq_native_shr(WORD_STYPE b, WORD_STYPE a) {\n"
+                  "    return a <= 0 ? b : a >= WORD_SIZE ? 0 : (WORD_STYPE)((WORD_UTYPE)b >> a);\n}\n"
+                  "#define SUBLANQ_NATIVE_PORT(port) ((port) < SUBLANQ_PORT_COUNT ? (port) : SUBLANQ_PORT_COUNT)\n"
+                  "#define SUBLANQ_NATIVE_IN(port) (WORD_STYPE)vm->inputs[SUBLANQ_NATIVE_PORT(port)].fn(vm, vm->inputs[SUBLANQ_NATIVE_PORT(port)].user, port)\n"
+                  "#define SUBLANQ_NATIVE_OUT(port, value) vm->outputs[SUBLANQ_NATIVE_PORT(port)].fn(vm, vm->outputs[SUBLANQ_NATIVE_PORT(port)].user, port, (WORD_UTYPE)(value))\n\n");
+    fprintf(file, "// runs the program from its start, returns SUBLANQ_STOP_BUDGET with vm->pc set when it continues in the interpreter\n"
+                  "static SUBLANQ_Stop sublanq_native_run(SUBLANQ_VM* vm) {\n    WORD_STYPE* const m = vm->memory;\n    (void)m;\n");
+    if (dispatch) fprintf(file, "    WORD_UTYPE target;\n");
+
+    static const char* statements[TOKEN__INST_END] = {
+        [TOKEN_INST_ZER] = "%a = 0;", [TOKEN_INST_INC] = "%a = (WORD_STYPE)(%a + 1);", [TOKEN_INST_DEC] = "%a = (WORD_STYPE)(%a - 1);",
+        [TOKEN_INST_NEG] = "%a = (WORD_STYPE)-%a;", [TOKEN_INST_ADD] = "%b = (WORD_STYPE)(%b + %a);", [TOKEN_INST_SUB] = "%b = (WORD_STYPE)(%b - %a);",
+        [TOKEN_INST_MUL] = "%b = (WORD_STYPE)(%b * %a);", [TOKEN_INST_DIV] = "%b = sublanq_native_div(%b, %a);", [TOKEN_INST_MOD] = "%b = sublanq_native_mod(%b, %a);",
+        [TOKEN_INST_AND] = "%b = (WORD_STYPE)(%b & %a);", [TOKEN_INST_OR] = "%b = (WORD_STYPE)(%b | %a);", [TOKEN_INST_XOR] = "%b = (WORD_STYPE)(%b ^ %a);",
+        [TOKEN_INST_SHL] = "%b = sublanq_native_shl(%b, %a);", [TOKEN_INST_SHR] = "%b = sublanq_native_shr(%b, %a);",
+        [TOKEN_INST_JMP] = "goto %l;", [TOKEN_INST_JLE] = "if (%a <= 0) goto %l;", [TOKEN_INST_JLZ] = "if ((WORD_STYPE)-%a > 0) goto %l;",
+        [TOKEN_INST_JEZ] = "if (%a <= 0 && (WORD_STYPE)-%a <= 0) goto %l;", [TOKEN_INST_JGE] = "if ((WORD_STYPE)-%a <= 0) goto %l;",
+        [TOKEN_INST_JGZ] = "if (%a > 0) goto %l;", [TOKEN_INST_LJP] = "target = (WORD_UTYPE)%a; goto dispatch;",
+        [TOKEN_INST_RET] = "target = (WORD_UTYPE)%a; goto dispatch;",
+        [TOKEN_INST_MOV] = "%b = %a;", [TOKEN_INST_DRD] = "%b = m[(WORD_UTYPE)%a];",
+        // like the template, the address is taken first and a is read after the word it points to is cleared
+        [TOKEN_INST_DWT] = "{ WORD_UTYPE t = (WORD_UTYPE)%b; m[t] = 0; m[t] = %a; }",
+        [TOKEN_INST_LDX] = "%t = m[(WORD_UTYPE)(%a + %b)];", [TOKEN_INST_STX] = "{ WORD_UTYPE t = (WORD_UTYPE)(%b + %t); m[t] = 0; m[t] = %a; }",
+        [TOKEN_INST_CPY] = "{ WORD_UTYPE s = (WORD_UTYPE)%a, d = (WORD_UTYPE)%b; for (WORD_STYPE n = %t; n > 0; --n) m[d++] = m[s++]; }",
+        [TOKEN_INST_FIL] = "{ WORD_UTYPE d = (WORD_UTYPE)%b; WORD_STYPE v = %a; for (WORD_STYPE n = %t; n > 0; --n) m[d++] = v; }",
+        [TOKEN_INST_INP] = "%b = SUBLANQ_NATIVE_IN(%p);", [TOKEN_INST_OUT] = "SUBLANQ_NATIVE_OUT(%p, %a);", [TOKEN_INST_HLT] = "return SUBLANQ_STOP_HALT;",
+    };
+    token_index = code_start_token;
+    bank_selected = BANK_NONE;
+    tokenize();
+    while (token != TOKEN_EOS) {
+        if (token == TOKEN_LABEL_DECL) {
+            if (used[token_symbol]) fprintf(file, "l%u: // $%s\n", token_symbol, symbol_name(token_symbol));
+            bank_selected = BANK_NONE;
+            tokenize();
+            continue;
+        }
+        inst = token;
+        const Token* operands = &tokens[token_index];
+        size_t operands_count = inst_operands_count(inst);
+        if (inst == TOKEN_INST_JTB) operands_count += 2 * jtb_labels_count(token_index + 1) - 1;
+        size_t bank = bank_switch();
+        if (bank != BANK_NONE) fprintf(file, "    SUBLANQ_NATIVE_OUT(%d, %zu);\n", BANK_PORT, bank);
+        if (inst == TOKEN_INST_SJP) fprintf(file, "    m[%u] = %u;\n", symbols[operands[1].symbol].value, symbols[operands[0].symbol].value);
+        else if (inst == TOKEN_INST_ADR) fprintf(file, "    m[%u] = %u;\n", symbols[operands[1].symbol].value, symbols[operands[0].symbol].value);
+        // cal stores in the link itself, it is where the native ret reads
+        else if (inst == TOKEN_INST_CAL) {
+            fprintf(file, "    m[%u] = %u;\n", symbols[operands[1].symbol].value, binary[symbols[symbol_return(token_index - 1)].value]);
+            c_statement(file, "goto %l;", operands);
+            if (dispatch && !taken[binary[symbols[symbol_return(token_index - 1)].value]]) fprintf(file, "r%zu:\n", token_index - 1);
+        }
+        // the entry is read from the table like the template does, so an index outside of it goes where the word there says
+        else if (inst == TOKEN_INST_JTB) {
+            size_t count = jtb_labels_count(token_index + 1);
+            fputs("    { WORD_STYPE i = ", file);
+            c_operand(file, &operands[0]);
+            if (clamp_jtb) fprintf(file, "; if (i < 0) i = 0; if (i > %zu) i = %zu", count - 1, count - 1);
+            fprintf(file, "; target = (WORD_UTYPE)m[(WORD_UTYPE)(%u + i)]; goto dispatch; }\n", binary[symbols[symbol_jump_table(token_index - 1)].value]);
+        }
+        else c_statement(file, statements[inst], operands);
+        for (size_t i = 0; i <= operands_count; ++i) tokenize();
+    }
+    fprintf(file, "    return SUBLANQ_STOP_END;\n");
+    if (dispatch) {
+        fprintf(file, "dispatch:\n    switch (target) {\n");
+        // a return right before a label sjp or jtb took is the case of that label
+        for (size_t i = code_start_token; i < tokens_count; ++i) {
+            if (tokens[i].type != TOKEN_INST_CAL) continue;
+            WORD_UTYPE address = binary[symbols[symbol_return(i)].value];
+            if (!taken[address]) fprintf(file, "    case %u: goto r%zu;\n", address, i);
+        }
+        // labels at the same address are the same case, the first one clears the address
+        for (size_t i = code_start_token; i < tokens_count; ++i) {
+            if (tokens[i].type != TOKEN_LABEL_DECL || !taken[symbols[tokens[i].symbol].value]) continue;
+            if (!symbol_exist(symbol_prefixed('^', tokens[i].symbol)) && !tabled[tokens[i].symbol]) continue;
+            fprintf(file, "    case %u: goto l%u;\n", symbols[tokens[i].symbol].value, tokens[i].symbol);
+            taken[symbols[tokens[i].symbol].value] = false;
+        }
+        fprintf(file, "    default: vm->pc = target; return SUBLANQ_STOP_BUDGET;\n    }\n");
+    }
+    fprintf(file, "}\n");
+    free(used);
+    free(tabled);
+    free(taken);
+    bool ok = !ferror(file);
+    if (fclose(file) != 0) ok = false;
+    return ok;
+}
+
+// the data without the constants, which go to the pool, and the code, with a kind for every word, see object_format.c
+static inline bool write_object(const char* file_path) {
+    size_t code_start = binary[2], code_count = binary_idx - code_start;
+    size_t* pool_index = malloc(code_start * sizeof(size_t));
+    WORD_UTYPE* data_offset = malloc((code_start + 1) * sizeof(WORD_UTYPE));
+    bool* patched = calloc(code_count + 1, sizeof(bool));
+    Object object = {0};
+    object.data = malloc((code_start + 1) * sizeof(ObjectWord));
+    object.pool = malloc((code_start + 1) * sizeof(WORD_UTYPE));
+    object.code = malloc((code_count + 1) * sizeof(ObjectWord));
+    object.symbols = malloc((imports_count + tokens_count + 1) * sizeof(ObjectSymbol));
+    if (!pool_index || !data_offset || !patched || !object.data || !object.pool || !object.code || !object.symbols) { fprintf(stderr, "Object memory alloc failed\n"); exit(1); }
+    for (size_t w = 0; w < code_start; ++w) pool_index[w] = SIZE_MAX;
+    for (SymbolId id = 0; id < symbols_count; ++id) {
+        if (symbols[id].defined && symbol_name(id)[0] == '#') pool_index[symbols[id].value] = object.pool_count, object.pool[object.pool_count++] = binary[symbols[id].value];
+    }
+    for (size_t w = S_ADDR + 1; w <= code_start; ++w) {
+        data_offset[w] = (WORD_UTYPE)object.data_count;
+        if (w < code_start && pool_index[w] == SIZE_MAX) ++object.data_count;
+    }
+    for (size_t w = code_start; w < binary_idx; ++w) if (relocatable[w] && (w - code_start) % 3 != 2) patched[binary[w] - code_start] = true;
+    // a code address is relative to the code, or the end of the program for the end of the code
+    #define OBJECT_CODE_WORD(value) ((value) == binary_idx ? (ObjectWord){OBJECT_END, 0} : (ObjectWord){OBJECT_CODE, (WORD_UTYPE)((value) - code_start)})
+    #define OBJECT_DATA_WORD(value) (pool_index[value] != SIZE_MAX ? (ObjectWord){OBJECT_POOL, (WORD_UTYPE)pool_index[value]} : (ObjectWord){OBJECT_DATA, data_offset[value]})
+    size_t data_count = 0;
+    for (size_t w = S_ADDR + 1; w < code_start; ++w) {
+        if (pool_index[w] != SIZE_MAX) continue;
+        WORD_UTYPE value = binary[w];
+        ObjectWord word = {OBJECT_ABS, value};
+        if (import_of(value) != SIZE_MAX && (relocatable[w] || data_relocatable[w])) word = (ObjectWord){OBJECT_IMPORT, (WORD_UTYPE)import_of(value)};
+        else if (relocatable[w]) word = OBJECT_CODE_WORD(value);
+        else if (data_relocatable[w] && value > S_ADDR && value <= code_start) word = value < code_start ? OBJECT_DATA_WORD(value) : (ObjectWord){OBJECT_DATA, data_offset[value]};
+        object.data[data_count++] = word;
+    }
+    // a and b are addresses, patched words and c unless it is a code address are taken as they are
+    for (size_t w = code_start; w < binary_idx; ++w) {
+        WORD_UTYPE value = binary[w];
+        ObjectWord word = {OBJECT_ABS, value};
+        bool c = (w - code_start) % 3 == 2;
+        if (patched[w - code_start] || (c && !relocatable[w])) {}
+        else if (import_of(value) != SIZE_MAX) word = (ObjectWord){OBJECT_IMPORT, (WORD_UTYPE)import_of(value)};
+        else if (relocatable[w]) word = OBJECT_CODE_WORD(value);
+        else if (value > S_ADDR && value < code_start) word = OBJECT_DATA_WORD(value);
+        object.code[object.code_count++] = word;
+    }
+    #undef OBJECT_CODE_WORD
+    #undef OBJECT_DATA_WORD
+    for (size_t i = 0; i < imports_count; ++i) object.symbols[object.symbols_count++] = (ObjectSymbol){OBJECT_IMPORT, 0, (char*)symbol_name(imports[i])};
+    for (size_t i = 0; i < tokens_count; ++i) {
+        SymbolId id = tokens[i].symbol;
+        if (id == SYMBOL_NONE) continue;
+        WORD_UTYPE value = symbols[id].value;
+        if (i < code_start_token && tokens[i].type == TOKEN_IDENTIFIER && exported(id)) {
+            object.symbols[object.symbols_count++] = (ObjectSymbol){OBJECT_DATA, data_offset[value], (char*)symbol_name(id)};
+        }
+        else if (i >= code_start_token && tokens[i].type == TOKEN_LABEL_DECL && exported(id)) {
+            ObjectWord word = value == binary_idx ? (ObjectWord){OBJECT_END, 0} : (ObjectWord){OBJECT_CODE, (WORD_UTYPE)(value - code_start)};
+            object.symbols[object.symbols_count++] = (ObjectSymbol){word.kind, word.value, (char*)symbol_name(id)};
+        }
+    }
+    bool ok = object_write(&object, file_path);
+    free(pool_index);
+    free(data_offset);
+    free(patched);
+    free(object.data);
+    free(object.pool);
+    free(object.code);
+    free(object.symbols);
+    return ok;
 }
 
 #define MAX_PATH_LENGTH 2048
 char source_file_path[MAX_PATH_LENGTH + 1] = {0};
 char binary_file_path[MAX_PATH_LENGTH + 1] = {0};
+char map_file_path[MAX_PATH_LENGTH + 3] = {0};
+char object_file_path[MAX_PATH_LENGTH + 3] = {0};
+char c_file_path[MAX_PATH_LENGTH + 3] = {0};
 
 int main(int argc, char** argv) {
     debug_mode = false;
-    if (argc != 2) {
+    pop_first(argv, argc);
+    const char* profile_path = NULL;
+    bool map = false, emit_c = false, symbols_section = false;
+    while (argc > 1 && argv[0][0] == '-') {
+        if (strcmp(argv[0], "--loop-muldiv") == 0) loop_muldiv = true;
+        else if (strcmp(argv[0], "--clamp-jtb") == 0) clamp_jtb = true;
+        else if (strcmp(argv[0], "--source-order") == 0) source_order = true;
+        else if (strcmp(argv[0], "--map") == 0) map = true;
+        else if (strcmp(argv[0], "--wcet") == 0) wcet = true;
+        else if (strcmp(argv[0], "-c") == 0) object_mode = true;
+        else if (strcmp(argv[0], "--time-passes") == 0) time_passes = true;
+        else if (strcmp(argv[0], "--emit-c") == 0) emit_c = true;
+        else if (strcmp(argv[0], "--symbols") == 0) symbols_section = true;
+        else if (strcmp(argv[0], "--profile") == 0 && argc > 2) { pop_first(argv, argc); profile_path = argv[0]; }
+        else {
+            printf("FATAL: Unknown option %s\n", argv[0]);
+            return 1;
+        }
+        pop_first(argv, argc);
+    }
+    if (argc != 1) {
         printf("FATAL: Expected source file path\n");
         return 1;
     }
-    pop_first(argv, argc);
+    if (object_mode && (map || wcet || profile_path)) {
+        printf("FATAL: -c can not be combined with --map, --profile or --wcet, they work on the linked program\n");
+        return 1;
+    }
+    if (emit_c && (object_mode || loop_muldiv)) {
+        printf("FATAL: --emit-c can not be combined with -c or --loop-muldiv\n");
+        return 1;
+    }
     if (strlen(argv[0]) > MAX_PATH_LENGTH) {
         printf("FATAL: Source file path too long\n");
         return 1;
@@ -704,11 +2986,22 @@ int main(int argc, char** argv) {
     }
     strcpy(source_file_path, argv[0]);
 
+    time_start();
     FileBytes file_bytes = {0};
     read_entire_file(source_file_path, &file_bytes);
+    time_pass("read");
 
     argv[0][strlen(argv[0]) - 4] = '\0';
     sprintf(binary_file_path, "%s.sq", argv[0]);
+    sprintf(map_file_path, "%s.sqmap", argv[0]);
+    sprintf(object_file_path, "%s.sqo", argv[0]);
+    sprintf(c_file_path, "%s.c", argv[0]);
+
+    // the map next to the binary is the one of the build the profile was taken from, it is only replaced after assembling
+    if (profile_path && !profile_load(profile_path, map_file_path)) {
+        printf("FATAL: Could not read the profile %s with the map %s\n", profile_path, map_file_path);
+        return 1;
+    }
 
     // char* debug_source = "
     //     a = 0
@@ -725,7 +3018,21 @@ int main(int argc, char** argv) {
 
     assemble();
 
-    write_binary(binary_file_path);
+    if (object_mode) {
+        if (!write_object(object_file_path)) printf("FATAL: Could not write the object %s\n", object_file_path);
+        time_pass("write");
+        PICOCT_cleanup(&ctx);
+        return 0;
+    }
+    if (!write_binary(binary_file_path, symbols_section)) printf("FATAL: Could not write the binary %s\n", binary_file_path);
+    if (map && !write_map(map_file_path)) printf("FATAL: Could not write the map %s\n", map_file_path);
+    if (emit_c && !write_c(c_file_path, source_file_path)) printf("FATAL: Could not write the c source %s\n", c_file_path);
+    time_pass("write");
+    if (wcet) {
+        wcet_pass();
+        time_pass("wcet");
+    }
+    PICOCT_cleanup(&ctx);
 
     return 0;
 }
\ No newline at end of file
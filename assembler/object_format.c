@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// relocatable object file format, shared by the assembler (asm -c) and the linker (sqld)
+// - an object is the data and code of one source without the header, every word has a kind that says what its value
+//   is relative to, so sqld can place the data and code of many objects in one image
+// - the constants (#n) are not in the data, they are a pool of their own that sqld merges, a number is stored once
+// - the symbols are the names the object exports (its variables and labels not starting with _) and the names it
+//   uses without declaring them (imports), which another object has to export
+// - layout, numbers are little endian:
+//   "SQOBJ1" u16 data_count u16 pool_count u16 code_count u16 symbols_count
+//   data_count * (u8 kind, u16 value), pool_count * u16, code_count * (u8 kind, u16 value),
+//   symbols_count * (u8 kind, u16 value, u16 name_length, name)
+
+#define OBJECT_MAGIC "SQOBJ1"
+#define OBJECT_MAGIC_SIZE 6
+
+typedef enum {
+    OBJECT_ABS, // the value as it is (registers, ports, numbers)
+    OBJECT_DATA, // an offset in the data of the object
+    OBJECT_POOL, // an index in the constant pool of the object
+    OBJECT_CODE, // an offset in the code of the object
+    OBJECT_END, // the end of the program
+    OBJECT_IMPORT, // the address of the symbol at that index, for a symbol the name is an import
+    OBJECT__KIND_END,
+} ObjectKind;
+
+typedef struct {
+    uint8_t kind;
+    WORD_UTYPE value;
+} ObjectWord;
+
+typedef struct {
+    uint8_t kind; // OBJECT_DATA, OBJECT_CODE or OBJECT_END for an export, OBJECT_IMPORT for an import
+    WORD_UTYPE value;
+    char* name;
+} ObjectSymbol;
+
+typedef struct {
+    ObjectWord* data;
+    WORD_UTYPE* pool;
+    ObjectWord* code;
+    ObjectSymbol* symbols;
+    size_t data_count, pool_count, code_count, symbols_count;
+} Object;
+
+static inline void object_free(Object* object) {
+    for (size_t i = 0; object->symbols && i < object->symbols_count; ++i) free(object->symbols[i].name);
+    free(object->data);
+    free(object->pool);
+    free(object->code);
+    free(object->symbols);
+    memset(object, 0, sizeof(*object));
+}
+
+static inline bool object_put_u16(FILE* file, size_t value) {
+    return fputc((int)(value & 0xFF), file) != EOF && fputc((int)((value >> 8) & 0xFF), file) != EOF;
+}
+static inline bool object_get_u16(FILE* file, WORD_UTYPE* value) {
+    int low = fgetc(file), high = fgetc(file);
+    if (low == EOF || high == EOF) return false;
+    *value = (WORD_UTYPE)(low | (high << 8));
+    return true;
+}
+static inline bool object_put_words(FILE* file, const ObjectWord* words, size_t count) {
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; ++i) ok = fputc(words[i].kind, file) != EOF && object_put_u16(file, words[i].value);
+    return ok;
+}
+static inline bool object_get_words(FILE* file, ObjectWord* words, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        int kind = fgetc(file);
+        if (kind == EOF || kind >= OBJECT__KIND_END || !object_get_u16(file, &words[i].value)) return false;
+        words[i].kind = (uint8_t)kind;
+    }
+    return true;
+}
+
+static inline bool object_write(const Object* object, const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    bool ok = fwrite(OBJECT_MAGIC, 1, OBJECT_MAGIC_SIZE, file) == OBJECT_MAGIC_SIZE
+        && object_put_u16(file, object->data_count) && object_put_u16(file, object->pool_count)
+        && object_put_u16(file, object->code_count) && object_put_u16(file, object->symbols_count)
+        && object_put_words(file, object->data, object->data_count);
+    for (size_t i = 0; i < object->pool_count && ok; ++i) ok = object_put_u16(file, object->pool[i]);
+    ok = ok && object_put_words(file, object->code, object->code_count);
+    for (size_t i = 0; i < object->symbols_count && ok; ++i) {
+        const ObjectSymbol* symbol = &object->symbols[i];
+        size_t length = strlen(symbol->name);
+        ok = fputc(symbol->kind, file) != EOF && object_put_u16(file, symbol->value) && object_put_u16(file, length)
+            && fwrite(symbol->name, 1, length, file) == length;
+    }
+    if (fclose(file) != 0) ok = false;
+    return ok;
+}
+
+// a word refers to a part of the object that does not exist
+static inline bool object_word_valid(const Object* object, ObjectWord word) {
+    switch (word.kind) {
+    case OBJECT_DATA: return word.value <= object->data_count;
+    case OBJECT_POOL: return word.value < object->pool_count;
+    case OBJECT_CODE: return word.value <= object->code_count;
+    case OBJECT_IMPORT: return word.value < object->symbols_count && object->symbols[word.value].kind == OBJECT_IMPORT;
+    default: return true;
+    }
+}
+
+// false if the file is not an object or is cut short, the object is then freed
+static inline bool object_read(Object* object, const char* path) {
+    memset(object, 0, sizeof(*object));
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    char magic[OBJECT_MAGIC_SIZE];
+    WORD_UTYPE data_count, pool_count, code_count, symbols_count;
+    bool ok = fread(magic, 1, OBJECT_MAGIC_SIZE, file) == OBJECT_MAGIC_SIZE && memcmp(magic, OBJECT_MAGIC, OBJECT_MAGIC_SIZE) == 0
+        && object_get_u16(file, &data_count) && object_get_u16(file, &pool_count)
+        && object_get_u16(file, &code_count) && object_get_u16(file, &symbols_count);
+    if (ok) {
+        object->data_count = data_count;
+        object->pool_count = pool_count;
+        object->code_count = code_count;
+        object->symbols_count = symbols_count;
+        object->data = malloc((data_count + 1) * sizeof(ObjectWord));
+        object->pool = malloc((pool_count + 1) * sizeof(WORD_UTYPE));
+        object->code = malloc((code_count + 1) * sizeof(ObjectWord));
+        object->symbols = calloc(symbols_count + 1, sizeof(ObjectSymbol));
+        if (!object->data || !object->pool || !object->code || !object->symbols) { fprintf(stderr, "Object memory alloc failed\n"); exit(1); }
+        ok = object_get_words(file, object->data, data_count);
+    }
+    for (size_t i = 0; i < object->pool_count && ok; ++i) ok = object_get_u16(file, &object->pool[i]);
+    ok = ok && object_get_words(file, object->code, object->code_count);
+    for (size_t i = 0; i < object->symbols_count && ok; ++i) {
+        ObjectSymbol* symbol = &object->symbols[i];
+        int kind = fgetc(file);
+        WORD_UTYPE length;
+        ok = kind != EOF && kind > OBJECT_ABS && kind < OBJECT__KIND_END && kind != OBJECT_POOL
+            && object_get_u16(file, &symbol->value) && object_get_u16(file, &length);
+        if (!ok) break;
+        symbol->kind = (uint8_t)kind;
+        symbol->name = malloc((size_t)length + 1);
+        if (!symbol->name) { fprintf(stderr, "Object memory alloc failed\n"); exit(1); }
+        ok = fread(symbol->name, 1, length, file) == length;
+        symbol->name[length] = '\0';
+        if (ok && symbol->kind != OBJECT_IMPORT) ok = object_word_valid(object, (ObjectWord){symbol->kind, symbol->value});
+    }
+    for (size_t i = 0; i < object->data_count && ok; ++i) ok = object_word_valid(object, object->data[i]);
+    for (size_t i = 0; i < object->code_count && ok; ++i) ok = object_word_valid(object, object->code[i]);
+    fclose(file);
+    if (!ok) object_free(object);
+    return ok;
+}
@@ -3,13 +3,28 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <limits.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// table driven lexer
+// - bytes are classified through PICOCT_char_class, not the locale dependent ctype functions
+// - the match tables are compiled by PICOCT_prepare (called by the first PICOCT_tokenize) into
+//   a list per first byte for symbols (and keywords that are not plain words), tried in table order like before,
+//   and a perfect hash over the word keywords so a word is looked up with one hash and one compare,
+//   keywords that are not plain words are therefore tried before the word keywords
+// - whitespace runs are skipped 16 bytes at a time with SSE2, comments jump to the next newline with memchr
+// - the cursor is only a byte offset, line and column are found by PICOCT_position when an error is reported
+// - identifiers and numbers are left in the source, token_start and token_length point at them,
+//   token_string_buffer still gets a (capacity bounded) copy of them
 
 typedef struct {
-    size_t i, x, y, l;
+    size_t i;
 } PICOCT_Cursor;
 
 typedef enum {
@@ -25,6 +40,13 @@ typedef struct {
     size_t match_type;
 } PICOCT_Match;
 
+typedef struct {
+    const char* str;
+    size_t length;
+    size_t match_type;
+    bool keyword;
+} PICOCT_Entry;
+
 typedef struct {
     const char* source_file_path;
     char* source;
@@ -45,120 +67,242 @@ typedef struct {
     size_t token_string_capacity;
     size_t token_string_length;
     size_t token_number;
+    size_t token_start;
+    size_t token_length;
+
+    // built by PICOCT_prepare
+    bool prepared;
+    size_t comment_marker_length;
+    PICOCT_Entry* entries;
+    size_t bucket_start[257];
+    PICOCT_Entry* keyword_slots;
+    size_t keyword_slots_mask;
+    uint32_t keyword_seed;
 } PICOCT_Context;
 
-static inline void PICOCT_append_token_char(PICOCT_Context* ctx, char c) {
-    if (ctx->token_string_length + 1 < ctx->token_string_capacity) ctx->token_string_buffer[ctx->token_string_length++] = c;
+enum {
+    PICOCT_CLASS_SPACE = 1 << 0,
+    PICOCT_CLASS_ALPHA = 1 << 1,
+    PICOCT_CLASS_DIGIT = 1 << 2,
+    PICOCT_CLASS_WORD = 1 << 3,  // alpha, digit or _
+};
+#define PICOCT_SPACE_CLASSES(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\v' || (c) == '\f' || (c) == '\r' ? PICOCT_CLASS_SPACE : 0)
+#define PICOCT_ALPHA_CLASSES(c) (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') ? PICOCT_CLASS_ALPHA | PICOCT_CLASS_WORD : 0)
+#define PICOCT_DIGIT_CLASSES(c) ((c) >= '0' && (c) <= '9' ? PICOCT_CLASS_DIGIT | PICOCT_CLASS_WORD : 0)
+#define PICOCT_CLASSES(c) (PICOCT_SPACE_CLASSES(c) | PICOCT_ALPHA_CLASSES(c) | PICOCT_DIGIT_CLASSES(c) | ((c) == '_' ? PICOCT_CLASS_WORD : 0))
+#define PICOCT_CLASSES_4(c) PICOCT_CLASSES(c), PICOCT_CLASSES(c + 1), PICOCT_CLASSES(c + 2), PICOCT_CLASSES(c + 3)
+#define PICOCT_CLASSES_16(c) PICOCT_CLASSES_4(c), PICOCT_CLASSES_4(c + 4), PICOCT_CLASSES_4(c + 8), PICOCT_CLASSES_4(c + 12)
+#define PICOCT_CLASSES_64(c) PICOCT_CLASSES_16(c), PICOCT_CLASSES_16(c + 16), PICOCT_CLASSES_16(c + 32), PICOCT_CLASSES_16(c + 48)
+static const uint8_t PICOCT_char_class[256] = {PICOCT_CLASSES_64(0), PICOCT_CLASSES_64(64), PICOCT_CLASSES_64(128), PICOCT_CLASSES_64(192)};
+
+static inline bool PICOCT_is_class(PICOCT_Context* ctx, size_t i, uint8_t char_class) {
+    return i < ctx->source_length && (PICOCT_char_class[(uint8_t)ctx->source[i]] & char_class);
+}
+static inline bool PICOCT_is_word(const char* str, size_t length) {
+    if (!length) return false;
+    for (size_t i = 0; i < length; ++i) if (!(PICOCT_char_class[(uint8_t)str[i]] & PICOCT_CLASS_WORD)) return false;
+    return true;
 }
 
-static inline void PICOCT_new_token(PICOCT_Context* ctx) {
-    ctx->token_string_buffer[0] = '\0';
-    ctx->token_string_length = 0;
-    ctx->token_number = 0;
-    ctx->old_cursor = ctx->cursor;
+static inline uint32_t PICOCT_hash(const char* str, size_t length, uint32_t seed) {
+    // FNV-1a with the seed as offset basis
+    uint32_t hash = 2166136261u ^ seed;
+    for (size_t i = 0; i < length; ++i) hash = (hash ^ (uint8_t)str[i]) * 16777619u;
+    return hash ^ (hash >> 15);
 }
 
-static inline void PICOCT_advance_cursor(PICOCT_Context* ctx) {
-    if (ctx->cursor.i >= ctx->source_length) return;
-    if (ctx->source[ctx->cursor.i] == '\n') {
-        ctx->cursor.x = 0;
-        ++ctx->cursor.y;
-        ctx->cursor.l = ctx->cursor.i + 1;
-    } 
-    else ++ctx->cursor.x;
-    ++ctx->cursor.i;
+// tries seeds until the word keywords land in distinct slots, growing the table if no seed works
+static inline bool PICOCT_build_keyword_hash(PICOCT_Context* ctx) {
+    size_t word_count = 0;
+    for (size_t i = 0; i < ctx->keyword_match_table_count; ++i) {
+        const char* str = ctx->keyword_match_table[i].match_str;
+        if (PICOCT_is_word(str, strlen(str))) ++word_count;
+    }
+    size_t slots = 4;
+    while (slots < word_count * 2) slots *= 2;
+    while (true) {
+        ctx->keyword_slots = calloc(slots, sizeof(PICOCT_Entry));
+        if (!ctx->keyword_slots) return false;
+        for (uint32_t seed = 0; seed < 4096; ++seed) {
+            bool collision = false;
+            for (size_t i = 0; i < ctx->keyword_match_table_count && !collision; ++i) {
+                const char* str = ctx->keyword_match_table[i].match_str;
+                size_t length = strlen(str);
+                if (!PICOCT_is_word(str, length)) continue;
+                PICOCT_Entry* slot = &ctx->keyword_slots[PICOCT_hash(str, length, seed) & (slots - 1)];
+                // a repeated keyword keeps its first entry like the linear search did
+                if (slot->str && (slot->length != length || memcmp(slot->str, str, length) != 0)) collision = true;
+                else if (!slot->str) *slot = (PICOCT_Entry){str, length, ctx->keyword_match_table[i].match_type, true};
+            }
+            if (!collision) {
+                ctx->keyword_slots_mask = slots - 1;
+                ctx->keyword_seed = seed;
+                return true;
+            }
+            memset(ctx->keyword_slots, 0, slots * sizeof(PICOCT_Entry));
+        }
+        free(ctx->keyword_slots);
+        slots *= 2;
+    }
 }
-static inline void PICOCT_advance_cursor_n(PICOCT_Context* ctx, size_t n) {
-    for (size_t i = 0; i < n; i++) {
-        if (ctx->cursor.i >= ctx->source_length) return;
-        if (ctx->source[ctx->cursor.i] == '\n') {
-            ctx->cursor.x = 0;
-            ++ctx->cursor.y;
-            ctx->cursor.l = ctx->cursor.i + 1;
-        } 
-        else ++ctx->cursor.x;
-        ++ctx->cursor.i;
+
+static inline bool PICOCT_prepare(PICOCT_Context* ctx) {
+    if (ctx->prepared) return true;
+    ctx->comment_marker_length = ctx->comment_marker ? strlen(ctx->comment_marker) : 0;
+    // symbols, then keywords that are not words, bucketed by first byte and kept in table order
+    size_t count = ctx->symbol_match_table_count + ctx->keyword_match_table_count;
+    ctx->entries = malloc((count ? count : 1) * sizeof(PICOCT_Entry));
+    if (!ctx->entries) return false;
+    size_t entry_count = 0;
+    memset(ctx->bucket_start, 0, sizeof(ctx->bucket_start));
+    for (size_t byte = 0; byte < 256; ++byte) {
+        ctx->bucket_start[byte] = entry_count;
+        for (size_t i = 0; i < ctx->symbol_match_table_count; ++i) {
+            const char* str = ctx->symbol_match_table[i].match_str;
+            if (str[0] && (uint8_t)str[0] == byte) ctx->entries[entry_count++] = (PICOCT_Entry){str, strlen(str), ctx->symbol_match_table[i].match_type, false};
+        }
+        for (size_t i = 0; i < ctx->keyword_match_table_count; ++i) {
+            const char* str = ctx->keyword_match_table[i].match_str;
+            if (str[0] && (uint8_t)str[0] == byte && !PICOCT_is_word(str, strlen(str))) ctx->entries[entry_count++] = (PICOCT_Entry){str, strlen(str), ctx->keyword_match_table[i].match_type, true};
+        }
     }
+    ctx->bucket_start[256] = entry_count;
+    if (!PICOCT_build_keyword_hash(ctx)) return false;
+    ctx->prepared = true;
+    return true;
 }
+static inline void PICOCT_cleanup(PICOCT_Context* ctx) {
+    free(ctx->entries);
+    free(ctx->keyword_slots);
+    ctx->entries = NULL;
+    ctx->keyword_slots = NULL;
+    ctx->prepared = false;
+}
+
 static inline void PICOCT_until_non_whitespace(PICOCT_Context* ctx) {
-    while (ctx->cursor.i < ctx->source_length && isspace(ctx->source[ctx->cursor.i])) PICOCT_advance_cursor(ctx);
+    size_t i = ctx->cursor.i;
+    #if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i carriage_return = _mm_set1_epi8('\r');
+    while (i + 16 <= ctx->source_length) {
+        // \t \n \v \f \r are 9 to 13, space is checked alone
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(ctx->source + i));
+        __m128i control = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_sub_epi8(tab, _mm_set1_epi8(1))), _mm_cmplt_epi8(bytes, _mm_add_epi8(carriage_return, _mm_set1_epi8(1))));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(control, _mm_cmpeq_epi8(bytes, space)));
+        if (mask != 0xFFFF) { ctx->cursor.i = i + (size_t)__builtin_ctz(~mask); return; }
+        i += 16;
+    }
+    #endif
+    while (PICOCT_is_class(ctx, i, PICOCT_CLASS_SPACE)) ++i;
+    ctx->cursor.i = i;
 }
 static inline void PICOCT_until_newline(PICOCT_Context* ctx) {
-    while (ctx->cursor.i < ctx->source_length && ctx->source[ctx->cursor.i] != '\n') PICOCT_advance_cursor(ctx);
+    // memchr is vectorized in every libc worth using
+    const char* newline = memchr(ctx->source + ctx->cursor.i, '\n', ctx->source_length - ctx->cursor.i);
+    ctx->cursor.i = newline ? (size_t)(newline - ctx->source) : ctx->source_length;
+}
+static inline bool PICOCT_at_comment(PICOCT_Context* ctx) {
+    size_t length = ctx->comment_marker_length;
+    return length && ctx->cursor.i + length <= ctx->source_length && memcmp(ctx->source + ctx->cursor.i, ctx->comment_marker, length) == 0;
 }
 
-static inline bool PICOCT_is_keyword(PICOCT_Context* ctx, const char* keyword_str) {
-    size_t len = strlen(keyword_str);
-    if (ctx->cursor.i + len > ctx->source_length) return false;
-    if (memcmp(ctx->source + ctx->cursor.i, keyword_str, len) == 0) {
-        if (ctx->cursor.i + len < ctx->source_length && (isalnum(ctx->source[ctx->cursor.i + len]) || ctx->source[ctx->cursor.i + len] == '_')) return false;
-        PICOCT_advance_cursor_n(ctx, len);
-        PICOCT_until_non_whitespace(ctx);
-        return true;
+// finds the line (0 based), the column (bytes since the start of the line) and the line start of a byte offset
+static inline void PICOCT_position(PICOCT_Context* ctx, size_t offset, size_t* line, size_t* column, size_t* line_start) {
+    size_t y = 0, l = 0;
+    const char* cursor = ctx->source;
+    const char* end = ctx->source + (offset < ctx->source_length ? offset : ctx->source_length);
+    while (cursor < end) {
+        const char* newline = memchr(cursor, '\n', (size_t)(end - cursor));
+        if (!newline) break;
+        ++y;
+        cursor = newline + 1;
+        l = (size_t)(cursor - ctx->source);
     }
-    return false;
+    *line = y;
+    *column = offset - l;
+    *line_start = l;
 }
-static inline bool PICOCT_is_symbol(PICOCT_Context* ctx, const char* symbol_str) {
-    size_t len = strlen(symbol_str);
-    if (ctx->cursor.i + len > ctx->source_length) return false;
-    if (memcmp(ctx->source + ctx->cursor.i, symbol_str, len) == 0) {
-        PICOCT_advance_cursor_n(ctx, len);
-        PICOCT_until_non_whitespace(ctx);
-        return true;
-    }
-    return false;
+
+static inline void PICOCT_set_token_string(PICOCT_Context* ctx, size_t start, size_t length) {
+    ctx->token_start = start;
+    ctx->token_length = length;
+    size_t copied = length + 1 < ctx->token_string_capacity ? length : (ctx->token_string_capacity ? ctx->token_string_capacity - 1 : 0);
+    memcpy(ctx->token_string_buffer, ctx->source + start, copied);
+    ctx->token_string_length = copied;
+    if (ctx->token_string_capacity) ctx->token_string_buffer[copied] = '\0';
 }
 
 static inline void PICOCT_tokenize(PICOCT_Context* ctx) {
-    PICOCT_new_token(ctx); PICOCT_until_non_whitespace(ctx);
-    if (ctx->cursor.i >= ctx->source_length) { ctx->token_type = PICOCT_EOS; return; }
-    while (PICOCT_is_symbol(ctx, ctx->comment_marker)) {
+    if (!PICOCT_prepare(ctx)) { fprintf(stderr, "Lexer table alloc failed\n"); exit(1); }
+    if (ctx->token_string_capacity) ctx->token_string_buffer[0] = '\0';
+    ctx->token_string_length = 0;
+    ctx->token_number = 0;
+    ctx->token_length = 0;
+    ctx->old_cursor = ctx->cursor;
+    PICOCT_until_non_whitespace(ctx);
+    while (PICOCT_at_comment(ctx)) {
         PICOCT_until_newline(ctx);
         PICOCT_until_non_whitespace(ctx);
     }
     if (ctx->cursor.i >= ctx->source_length) { ctx->token_type = PICOCT_EOS; return; }
-    for (size_t i = 0; i < ctx->symbol_match_table_count; ++i) {
-        if (PICOCT_is_symbol(ctx, ctx->symbol_match_table[i].match_str)) {
-            ctx->token_type = PICOCT_MATCH;
-            ctx->match_type = ctx->symbol_match_table[i].match_type;
-            return;
-        }
+    const char* at = ctx->source + ctx->cursor.i;
+    size_t left = ctx->source_length - ctx->cursor.i;
+    // the word at the cursor, keywords need to match all of it
+    size_t word_length = 0;
+    while (PICOCT_is_class(ctx, ctx->cursor.i + word_length, PICOCT_CLASS_WORD)) ++word_length;
+    uint8_t first = (uint8_t)at[0];
+    for (size_t e = ctx->bucket_start[first]; e < ctx->bucket_start[first + 1]; ++e) {
+        PICOCT_Entry* entry = &ctx->entries[e];
+        if (entry->length > left || memcmp(at, entry->str, entry->length) != 0) continue;
+        if (entry->keyword && PICOCT_is_class(ctx, ctx->cursor.i + entry->length, PICOCT_CLASS_WORD)) continue;
+        ctx->cursor.i += entry->length;
+        PICOCT_until_non_whitespace(ctx);
+        ctx->token_type = PICOCT_MATCH;
+        ctx->match_type = entry->match_type;
+        return;
     }
-    if (ctx->cursor.i >= ctx->source_length) { ctx->token_type = PICOCT_EOS; return; }
-    for (size_t i = 0; i < ctx->keyword_match_table_count; ++i) {
-        if (PICOCT_is_keyword(ctx, ctx->keyword_match_table[i].match_str)) {
+    if (word_length) {
+        PICOCT_Entry* slot = &ctx->keyword_slots[PICOCT_hash(at, word_length, ctx->keyword_seed) & ctx->keyword_slots_mask];
+        if (slot->str && slot->length == word_length && memcmp(slot->str, at, word_length) == 0) {
+            ctx->cursor.i += word_length;
+            PICOCT_until_non_whitespace(ctx);
             ctx->token_type = PICOCT_MATCH;
-            ctx->match_type = ctx->keyword_match_table[i].match_type;
+            ctx->match_type = slot->match_type;
             return;
         }
     }
-    if (isalpha(ctx->source[ctx->cursor.i]) || ctx->source[ctx->cursor.i] == '_') {
-        while (ctx->cursor.i < ctx->source_length && (isalnum(ctx->source[ctx->cursor.i]) || ctx->source[ctx->cursor.i] == '_')) {
-            PICOCT_append_token_char(ctx, ctx->source[ctx->cursor.i]);
-            PICOCT_advance_cursor(ctx);
-        }
-        PICOCT_append_token_char(ctx, '\0');
+    uint8_t char_class = PICOCT_char_class[first];
+    if ((char_class & PICOCT_CLASS_ALPHA) || first == '_') {
+        PICOCT_set_token_string(ctx, ctx->cursor.i, word_length);
+        ctx->cursor.i += word_length;
         PICOCT_until_non_whitespace(ctx);
         ctx->token_type = PICOCT_IDENTIFIER;
         return;
     }
-    else if (isdigit(ctx->source[ctx->cursor.i])) {
-        while (ctx->cursor.i < ctx->source_length && isdigit(ctx->source[ctx->cursor.i])) {
-            PICOCT_append_token_char(ctx, ctx->source[ctx->cursor.i]);
-            PICOCT_advance_cursor(ctx);
+    else if (char_class & PICOCT_CLASS_DIGIT) {
+        // saturates like strtoul
+        size_t start = ctx->cursor.i;
+        unsigned long number = 0;
+        while (PICOCT_is_class(ctx, ctx->cursor.i, PICOCT_CLASS_DIGIT)) {
+            unsigned long digit = (unsigned long)(ctx->source[ctx->cursor.i] - '0');
+            number = number > (ULONG_MAX - digit) / 10 ? ULONG_MAX : number * 10 + digit;
+            ++ctx->cursor.i;
         }
-        PICOCT_append_token_char(ctx, '\0');
+        PICOCT_set_token_string(ctx, start, ctx->cursor.i - start);
         PICOCT_until_non_whitespace(ctx);
         ctx->token_type = PICOCT_NUMBER;
-        ctx->token_number = strtoul(ctx->token_string_buffer, NULL, 10);
+        ctx->token_number = number;
         return;
     }
-    ctx->token_type = PICOCT_UNKNOWN; 
+    ctx->token_type = PICOCT_UNKNOWN;
     return;
 }
 
 static inline void PICOCT_error_printf(PICOCT_Context* ctx, const char* fmt, ...) {
-    printf("%s:%zu:%zu: ", ctx->source_file_path, ctx->old_cursor.y + 1, ctx->old_cursor.x + 1);
+    size_t line, column, line_start;
+    PICOCT_position(ctx, ctx->old_cursor.i, &line, &column, &line_start);
+    printf("%s:%zu:%zu: ", ctx->source_file_path, line + 1, column + 1);
     va_list args;
         va_start(args, fmt);
         vprintf(fmt, args);
@@ -166,10 +310,10 @@ static inline void PICOCT_error_printf(PICOCT_Context* ctx, const char* fmt, ...
     printf("\n ");
     size_t la = 0;
     size_t cnt = 0;
-    while (ctx->old_cursor.l + la < ctx->source_length && ctx->source[ctx->old_cursor.l + la] != '\n') {
-        if (ctx->source[ctx->old_cursor.l + la] == '\t') printf(" ");
-        else printf("%c", ctx->source[ctx->old_cursor.l + la]);
-        if (cnt < ctx->old_cursor.x) cnt += 1;
+    while (line_start + la < ctx->source_length && ctx->source[line_start + la] != '\n') {
+        if (ctx->source[line_start + la] == '\t') printf(" ");
+        else printf("%c", ctx->source[line_start + la]);
+        if (cnt < column) cnt += 1;
         ++la;
     }
     printf("\n ");
@@ -178,4 +322,4 @@ static inline void PICOCT_error_printf(PICOCT_Context* ctx, const char* fmt, ...
     exit(1);
 }
 
-#endif // PICOCT_H
\ No newline at end of file
+#endif // PICOCT_H
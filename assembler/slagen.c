@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// generator of synthetic sources for measuring the assembler (asm --time-passes)
+// writes a program with the given number of variables, labels and instructions to stdout. the instructions are drawn
+// by the weights of --mix (see default_weight), --immediates is the share in percent of operands that
+// are immediates. jumps only go forward and the program ends with hlt, so it also assembles into something that runs.
+// jtb sets its index right before it, cal goes to one of the routines after the hlt, they return with ret through clink
+
+#define SLAGEN_POINTERS 4
+#define SLAGEN_ARRAY_SIZE 8
+#define SLAGEN_ROUTINES 4
+#define SLAGEN_JTB_CASES 4
+
+typedef enum {
+    G_ZER, G_INC, G_DEC, G_NEG, G_ADD, G_SUB, G_MUL, G_DIV, G_MOD,
+    G_AND, G_OR, G_XOR, G_SHL, G_SHR,
+    G_JMP, G_JLE, G_JLZ, G_JEZ, G_JGE, G_JGZ, G_SJP, G_LJP, G_CAL, G_JTB,
+    G_MOV, G_ADR, G_DRD, G_DWT, G_LDX, G_STX, G_CPY, G_FIL, G_INP, G_OUT,
+    G__COUNT,
+} GenInst;
+
+static const char* gen_names[G__COUNT] = {
+    "zer", "inc", "dec", "neg", "add", "sub", "mul", "div", "mod",
+    "and", "or", "xor", "shl", "shr",
+    "jmp", "jle", "jlz", "jez", "jge", "jgz", "sjp", "ljp", "cal", "jtb",
+    "mov", "adr", "drd", "dwt", "ldx", "stx", "cpy", "fil", "inp", "out",
+};
+
+// the instructions that loop are tens to hundreds of words, they are a quarter as often as the rest by default,
+// so the default program stays well inside the memory
+static inline unsigned default_weight(GenInst inst) {
+    switch (inst) {
+    case G_MUL: case G_DIV: case G_MOD: case G_AND: case G_OR: case G_XOR: case G_SHR: case G_CPY: case G_FIL: return 1;
+    default: return 4;
+    }
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+static inline uint64_t rng_next(void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ull;
+}
+static inline size_t rng_below(size_t n) {
+    return n ? (size_t)(rng_next() % n) : 0;
+}
+
+static size_t variables = 1024, labels = 256, instructions = 2048, immediates = 30;
+static unsigned weights[G__COUNT];
+static unsigned weights_total = 0;
+static size_t label_at = 0; // labels placed so far
+
+static inline void variable(void) {
+    printf(" v%zu", rng_below(variables));
+}
+// an immediate that is never 0, so div and mod by it are defined
+static inline void immediate(void) {
+    long value = (long)rng_below(65535) - 32767;
+    printf(" %ld", value ? value : 1);
+}
+static inline void immediate_or_variable(void) {
+    if (rng_below(100) < immediates) immediate();
+    else variable();
+}
+// a label after the current one, the last is the end of the program
+static inline void forward_label(void) {
+    size_t left = labels - label_at;
+    size_t target = label_at + rng_below(left);
+    if (target >= labels) printf(" @end");
+    else printf(" @L%zu", target);
+}
+
+static inline void instruction(GenInst inst) {
+    switch (inst) {
+    case G_ZER: case G_INC: case G_DEC: case G_NEG:
+        printf("    %s", gen_names[inst]); variable(); break;
+    case G_ADD: case G_SUB: case G_MUL: case G_DIV: case G_MOD: case G_MOV:
+    case G_AND: case G_OR: case G_XOR: case G_SHL: case G_SHR:
+        printf("    %s", gen_names[inst]); immediate_or_variable(); variable(); break;
+    case G_JMP:
+        printf("    jmp"); forward_label(); break;
+    case G_JLE: case G_JLZ: case G_JEZ: case G_JGE: case G_JGZ:
+        printf("    %s", gen_names[inst]); variable(); forward_label(); break;
+    case G_SJP: case G_LJP:
+        printf("    sjp"); forward_label(); printf(" link\n    ljp link"); break;
+    case G_CAL:
+        printf("    cal @R%zu clink", rng_below(SLAGEN_ROUTINES)); break;
+    // the index is set right before, so it stays inside the table
+    case G_JTB: {
+        size_t cases = 1 + rng_below(SLAGEN_JTB_CASES);
+        printf("    mov %zu index\n    jtb index", rng_below(cases));
+        for (size_t i = 0; i < cases; ++i) { if (i) printf(","); forward_label(); }
+        break;
+    }
+    case G_ADR:
+        printf("    adr"); variable(); variable(); break;
+    case G_DRD: case G_DWT: {
+        size_t pointer = rng_below(SLAGEN_POINTERS);
+        printf("    adr"); variable(); printf(" p%zu\n", pointer);
+        if (inst == G_DRD) { printf("    drd p%zu", pointer); variable(); }
+        else { printf("    dwt"); variable(); printf(" p%zu", pointer); }
+        break;
+    }
+    // the indexes and counts stay inside table and buffer
+    case G_LDX:
+        printf("    ldx table %zu", rng_below(SLAGEN_ARRAY_SIZE)); variable(); break;
+    case G_STX:
+        printf("    stx"); immediate_or_variable(); printf(" table %zu", rng_below(SLAGEN_ARRAY_SIZE)); break;
+    case G_CPY:
+        printf("    cpy table buffer %zu", rng_below(SLAGEN_ARRAY_SIZE)); break;
+    case G_FIL:
+        printf("    fil"); immediate_or_variable(); printf(" buffer %zu", rng_below(SLAGEN_ARRAY_SIZE)); break;
+    case G_INP:
+        printf("    inp 1"); variable(); break;
+    case G_OUT:
+        printf("    out"); immediate_or_variable(); printf(" 3"); break;
+    default: break;
+    }
+    printf("\n");
+}
+
+static inline bool parse_mix(char* mix) {
+    memset(weights, 0, sizeof(weights));
+    for (char* item = strtok(mix, ","); item; item = strtok(NULL, ",")) {
+        char* equals = strchr(item, '=');
+        if (!equals) return false;
+        *equals = '\0';
+        size_t i = 0;
+        while (i < G__COUNT && strcmp(gen_names[i], item) != 0) ++i;
+        if (i == G__COUNT) return false;
+        weights[i] = (unsigned)strtoul(equals + 1, NULL, 10);
+    }
+    return true;
+}
+
+static inline void usage(const char* program_name) {
+    fprintf(stderr, "Usage: %s [--variables <n>] [--labels <n>] [--instructions <n>] [--immediates <percent>]\n"
+                    "       [--mix <inst>=<weight>,...] [--seed <n>] > program.sla\n", program_name);
+}
+
+int main(int argc, char** argv) {
+    for (size_t i = 0; i < G__COUNT; ++i) weights[i] = default_weight((GenInst)i);
+    for (int i = 1; i < argc; ++i) {
+        bool value = i + 1 < argc;
+        if (strcmp(argv[i], "--variables") == 0 && value) variables = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--labels") == 0 && value) labels = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--instructions") == 0 && value) instructions = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--immediates") == 0 && value) immediates = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--seed") == 0 && value) rng_state = strtoull(argv[++i], NULL, 10) * 2 + 1;
+        else if (strcmp(argv[i], "--mix") == 0 && value) { if (!parse_mix(argv[++i])) { usage(argv[0]); return 1; } }
+        else { usage(argv[0]); return 1; }
+    }
+    for (size_t i = 0; i < G__COUNT; ++i) weights_total += weights[i];
+    if (!variables || !weights_total) { usage(argv[0]); return 1; }
+
+    printf("; generated by slagen: %zu variables, %zu labels, %zu instructions\n", variables, labels, instructions);
+    // 16 a line, a line of a single name is an assignment
+    for (size_t v = 0; v < variables; v += 16) {
+        printf("v%zu", v);
+        for (size_t w = v + 1; w < v + 16 && w < variables; ++w) printf(", v%zu", w);
+        printf(v + 1 < variables ? "\n" : " = 0\n");
+    }
+    printf("p0, p1, p2, p3, link, clink, index\n");
+    printf("table *");
+    for (size_t i = 0; i < SLAGEN_ARRAY_SIZE; ++i) printf("%s %zu", i ? "," : "", i);
+    printf("\nbuffer | %d\n", SLAGEN_ARRAY_SIZE);
+    printf("__start__\n");
+    for (size_t n = 0; n < instructions; ++n) {
+        // labels spread evenly over the instructions
+        while (label_at < labels && label_at * instructions <= n * labels) printf("$L%zu\n", label_at++);
+        unsigned pick = (unsigned)rng_below(weights_total);
+        GenInst inst = 0;
+        while (pick >= weights[inst]) pick -= weights[inst++];
+        instruction(inst);
+    }
+    while (label_at < labels) printf("$L%zu\n", label_at++);
+    printf("$end\n    hlt\n");
+    if (weights[G_CAL]) {
+        for (size_t r = 0; r < SLAGEN_ROUTINES; ++r) {
+            printf("$R%zu\n", r);
+            instruction(G_ADD);
+            printf("    ret clink\n");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WORD_SIZE 16
+#define WORD_STYPE int16_t
+#define WORD_UTYPE uint16_t
+#define WORD_MAX UINT16_MAX
+
+#include "object_format.c"
+#include "../emulator/image_format.c"
+
+// linker for the objects written by asm -c
+// the image is the header, the data of every object in order, the merged constant pool (rodata) and the code of every
+// object in order. the program starts at the code of the first object, the code of every other object is followed by a jump
+// to the end of the program so it can not fall into the next one. every import is the export of the same name
+
+#define HEADER_SIZE 10
+#define Z_ADDR 3
+
+typedef struct {
+    const char* name;
+    const char* path;
+    WORD_UTYPE address;
+} Export;
+
+static inline int compare_exports(const void* x, const void* y) {
+    return strcmp(((const Export*)x)->name, ((const Export*)y)->name);
+}
+
+static inline void usage(const char* program_name) {
+    fprintf(stderr, "Usage: %s [-o <program.sq>] <object.sqo>...\n", program_name);
+}
+
+int main(int argc, char** argv) {
+    const char* output_path = NULL;
+    const char** paths = malloc((size_t)argc * sizeof(const char*));
+    size_t objects_count = 0;
+    if (!paths) { perror("malloc"); return 1; }
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output_path = argv[++i];
+        else if (argv[i][0] != '-') paths[objects_count++] = argv[i];
+        else { usage(argv[0]); return 1; }
+    }
+    if (!objects_count) { usage(argv[0]); return 1; }
+    char* default_path = NULL;
+    if (!output_path) {
+        size_t length = strlen(paths[0]);
+        if (length > 4 && strcmp(paths[0] + length - 4, ".sqo") == 0) length -= 4;
+        default_path = malloc(length + 4);
+        if (!default_path) { perror("malloc"); return 1; }
+        memcpy(default_path, paths[0], length);
+        strcpy(default_path + length, ".sq");
+        output_path = default_path;
+    }
+
+    Object* objects = calloc(objects_count, sizeof(Object));
+    size_t* data_base = malloc(objects_count * sizeof(size_t));
+    size_t* code_base = malloc(objects_count * sizeof(size_t));
+    WORD_UTYPE** pool_address = calloc(objects_count, sizeof(WORD_UTYPE*));
+    WORD_UTYPE** import_address = calloc(objects_count, sizeof(WORD_UTYPE*));
+    if (!objects || !data_base || !code_base || !pool_address || !import_address) { perror("malloc"); return 1; }
+    size_t data_end = HEADER_SIZE, exports_count = 0, pool_total = 0;
+    for (size_t i = 0; i < objects_count; ++i) {
+        if (!object_read(&objects[i], paths[i])) { printf("FATAL: %s is not an object\n", paths[i]); return 1; }
+        data_base[i] = data_end;
+        data_end += objects[i].data_count;
+        pool_total += objects[i].pool_count;
+        for (size_t s = 0; s < objects[i].symbols_count; ++s) exports_count += objects[i].symbols[s].kind != OBJECT_IMPORT;
+    }
+
+    // every number once, in the order the objects first use them
+    WORD_UTYPE* pool = malloc((pool_total + 1) * sizeof(WORD_UTYPE));
+    if (!pool) { perror("malloc"); return 1; }
+    size_t pool_count = 0;
+    for (size_t i = 0; i < objects_count; ++i) {
+        pool_address[i] = malloc((objects[i].pool_count + 1) * sizeof(WORD_UTYPE));
+        if (!pool_address[i]) { perror("malloc"); return 1; }
+        for (size_t p = 0; p < objects[i].pool_count; ++p) {
+            size_t found = 0;
+            while (found < pool_count && pool[found] != objects[i].pool[p]) ++found;
+            if (found == pool_count) pool[pool_count++] = objects[i].pool[p];
+            pool_address[i][p] = (WORD_UTYPE)(data_end + found);
+        }
+    }
+    size_t size = data_end + pool_count;
+    for (size_t i = 0; i < objects_count; ++i) {
+        code_base[i] = size;
+        size += objects[i].code_count + (i + 1 < objects_count ? 3 : 0);
+    }
+    if (size >= WORD_MAX) { printf("FATAL: The linked program does not fit in memory (%zu words)\n", size); return 1; }
+
+    Export* exports = malloc((exports_count + 1) * sizeof(Export));
+    if (!exports) { perror("malloc"); return 1; }
+    exports_count = 0;
+    for (size_t i = 0; i < objects_count; ++i) {
+        for (size_t s = 0; s < objects[i].symbols_count; ++s) {
+            const ObjectSymbol* symbol = &objects[i].symbols[s];
+            if (symbol->kind == OBJECT_IMPORT) continue;
+            size_t address = symbol->kind == OBJECT_DATA ? data_base[i] + symbol->value : symbol->kind == OBJECT_CODE ? code_base[i] + symbol->value : size;
+            exports[exports_count++] = (Export){symbol->name, paths[i], (WORD_UTYPE)address};
+        }
+    }
+    qsort(exports, exports_count, sizeof(Export), compare_exports);
+    bool ok = true;
+    for (size_t e = 1; e < exports_count; ++e) {
+        if (strcmp(exports[e - 1].name, exports[e].name) != 0) continue;
+        printf("FATAL: %s is exported by %s and %s\n", exports[e].name, exports[e - 1].path, exports[e].path);
+        ok = false;
+    }
+    for (size_t i = 0; i < objects_count; ++i) {
+        import_address[i] = malloc((objects[i].symbols_count + 1) * sizeof(WORD_UTYPE));
+        if (!import_address[i]) { perror("malloc"); return 1; }
+        for (size_t s = 0; s < objects[i].symbols_count; ++s) {
+            if (objects[i].symbols[s].kind != OBJECT_IMPORT) continue;
+            Export key = {objects[i].symbols[s].name, NULL, 0};
+            const Export* found = bsearch(&key, exports, exports_count, sizeof(Export), compare_exports);
+            if (found) import_address[i][s] = found->address;
+            else { printf("FATAL: %s uses %s, which no object exports\n", paths[i], key.name); ok = false; }
+        }
+    }
+    if (!ok) return 1;
+
+    WORD_UTYPE* image = calloc(size + 1, sizeof(WORD_UTYPE));
+    if (!image) { perror("malloc"); return 1; }
+    const WORD_UTYPE header[HEADER_SIZE] = {0, 0, (WORD_UTYPE)code_base[0], 0, (WORD_UTYPE)-1, 1, 0, 0, 0, 0};
+    memcpy(image, header, sizeof(header));
+    for (size_t i = 0; i < objects_count; ++i) {
+        for (int section = 0; section < 2; ++section) {
+            const ObjectWord* words = section ? objects[i].code : objects[i].data;
+            size_t count = section ? objects[i].code_count : objects[i].data_count;
+            size_t base = section ? code_base[i] : data_base[i];
+            for (size_t w = 0; w < count; ++w) {
+                WORD_UTYPE value = words[w].value;
+                switch (words[w].kind) {
+                case OBJECT_DATA: value = (WORD_UTYPE)(data_base[i] + value); break;
+                case OBJECT_POOL: value = pool_address[i][value]; break;
+                case OBJECT_CODE: value = (WORD_UTYPE)(code_base[i] + value); break;
+                case OBJECT_END: value = (WORD_UTYPE)size; break;
+                case OBJECT_IMPORT: value = import_address[i][value]; break;
+                default: break;
+                }
+                image[base + w] = value;
+            }
+        }
+        if (i + 1 < objects_count) {
+            size_t w = code_base[i] + objects[i].code_count;
+            image[w] = image[w + 1] = Z_ADDR;
+            image[w + 2] = (WORD_UTYPE)size;
+        }
+    }
+    memcpy(image + data_end, pool, pool_count * sizeof(WORD_UTYPE));
+
+    if (!image_write(output_path, image, size, data_end, code_base[0], NULL, 0)) { printf("FATAL: Could not write %s\n", output_path); return 1; }
+
+    for (size_t i = 0; i < objects_count; ++i) {
+        object_free(&objects[i]);
+        free(pool_address[i]);
+        free(import_address[i]);
+    }
+    free(objects); free(data_base); free(code_base); free(pool_address); free(import_address);
+    free(pool); free(exports); free(image); free(paths); free(default_path);
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "screen_io.c"
+#include "term_io.c"
+
+// device registry - every device is a named set of input and output handlers sharing one state
+// ports are bound to handlers by name (device.handler) so a device set is picked at run time,
+// the VM keeps the resolved handler per port so no lookup happens while running
+
+typedef struct {
+    const char* name;
+    SUBLANQ_InputFn fn;
+} DeviceInput;
+typedef struct {
+    const char* name;
+    SUBLANQ_OutputFn fn;
+} DeviceOutput;
+
+typedef struct {
+    const char* name;
+    const char* description;
+    size_t state_size;
+    bool (*init)(SUBLANQ_VM* vm, void* state);
+    void (*cleanup)(void* state);
+    const DeviceInput* inputs;
+    size_t inputs_count;
+    const DeviceOutput* outputs;
+    size_t outputs_count;
+} Device;
+
+// bank switching of the memory window, see SUBLANQ_select_bank. a bank that does not exist is ignored
+static inline void bank_select(SUBLANQ_VM* vm, void* user, WORD_UTYPE port, WORD_UTYPE data) {
+    (void)user; (void)port;
+    SUBLANQ_select_bank(vm, data);
+}
+static inline WORD_UTYPE bank_current(SUBLANQ_VM* vm, void* user, WORD_UTYPE port) {
+    (void)user; (void)port;
+    return (WORD_UTYPE)vm->bank;
+}
+
+static const DeviceInput screen_inputs[] = {{"flip", screen_flip}, {"quit", screen_quit}};
+static const DeviceOutput screen_outputs[] = {{"pixel", screen_pixel}};
+static const DeviceInput random_inputs[] = {{"byte", random_byte}};
+static const DeviceInput keyboard_inputs[] = {{"key", keyboard_key}};
+static const DeviceOutput console_outputs[] = {{"char", console_char}, {"int", console_int}, {"uint", console_uint}};
+static const DeviceInput bank_inputs[] = {{"current", bank_current}};
+static const DeviceOutput bank_outputs[] = {{"select", bank_select}};
+
+static const Device device_registry[] = {
+    {
+        .name = "screen", .description = "256x256 framebuffer window, pixel takes x, y, r, g, b as 5 writes, flip presents it, quit reads 27 once closed",
+        .state_size = sizeof(ScreenIo), .init = screen_init, .cleanup = screen_cleanup,
+        .inputs = screen_inputs, .inputs_count = sizeof(screen_inputs)/sizeof(screen_inputs[0]),
+        .outputs = screen_outputs, .outputs_count = sizeof(screen_outputs)/sizeof(screen_outputs[0]),
+    },
+    {
+        .name = "random", .description = "random byte from the PRNG of the VM",
+        .inputs = random_inputs, .inputs_count = sizeof(random_inputs)/sizeof(random_inputs[0]),
+    },
+    {
+        .name = "keyboard", .description = "non blocking raw terminal key read, 0 if no key is waiting",
+        .state_size = sizeof(KeyboardIo), .init = keyboard_init, .cleanup = keyboard_cleanup,
+        .inputs = keyboard_inputs, .inputs_count = sizeof(keyboard_inputs)/sizeof(keyboard_inputs[0]),
+    },
+    {
+        .name = "console", .description = "stdout, char prints a byte, int and uint print a signed or unsigned word",
+        .outputs = console_outputs, .outputs_count = sizeof(console_outputs)/sizeof(console_outputs[0]),
+    },
+    {
+        .name = "bank", .description = "memory banks, select shows a bank in the window from 0xC000 up, current reads the one shown",
+        .inputs = bank_inputs, .inputs_count = sizeof(bank_inputs)/sizeof(bank_inputs[0]),
+        .outputs = bank_outputs, .outputs_count = sizeof(bank_outputs)/sizeof(bank_outputs[0]),
+    },
+};
+#define DEVICE_COUNT (sizeof(device_registry)/sizeof(device_registry[0]))
+
+typedef struct {
+    const char* name;
+    const char* bindings;
+} DevicePreset;
+
+// std and dbg are the port layouts of the old std_io.c and dbg_io.c builds, with the bank switch of asm on port 4
+static const DevicePreset device_presets[] = {
+    {"std", "in:0=screen.flip,in:1=screen.quit,in:2=random.byte,out:0=screen.pixel,out:2=console.uint,in:4=bank.current,out:4=bank.select"},
+    {"dbg", "in:1=keyboard.key,out:2=console.char,out:3=console.int,in:4=bank.current,out:4=bank.select"},
+    {"none", ""},
+};
+#define DEVICE_PRESET_COUNT (sizeof(device_presets)/sizeof(device_presets[0]))
+
+typedef struct {
+    const Device* input_devices[SUBLANQ_PORT_COUNT];
+    SUBLANQ_InputFn input_fns[SUBLANQ_PORT_COUNT];
+    const Device* output_devices[SUBLANQ_PORT_COUNT];
+    SUBLANQ_OutputFn output_fns[SUBLANQ_PORT_COUNT];
+    void* states[DEVICE_COUNT];
+    bool active[DEVICE_COUNT];
+    bool initialized[DEVICE_COUNT]; // only these are cleaned up, apply stops at the first device that fails
+} DeviceConfig;
+
+static inline const Device* find_device(const char* name, size_t name_length) {
+    for (size_t i = 0; i < DEVICE_COUNT; ++i) {
+        if (strlen(device_registry[i].name) == name_length && strncmp(device_registry[i].name, name, name_length) == 0) return &device_registry[i];
+    }
+    return NULL;
+}
+
+// binding syntax is <port>=<device>.<handler>, is_input picks the input or output table
+static inline bool device_config_bind(DeviceConfig* config, bool is_input, const char* binding, size_t binding_length) {
+    char* end = NULL;
+    unsigned long port = strtoul(binding, &end, 10);
+    if (end == binding || *end != '=' || port >= SUBLANQ_PORT_COUNT) { fprintf(stderr, "Invalid port in binding '%.*s'\n", (int)binding_length, binding); return false; }
+    const char* device_name = end + 1;
+    const char* dot = memchr(device_name, '.', binding_length - (size_t)(device_name - binding));
+    if (!dot) { fprintf(stderr, "Expected <device>.<handler> in binding '%.*s'\n", (int)binding_length, binding); return false; }
+    const Device* device = find_device(device_name, (size_t)(dot - device_name));
+    if (!device) { fprintf(stderr, "Unknown device in binding '%.*s'\n", (int)binding_length, binding); return false; }
+    const char* handler_name = dot + 1;
+    size_t handler_length = binding_length - (size_t)(handler_name - binding);
+    if (is_input) {
+        for (size_t i = 0; i < device->inputs_count; ++i) {
+            if (strlen(device->inputs[i].name) != handler_length || strncmp(device->inputs[i].name, handler_name, handler_length) != 0) continue;
+            config->input_devices[port] = device;
+            config->input_fns[port] = device->inputs[i].fn;
+            return true;
+        }
+    }
+    else {
+        for (size_t i = 0; i < device->outputs_count; ++i) {
+            if (strlen(device->outputs[i].name) != handler_length || strncmp(device->outputs[i].name, handler_name, handler_length) != 0) continue;
+            config->output_devices[port] = device;
+            config->output_fns[port] = device->outputs[i].fn;
+            return true;
+        }
+    }
+    fprintf(stderr, "Device %s has no %s handler in binding '%.*s'\n", device->name, is_input ? "input" : "output", (int)binding_length, binding);
+    return false;
+}
+
+static inline bool device_config_preset(DeviceConfig* config, const char* name) {
+    for (size_t i = 0; i < DEVICE_PRESET_COUNT; ++i) {
+        if (strcmp(device_presets[i].name, name) != 0) continue;
+        memset(config, 0, sizeof(*config));
+        const char* cursor = device_presets[i].bindings;
+        while (*cursor) {
+            const char* comma = strchr(cursor, ',');
+            size_t length = comma ? (size_t)(comma - cursor) : strlen(cursor);
+            bool is_input = strncmp(cursor, "in:", 3) == 0;
+            size_t skip = is_input ? 3 : 4;
+            if (!device_config_bind(config, is_input, cursor + skip, length - skip)) return false;
+            cursor += length + (comma ? 1 : 0);
+        }
+        return true;
+    }
+    fprintf(stderr, "Unknown device preset '%s'\n", name);
+    return false;
+}
+
+// creates the state of every device that has a bound port and resolves the port tables of the VM
+static inline bool device_config_apply(DeviceConfig* config, SUBLANQ_VM* vm) {
+    for (size_t port = 0; port < SUBLANQ_PORT_COUNT; ++port) {
+        if (config->input_devices[port]) config->active[config->input_devices[port] - device_registry] = true;
+        if (config->output_devices[port]) config->active[config->output_devices[port] - device_registry] = true;
+    }
+    for (size_t i = 0; i < DEVICE_COUNT; ++i) {
+        if (!config->active[i]) continue;
+        if (device_registry[i].state_size) {
+            config->states[i] = calloc(1, device_registry[i].state_size);
+            if (!config->states[i]) { fprintf(stderr, "Device %s state alloc failed\n", device_registry[i].name); return false; }
+        }
+        if (device_registry[i].init && !device_registry[i].init(vm, config->states[i])) { fprintf(stderr, "Device %s failed to initialize\n", device_registry[i].name); return false; }
+        config->initialized[i] = true;
+    }
+    for (size_t port = 0; port < SUBLANQ_PORT_COUNT; ++port) {
+        if (config->input_devices[port]) SUBLANQ_bind_input(vm, (WORD_UTYPE)port, config->input_fns[port], config->states[config->input_devices[port] - device_registry]);
+        if (config->output_devices[port]) SUBLANQ_bind_output(vm, (WORD_UTYPE)port, config->output_fns[port], config->states[config->output_devices[port] - device_registry]);
+    }
+    return true;
+}
+
+static inline void device_config_cleanup(DeviceConfig* config) {
+    for (size_t i = 0; i < DEVICE_COUNT; ++i) {
+        if (config->initialized[i] && device_registry[i].cleanup) device_registry[i].cleanup(config->states[i]);
+        free(config->states[i]);
+        config->states[i] = NULL;
+        config->active[i] = false;
+        config->initialized[i] = false;
+    }
+}
+
+static inline void print_devices(void) {
+    printf("Devices:\n");
+    for (size_t i = 0; i < DEVICE_COUNT; ++i) {
+        printf("  %s - %s\n", device_registry[i].name, device_registry[i].description);
+        for (size_t j = 0; j < device_registry[i].inputs_count; ++j) printf("    in  %s.%s\n", device_registry[i].name, device_registry[i].inputs[j].name);
+        for (size_t j = 0; j < device_registry[i].outputs_count; ++j) printf("    out %s.%s\n", device_registry[i].name, device_registry[i].outputs[j].name);
+    }
+    printf("Presets:\n");
+    for (size_t i = 0; i < DEVICE_PRESET_COUNT; ++i) printf("  %s - %s\n", device_presets[i].name, device_presets[i].bindings);
+}
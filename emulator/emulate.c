@@ -1,22 +1,34 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #define WORD_SIZE 16
 #define WORD_STYPE int16_t
 #define WORD_UTYPE uint16_t
 #define WORD_MAX UINT16_MAX
 
-#include "std_io.c"
+#include "sublanq.h"
+#include "image_format.c"
+#include "devices.c"
+#include "profile.c"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "history.c"
+#include "gdb_stub.c"
+#include "trace.c"
+#endif
+// a native build of one program written by asm --emit-c, -I. -DSUBLANQ_NATIVE='"program.c"'
+#ifdef SUBLANQ_NATIVE
+#include SUBLANQ_NATIVE
+#endif
 
 // #define PRINT_STATE
 // #define GET_IPS
 // #define MANUAL_STEPPING
 
-#ifdef GET_IPS
-    #include <time.h>
-    size_t ops = 0;
-#endif
 
 static inline void debug(WORD_STYPE* program, WORD_UTYPE program_size, WORD_UTYPE pc){
     if (pc + 3 >= program_size) return;
@@ -34,70 +46,219 @@ static inline void debug(WORD_STYPE* program, WORD_UTYPE program_size, WORD_UTYP
     printf("\n");
 }
 
-static inline void subleq(WORD_STYPE* program, WORD_UTYPE program_size) {
-    // size_t pc = 0;
-    WORD_UTYPE pc = 0;
-    while (pc + 2 < program_size) {
+static inline void subleq(SUBLANQ_VM* vm, void* trace, uint64_t* profile) {
+    #ifdef SUBLANQ_NATIVE
+    // the interpreter takes over from vm->pc if the program jumps to an address the native code does not know
+    SUBLANQ_Stop native_stop = sublanq_native_run(vm);
+    if (native_stop == SUBLANQ_STOP_HALT || native_stop == SUBLANQ_STOP_END) return;
+    #endif
+    while (profile) {
+        SUBLANQ_Stop stop = profile_run(profile, vm, UINT64_MAX);
+        if (stop == SUBLANQ_STOP_HALT || stop == SUBLANQ_STOP_END) return;
+    }
+    #ifndef _WIN32
+    while (trace) {
+        SUBLANQ_Stop stop = trace_run(trace, vm, UINT64_MAX);
+        if (stop == SUBLANQ_STOP_HALT || stop == SUBLANQ_STOP_END) return;
+    }
+    #else
+    (void)trace;
+    #endif
+    #if defined(MANUAL_STEPPING) || defined(PRINT_STATE)
+    while (true) {
         #ifdef MANUAL_STEPPING
         getc(stdin);
         #endif
         #ifdef PRINT_STATE
-        debug(program, program_size, pc);
+        debug(vm->memory, vm->size, vm->pc);
         #endif
-        #ifdef GET_IPS
-        ++ops;
-        #endif
-        WORD_UTYPE a = program[pc];
-        WORD_UTYPE b = program[pc + 1];
-        WORD_UTYPE c = program[pc + 2];
-        if (a == WORD_MAX) program[b] = input(c);
-        else if (b == WORD_MAX) output(c, program[a]);
-        else if (c == WORD_MAX) break;
+        SUBLANQ_Stop stop = SUBLANQ_run(vm, 1);
+        if (stop == SUBLANQ_STOP_HALT || stop == SUBLANQ_STOP_END) break;
+    }
+    #else
+    while (true) {
+        SUBLANQ_Stop stop = SUBLANQ_run(vm, UINT64_MAX);
+        if (stop == SUBLANQ_STOP_HALT || stop == SUBLANQ_STOP_END) break;
+    }
+    #endif
+}
+
+// a .sq is a sectioned image (image_format.c) or a raw dump of the memory. the file is mapped where that is supported
+// and only the sections that store words are written to the memory, bss and the rest stay zero pages
+static inline void print_image(const Image* image) {
+    static const char* image_kind_names[IMAGE__KIND_END] = {"", "data", "rodata", "code", "bss", "symbols"};
+    printf("entry %u, size %u words\n", image->entry, (unsigned)image->size);
+    for (size_t i = 0; i < image->sections_count; ++i) {
+        const ImageSection* section = &image->sections[i];
+        if (section->kind == IMAGE_SYMBOLS) {
+            printf("%-8s %u\n", image_kind_names[section->kind], section->count);
+            char name[WORD_MAX + 1];
+            ImageSymbol symbol;
+            size_t cursor = 0;
+            for (size_t s = 0; s < section->count && image_symbol(image, section, &cursor, &symbol, name, sizeof(name)); ++s) {
+                printf("    %5u %-4s %s\n", symbol.address, symbol.kind == IMAGE_CODE ? "code" : "data", symbol.name);
+            }
+        }
+        else printf("%-8s %5u to %5u, %u words\n", image_kind_names[section->kind], section->start, section->start + section->count, section->count);
+    }
+}
+
+static inline bool load_program(SUBLANQ_VM* vm, const char* path, bool sections) {
+    uint8_t* bytes = NULL;
+    size_t length = 0;
+    #ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror("open"); return false; }
+    struct stat status;
+    if (fstat(fd, &status) != 0) { perror("fstat"); close(fd); return false; }
+    length = (size_t)status.st_size;
+    if (length) bytes = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (bytes == MAP_FAILED) { perror("mmap"); return false; }
+    #else
+    FILE* file = fopen(path, "rb");
+    if (!file) { perror("fopen"); return false; }
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long file_size = ftell(file);
+        length = file_size > 0 ? (size_t)file_size : 0;
+    }
+    rewind(file);
+    bytes = length ? malloc(length) : NULL;
+    if (length && (!bytes || fread(bytes, 1, length, file) != length)) { fprintf(stderr, "Failed to read binary program\n"); fclose(file); free(bytes); return false; }
+    fclose(file);
+    #endif
+    bool ok = false;
+    Image image;
+    if (image_is_container(bytes, length)) {
+        if (!image_parse(&image, bytes, length)) fprintf(stderr, "Invalid program image\n");
+        else if (sections) print_image(&image), ok = true;
+        else if (!SUBLANQ_load(vm, NULL, image.size)) fprintf(stderr, "Failed to load binary program\n");
         else {
-            program[b] -= program[a];
-            if (program[b] <= 0) {
-                pc = c;
-                continue;
+            for (size_t i = 0; i < image.sections_count; ++i) {
+                const ImageSection* section = &image.sections[i];
+                if (section->kind == IMAGE_BSS || section->kind == IMAGE_SYMBOLS) continue;
+                for (size_t w = 0; w < section->count; ++w) vm->memory[section->start + w] = (WORD_STYPE)image_word(&image, section, w);
             }
+            ok = true;
         }
-        pc += 3;
     }
+    else if (sections) fprintf(stderr, "%s is a raw memory dump without sections\n", path);
+    else if (length % sizeof(WORD_UTYPE) != 0) fprintf(stderr, "Invalid binary size\n");
+    else if (length / sizeof(WORD_UTYPE) > WORD_MAX) fprintf(stderr, "Program too large\n");
+    else if (!(ok = SUBLANQ_load(vm, (const WORD_UTYPE*)bytes, length / sizeof(WORD_UTYPE)))) fprintf(stderr, "Failed to load binary program\n");
+    #ifndef _WIN32
+    if (length) munmap(bytes, length);
+    #else
+    free(bytes);
+    #endif
+    return ok;
+}
+
+static inline void usage(const char* program_name) {
+    fprintf(stderr, "Usage: %s [--io <preset>] [--in <port>=<device>.<handler>]... [--out <port>=<device>.<handler>]... [--gdb <port|unix-socket> [--history <interval>[,<checkpoints>]]] [--trace <file>] [--profile <file>] <program.sq>\n", program_name);
+    fprintf(stderr, "       %s --devices\n", program_name);
+    fprintf(stderr, "       %s --sections <program.sq>\n", program_name);
 }
 
 int main(int argc, char **argv) {
 
-    if (argc < 2) {fprintf(stderr, "Usage: %s <program.sq>\n", argv[0]); return 1;}
-    FILE *f = fopen(argv[1], "rb");
-    if (!f) {perror("fopen"); return 1;}
-    if (fseek(f, 0, SEEK_END) != 0) { perror("fseek"); fclose(f); return 1; }
-    long file_size = ftell(f);
-    if (file_size < 0) { perror("ftell"); fclose(f); return 1; }
-    if (file_size % sizeof(WORD_UTYPE) != 0) { fprintf(stderr, "Invalid binary size\n"); fclose(f); return 1; }
-    size_t word_count = (size_t)(file_size / sizeof(WORD_UTYPE));
-    if (word_count > WORD_MAX) { fprintf(stderr, "Program too large\n"); fclose(f); return 1; }
-    WORD_UTYPE size = (WORD_UTYPE)word_count;
-    rewind(f);
-    WORD_STYPE *program = malloc(size * sizeof(WORD_STYPE));
-    if (!program) { perror("malloc"); fclose(f); return 1; }
-    size_t r = fread(program, sizeof(WORD_STYPE), size, f);
-    fclose(f);
-    if (r != size) { fprintf(stderr, "Failed to read binary program\n"); free(program); return 1; }
-
-    init_io();
+    const char* program_path = NULL;
+    const char* gdb_target = NULL;
+    const char* trace_path = NULL;
+    const char* profile_path = NULL;
+    unsigned long long history_interval = 0, history_checkpoints = 8;
+    bool sections = false;
+    DeviceConfig devices = {0};
+    if (!device_config_preset(&devices, "std")) return 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--devices") == 0) { print_devices(); return 0; }
+        else if (strcmp(argv[i], "--sections") == 0) sections = true;
+        else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc) { if (!device_config_preset(&devices, argv[++i])) return 1; }
+        else if (strcmp(argv[i], "--in") == 0 && i + 1 < argc) { ++i; if (!device_config_bind(&devices, true, argv[i], strlen(argv[i]))) return 1; }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) { ++i; if (!device_config_bind(&devices, false, argv[i], strlen(argv[i]))) return 1; }
+        else if (strcmp(argv[i], "--gdb") == 0 && i + 1 < argc) gdb_target = argv[++i];
+        else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+            char* end = NULL;
+            history_interval = strtoull(argv[++i], &end, 10);
+            if (*end == ',') history_checkpoints = strtoull(end + 1, &end, 10);
+            if (*end != '\0' || history_interval == 0 || history_checkpoints == 0) { usage(argv[0]); return 1; }
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) trace_path = argv[++i];
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) profile_path = argv[++i];
+        else if (argv[i][0] != '-' && !program_path) program_path = argv[i];
+        else { usage(argv[0]); return 1; }
+    }
+    #ifdef SUBLANQ_NATIVE
+    if (program_path || sections || gdb_target || history_interval || trace_path || profile_path) { fprintf(stderr, "A native build runs its own program, without --sections, --gdb, --history, --trace and --profile\n"); return 1; }
+    SUBLANQ_VM vm = {0};
+    if (!SUBLANQ_load(&vm, sublanq_native_image, sublanq_native_size)) { fprintf(stderr, "Failed to load binary program\n"); return 1; }
+    #else
+    if (!program_path) { usage(argv[0]); return 1; }
+    if (history_interval && !gdb_target) { fprintf(stderr, "--history is only used with --gdb\n"); return 1; }
+    if (trace_path && gdb_target) { fprintf(stderr, "--trace can not be used with --gdb\n"); return 1; }
+    if (profile_path && (gdb_target || trace_path)) { fprintf(stderr, "--profile can not be used with --gdb or --trace\n"); return 1; }
+
+    SUBLANQ_VM vm = {0};
+    if (!load_program(&vm, program_path, sections)) return 1;
+    if (sections) return 0;
+    #endif
+
+    SUBLANQ_seed(&vm, (uint64_t)time(NULL));
+    if (!device_config_apply(&devices, &vm)) { device_config_cleanup(&devices); SUBLANQ_cleanup(&vm); return 1; }
 
     #ifdef GET_IPS
         clock_t start = clock();
     #endif
 
-    subleq(program, size);
+    bool run = true;
+    uint64_t* profile = NULL;
+    if (profile_path) {
+        profile = calloc(SUBLANQ_MEMORY_WORDS, sizeof(uint64_t));
+        if (!profile) { perror("calloc"); run = false; }
+    }
+    if (gdb_target) {
+        #ifndef _WIN32
+        GdbStub* stub = calloc(1, sizeof(GdbStub));
+        History history = {0};
+        if (!stub) { perror("calloc"); run = false; }
+        else if (history_interval && !history_init(&history, &vm, history_interval, history_checkpoints)) { fprintf(stderr, "History of %llu * %llu steps can not be allocated\n", history_interval, history_checkpoints); run = false; }
+        else {
+            if (history_interval) stub->history = &history;
+            stub->fd = gdb_listen(gdb_target);
+            run = stub->fd >= 0 && gdb_serve(stub, &vm);
+            if (stub->fd >= 0) close(stub->fd);
+        }
+        history_free(&history);
+        free(stub);
+        #else
+        fprintf(stderr, "--gdb is not supported on this platform\n");
+        run = false;
+        #endif
+    }
+    #ifndef _WIN32
+    Trace* trace = NULL;
+    if (run && trace_path) {
+        trace = calloc(1, sizeof(Trace));
+        if (!trace) { perror("calloc"); run = false; }
+        else if (!trace_open(trace, &vm, trace_path)) run = false;
+    }
+    if (run) subleq(&vm, trace, profile);
+    if (trace && !trace_close(trace)) fprintf(stderr, "Failed to write trace %s\n", trace_path);
+    free(trace);
+    #else
+    if (trace_path) { fprintf(stderr, "--trace is not supported on this platform\n"); run = false; }
+    if (run) subleq(&vm, NULL, profile);
+    #endif
+    if (run && profile && !profile_write(profile, profile_path)) fprintf(stderr, "Failed to write profile %s\n", profile_path);
+    free(profile);
 
     #ifdef GET_IPS
         double clocks = (((double)(clock() - start))/CLOCKS_PER_SEC);
-        printf("\n%zu, %f, %f\n", ops, clocks, ((double)ops)/clocks);
+        printf("\n%llu, %f, %f\n", (unsigned long long)vm.steps, clocks, ((double)vm.steps)/clocks);
     #endif
 
-    cleanup_io();
-    free(program);
+    device_config_cleanup(&devices);
+    SUBLANQ_cleanup(&vm);
 
     return 0;
 }
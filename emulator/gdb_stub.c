@@ -0,0 +1,449 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+// GDB remote serial protocol stub
+// - the target has one 32-bit register, the pc (register 0), as a byte address like memory
+// - memory is presented byte addressed and little endian, word w is at bytes 2w and 2w+1
+// - Z0/Z1 set breakpoints, Z2/Z3/Z4 set write/read/access watchpoints, all of them are bitmaps in SUBLANQ_Debug
+// - while nothing is set continue runs the plain SUBLANQ_run loop, the socket is polled for ^C between slices
+// - with a History, steps are recorded and bs/bc (reverse-step, reverse-continue) travel back through it,
+//   s/c replay from the log until they are back at the head and then continue live, without breakpoints and watchpoints
+//   continuing in the log seeks from the nearest checkpoint instead of stepping, like monitor seek <step>
+//   halting or running off the end is then reported as a stop instead of an exit so the run can still be reversed
+//   monitor lastwrite <word> tells which step and pc last wrote a word, monitor history shows what is recorded
+
+#define GDB_PACKET_SIZE 4096
+#define GDB_SLICE_STEPS (1u << 20)
+
+static const char gdb_target_xml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\">"
+    "<feature name=\"org.sublanq.core\">"
+    "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\" regnum=\"0\"/>"
+    "</feature>"
+    "</target>";
+
+typedef struct {
+    int fd;
+    SUBLANQ_Debug debug;
+    size_t breakpoint_count;
+    size_t watchpoint_count;
+    char packet[GDB_PACKET_SIZE + 1];
+    size_t packet_length;
+    bool attached;
+    bool interrupted;
+    History* history;
+    bool replay_begin;
+} GdbStub;
+
+static inline int gdb_listen(const char* target) {
+    char* end = NULL;
+    unsigned long port = strtoul(target, &end, 10);
+    int server = -1;
+    if (*target && *end == '\0') {
+        if (port == 0 || port > 65535) { fprintf(stderr, "Invalid gdb port %s\n", target); return -1; }
+        server = socket(AF_INET, SOCK_STREAM, 0);
+        if (server < 0) { perror("socket"); return -1; }
+        int one = 1;
+        setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in address = {0};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons((uint16_t)port);
+        if (bind(server, (struct sockaddr*)&address, sizeof(address)) != 0) { perror("bind"); close(server); return -1; }
+    }
+    else {
+        struct sockaddr_un address = {0};
+        address.sun_family = AF_UNIX;
+        if (strlen(target) >= sizeof(address.sun_path)) { fprintf(stderr, "gdb socket path too long\n"); return -1; }
+        strcpy(address.sun_path, target);
+        server = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server < 0) { perror("socket"); return -1; }
+        unlink(target);
+        if (bind(server, (struct sockaddr*)&address, sizeof(address)) != 0) { perror("bind"); close(server); return -1; }
+    }
+    if (listen(server, 1) != 0) { perror("listen"); close(server); return -1; }
+    fprintf(stderr, "Waiting for gdb on %s\n", target);
+    int client = accept(server, NULL, NULL);
+    if (client < 0) perror("accept");
+    close(server);
+    if (client >= 0) {
+        int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return client;
+}
+
+static inline int gdb_hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+static inline size_t gdb_parse_hex(const char** cursor) {
+    size_t value = 0;
+    while (gdb_hex_value(**cursor) >= 0) value = value * 16 + (size_t)gdb_hex_value(*(*cursor)++);
+    return value;
+}
+// the pc goes over the wire as the byte address of its word, 4 bytes little endian
+static inline void gdb_put_pc(const SUBLANQ_VM* vm, char* reply) {
+    uint32_t address = (uint32_t)vm->pc * 2;
+    sprintf(reply, "%02x%02x%02x%02x", address & 0xFF, address >> 8 & 0xFF, address >> 16 & 0xFF, address >> 24);
+}
+static inline bool gdb_parse_pc(const char* cursor, WORD_UTYPE* pc) {
+    if (strlen(cursor) < 8) return false;
+    uint32_t address = 0;
+    for (int i = 3; i >= 0; --i) {
+        int high = gdb_hex_value(cursor[i * 2]), low = gdb_hex_value(cursor[i * 2 + 1]);
+        if (high < 0 || low < 0) return false;
+        address = address << 8 | (uint32_t)(high << 4 | low);
+    }
+    if (address >= SUBLANQ_MEMORY_WORDS * 2) return false;
+    *pc = (WORD_UTYPE)(address / 2);
+    return true;
+}
+
+static inline bool gdb_write_all(GdbStub* stub, const char* data, size_t length) {
+    while (length) {
+        ssize_t n = write(stub->fd, data, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+static inline bool gdb_send(GdbStub* stub, const char* payload) {
+    static const char hex[] = "0123456789abcdef";
+    size_t length = strlen(payload);
+    uint8_t checksum = 0;
+    for (size_t i = 0; i < length; ++i) checksum += (uint8_t)payload[i];
+    char trailer[3] = {'#', hex[checksum >> 4], hex[checksum & 15]};
+    return gdb_write_all(stub, "$", 1) && gdb_write_all(stub, payload, length) && gdb_write_all(stub, trailer, 3);
+}
+
+// reads one packet into stub->packet, returns false when the connection is gone
+// a lone ^C outside of a packet is returned as the packet "\x03"
+static inline bool gdb_receive(GdbStub* stub) {
+    char c = 0;
+    while (true) {
+        ssize_t n = read(stub->fd, &c, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        if (c == 0x03) { stub->packet[0] = 0x03; stub->packet[1] = '\0'; stub->packet_length = 1; return true; }
+        if (c != '$') continue;
+        stub->packet_length = 0;
+        uint8_t checksum = 0;
+        while (true) {
+            n = read(stub->fd, &c, 1);
+            if (n <= 0) return false;
+            if (c == '#') break;
+            checksum += (uint8_t)c;
+            if (stub->packet_length < GDB_PACKET_SIZE) stub->packet[stub->packet_length++] = c;
+        }
+        char sum[2];
+        if (read(stub->fd, &sum[0], 1) <= 0 || read(stub->fd, &sum[1], 1) <= 0) return false;
+        stub->packet[stub->packet_length] = '\0';
+        if (gdb_hex_value(sum[0]) * 16 + gdb_hex_value(sum[1]) != checksum) { gdb_write_all(stub, "-", 1); continue; }
+        gdb_write_all(stub, "+", 1);
+        return true;
+    }
+}
+
+static inline bool gdb_interrupted(GdbStub* stub) {
+    struct pollfd pfd = {.fd = stub->fd, .events = POLLIN};
+    if (poll(&pfd, 1, 0) <= 0) return false;
+    char c = 0;
+    if (read(stub->fd, &c, 1) != 1) { stub->attached = false; return true; }
+    return c == 0x03;
+}
+
+static inline void gdb_stop_reply(GdbStub* stub, SUBLANQ_VM* vm, SUBLANQ_Stop stop, char* reply) {
+    (void)vm;
+    switch (stop) {
+    case SUBLANQ_STOP_HALT:
+    case SUBLANQ_STOP_END: strcpy(reply, stub->history ? "S05" : "W00"); break;
+    case SUBLANQ_STOP_BREAK: strcpy(reply, "T05swbreak:;"); break;
+    case SUBLANQ_STOP_WATCH:
+        sprintf(reply, "T05%s:%zx;", stub->debug.watch_kind == SUBLANQ_WATCH_WRITE ? "watch" : "rwatch", (size_t)stub->debug.watch_address * 2);
+    break;
+    default:
+        if (stub->replay_begin) strcpy(reply, "T05replaylog:begin;");
+        else strcpy(reply, stub->interrupted ? "S02" : "S05");
+    break;
+    }
+}
+
+static inline bool gdb_watch_hit(GdbStub* stub, WORD_UTYPE a, WORD_UTYPE b, const HistoryEntry* entry) {
+    bool writes = !(entry->address == entry->pc && entry->old_value == entry->new_value);
+    if (writes && SUBLANQ_BIT_TEST(stub->debug.watch_write, entry->address)) { stub->debug.watch_address = entry->address; stub->debug.watch_kind = SUBLANQ_WATCH_WRITE; return true; }
+    if (a != WORD_MAX && SUBLANQ_BIT_TEST(stub->debug.watch_read, a)) { stub->debug.watch_address = a; stub->debug.watch_kind = SUBLANQ_WATCH_READ; return true; }
+    if (a != WORD_MAX && b != WORD_MAX && SUBLANQ_BIT_TEST(stub->debug.watch_read, b)) { stub->debug.watch_address = b; stub->debug.watch_kind = SUBLANQ_WATCH_READ; return true; }
+    return false;
+}
+
+// moves through the recorded history, returns false when going forward reached the head with steps left
+static inline bool gdb_replay(GdbStub* stub, SUBLANQ_VM* vm, bool reverse, uint64_t* left, SUBLANQ_Stop* stop) {
+    History* history = stub->history;
+    bool checks = stub->breakpoint_count || stub->watchpoint_count;
+    bool first = true;
+    *stop = SUBLANQ_STOP_BUDGET;
+    if (!checks) {
+        uint64_t room = reverse ? history->position - history->first : history->head - history->position;
+        uint64_t moved = room < *left ? room : *left;
+        history_seek(history, vm, reverse ? history->position - moved : history->position + moved);
+        *left -= moved;
+        if (!*left) return true;
+        if (reverse) stub->replay_begin = true;
+        return reverse;
+    }
+    while (*left) {
+        if (!reverse && history_at_head(history)) return false;
+        if (!reverse && !first && SUBLANQ_BIT_TEST(stub->debug.breakpoints, vm->pc)) { *stop = SUBLANQ_STOP_BREAK; return true; }
+        if (reverse && !history_step_back(history, vm)) { stub->replay_begin = true; return true; }
+        WORD_UTYPE a = (WORD_UTYPE)vm->memory[vm->pc];
+        WORD_UTYPE b = (WORD_UTYPE)vm->memory[(WORD_UTYPE)(vm->pc + 1)];
+        if (!reverse) history_step_forward(history, vm);
+        --*left;
+        first = false;
+        if (!checks) continue;
+        const HistoryEntry* entry = &history->log[(reverse ? history->position : history->position - 1) % history->log_capacity];
+        if (gdb_watch_hit(stub, a, b, entry)) { *stop = SUBLANQ_STOP_WATCH; return true; }
+        if (reverse && SUBLANQ_BIT_TEST(stub->debug.breakpoints, vm->pc)) { *stop = SUBLANQ_STOP_BREAK; return true; }
+    }
+    return true;
+}
+
+// runs max_steps steps (UINT64_MAX to continue) forward or backward, stopping at breakpoints, watchpoints and ^C
+// the loops ignore a breakpoint on the pc they start from, so it is checked here whenever a new slice starts mid-run
+static inline SUBLANQ_Stop gdb_resume(GdbStub* stub, SUBLANQ_VM* vm, bool reverse, uint64_t max_steps) {
+    stub->interrupted = false;
+    stub->replay_begin = false;
+    uint64_t left = max_steps;
+    while (true) {
+        uint64_t slice = left < GDB_SLICE_STEPS ? left : GDB_SLICE_STEPS;
+        bool checks = stub->breakpoint_count || stub->watchpoint_count;
+        if (left != max_steps && !reverse && SUBLANQ_BIT_TEST(stub->debug.breakpoints, vm->pc)) return SUBLANQ_STOP_BREAK;
+        SUBLANQ_Stop stop;
+        if (stub->history && (reverse || !history_at_head(stub->history))) {
+            uint64_t slice_left = slice;
+            bool stopped = gdb_replay(stub, vm, reverse, &slice_left, &stop);
+            left -= slice - slice_left;
+            if (stopped && (stop != SUBLANQ_STOP_BUDGET || stub->replay_begin)) return stop;
+            stop = SUBLANQ_STOP_BUDGET;
+        }
+        else {
+            uint64_t steps_before = vm->steps;
+            if (stub->history) stop = history_record(stub->history, vm, slice, checks ? &stub->debug : NULL);
+            else if (checks) stop = SUBLANQ_run_debug(vm, slice, &stub->debug);
+            else stop = SUBLANQ_run(vm, slice);
+            left -= vm->steps - steps_before;
+            if (stop != SUBLANQ_STOP_BUDGET && stop != SUBLANQ_STOP_YIELD) return stop;
+        }
+        if (left == 0) return SUBLANQ_STOP_BUDGET;
+        if (gdb_interrupted(stub)) { stub->interrupted = true; return SUBLANQ_STOP_BUDGET; }
+    }
+}
+
+// the debugger is about to change the state, recorded steps after this point are no longer true
+static inline void gdb_state_changed(GdbStub* stub, SUBLANQ_VM* vm) {
+    if (stub->history) history_truncate(stub->history, vm);
+}
+
+static inline void gdb_monitor(GdbStub* stub, SUBLANQ_VM* vm, const char* hex_command, char* reply) {
+    static const char hex[] = "0123456789abcdef";
+    char command[256] = {0};
+    char text[512] = {0};
+    size_t length = 0;
+    while (hex_command[0] && hex_command[1] && length + 1 < sizeof(command)) {
+        command[length++] = (char)(gdb_hex_value(hex_command[0]) << 4 | gdb_hex_value(hex_command[1]));
+        hex_command += 2;
+    }
+    History* history = stub->history;
+    if (strncmp(command, "lastwrite ", 10) == 0) {
+        if (!history) snprintf(text, sizeof(text), "history is not enabled, run with --history\n");
+        else {
+            unsigned long word = strtoul(command + 10, NULL, 0);
+            uint64_t step = 0;
+            WORD_UTYPE pc = 0;
+            if (word > WORD_MAX) snprintf(text, sizeof(text), "word %lu is out of range\n", word);
+            else if (history_last_write(history, (WORD_UTYPE)word, &step, &pc)) snprintf(text, sizeof(text), "word %lu was last written at step %llu by the instruction at pc %u\n", word, (unsigned long long)step, pc);
+            else snprintf(text, sizeof(text), "word %lu was not written in the recorded history\n", word);
+        }
+    }
+    else if (strncmp(command, "seek ", 5) == 0) {
+        unsigned long long step = strtoull(command + 5, NULL, 0);
+        if (!history) snprintf(text, sizeof(text), "history is not enabled, run with --history\n");
+        else if (!history_seek(history, vm, step)) snprintf(text, sizeof(text), "step %llu is not in the recorded steps %llu to %llu\n", step, (unsigned long long)history->first, (unsigned long long)history->head);
+        else snprintf(text, sizeof(text), "at step %llu, pc %u\n", step, vm->pc);
+    }
+    else if (strcmp(command, "history") == 0) {
+        if (!history) snprintf(text, sizeof(text), "history is not enabled, run with --history\n");
+        else snprintf(text, sizeof(text), "recorded steps %llu to %llu, at step %llu, pc %u\n", (unsigned long long)history->first, (unsigned long long)history->head, (unsigned long long)history->position, vm->pc);
+    }
+    else snprintf(text, sizeof(text), "commands: lastwrite <word>, seek <step>, history\n");
+    size_t i = 0;
+    for (; text[i]; ++i) {
+        reply[i * 2] = hex[(uint8_t)text[i] >> 4];
+        reply[i * 2 + 1] = hex[(uint8_t)text[i] & 15];
+    }
+    reply[i * 2] = '\0';
+}
+
+static inline void gdb_set_point(GdbStub* stub, char type, size_t address, size_t length, bool set, char* reply) {
+    size_t first = address / 2;
+    size_t last = (address + (length ? length : 1) - 1) / 2;
+    if (last >= SUBLANQ_MEMORY_WORDS) { strcpy(reply, "E01"); return; }
+    for (size_t word = first; word <= last; ++word) {
+        if (type == '0' || type == '1') {
+            if (set == (bool)SUBLANQ_BIT_TEST(stub->debug.breakpoints, word)) continue;
+            if (set) { SUBLANQ_BIT_SET(stub->debug.breakpoints, word); ++stub->breakpoint_count; }
+            else { SUBLANQ_BIT_CLEAR(stub->debug.breakpoints, word); --stub->breakpoint_count; }
+            continue;
+        }
+        if (type == '2' || type == '4') {
+            if (set != (bool)SUBLANQ_BIT_TEST(stub->debug.watch_write, word)) {
+                if (set) { SUBLANQ_BIT_SET(stub->debug.watch_write, word); ++stub->watchpoint_count; }
+                else { SUBLANQ_BIT_CLEAR(stub->debug.watch_write, word); --stub->watchpoint_count; }
+            }
+        }
+        if (type == '3' || type == '4') {
+            if (set != (bool)SUBLANQ_BIT_TEST(stub->debug.watch_read, word)) {
+                if (set) { SUBLANQ_BIT_SET(stub->debug.watch_read, word); ++stub->watchpoint_count; }
+                else { SUBLANQ_BIT_CLEAR(stub->debug.watch_read, word); --stub->watchpoint_count; }
+            }
+        }
+    }
+    strcpy(reply, "OK");
+}
+
+// serves one gdb connection, returns when gdb detaches, kills or disconnects
+// returns true when the program should keep running without the debugger
+static inline bool gdb_serve(GdbStub* stub, SUBLANQ_VM* vm) {
+    static const char hex[] = "0123456789abcdef";
+    static char reply[GDB_PACKET_SIZE * 2 + 64];
+    stub->attached = true;
+    while (stub->attached && gdb_receive(stub)) {
+        const char* cursor = stub->packet + 1;
+        reply[0] = '\0';
+        switch (stub->packet[0]) {
+        case 0x03:
+        case '?': strcpy(reply, "S05"); break;
+        case 'g': gdb_put_pc(vm, reply); break;
+        case 'G': {
+            WORD_UTYPE pc;
+            if (!gdb_parse_pc(cursor, &pc)) { strcpy(reply, "E01"); break; }
+            gdb_state_changed(stub, vm);
+            vm->pc = pc;
+            strcpy(reply, "OK");
+        } break;
+        case 'p':
+            if (gdb_parse_hex(&cursor) == 0) gdb_put_pc(vm, reply);
+            else strcpy(reply, "E01");
+        break;
+        case 'P': {
+            size_t regnum = gdb_parse_hex(&cursor);
+            WORD_UTYPE pc;
+            if (regnum != 0 || *cursor != '=' || !gdb_parse_pc(cursor + 1, &pc)) { strcpy(reply, "E01"); break; }
+            gdb_state_changed(stub, vm);
+            vm->pc = pc;
+            strcpy(reply, "OK");
+        } break;
+        case 'm': {
+            size_t address = gdb_parse_hex(&cursor);
+            if (*cursor++ != ',') { strcpy(reply, "E01"); break; }
+            size_t length = gdb_parse_hex(&cursor);
+            if (length > GDB_PACKET_SIZE / 2) length = GDB_PACKET_SIZE / 2;
+            if (address + length > SUBLANQ_MEMORY_WORDS * 2) { strcpy(reply, "E01"); break; }
+            for (size_t i = 0; i < length; ++i) {
+                size_t word = (address + i) / 2;
+                uint8_t byte = (address + i) & 1 ? (uint8_t)((WORD_UTYPE)vm->memory[word] >> 8) : (uint8_t)vm->memory[word];
+                reply[i * 2] = hex[byte >> 4];
+                reply[i * 2 + 1] = hex[byte & 15];
+            }
+            reply[length * 2] = '\0';
+        } break;
+        case 'M': {
+            size_t address = gdb_parse_hex(&cursor);
+            if (*cursor++ != ',') { strcpy(reply, "E01"); break; }
+            size_t length = gdb_parse_hex(&cursor);
+            if (*cursor++ != ':' || strlen(cursor) < length * 2 || address + length > SUBLANQ_MEMORY_WORDS * 2) { strcpy(reply, "E01"); break; }
+            gdb_state_changed(stub, vm);
+            for (size_t i = 0; i < length; ++i) {
+                size_t word = (address + i) / 2;
+                WORD_UTYPE byte = (WORD_UTYPE)(gdb_hex_value(cursor[i * 2]) << 4 | gdb_hex_value(cursor[i * 2 + 1]));
+                WORD_UTYPE value = (WORD_UTYPE)vm->memory[word];
+                if ((address + i) & 1) value = (WORD_UTYPE)((value & 0x00FF) | byte << 8);
+                else value = (WORD_UTYPE)((value & 0xFF00) | byte);
+                vm->memory[word] = (WORD_STYPE)value;
+            }
+            strcpy(reply, "OK");
+        } break;
+        case 'c':
+        case 's': {
+            if (*cursor) { gdb_state_changed(stub, vm); vm->pc = (WORD_UTYPE)(gdb_parse_hex(&cursor) / 2); }
+            SUBLANQ_Stop stop = gdb_resume(stub, vm, false, stub->packet[0] == 's' ? 1 : UINT64_MAX);
+            gdb_stop_reply(stub, vm, stop, reply);
+        } break;
+        case 'b':
+            if (!stub->history || (stub->packet[1] != 's' && stub->packet[1] != 'c')) break;
+            gdb_stop_reply(stub, vm, gdb_resume(stub, vm, true, stub->packet[1] == 's' ? 1 : UINT64_MAX), reply);
+        break;
+        case 'v':
+            if (strcmp(stub->packet, "vCont?") == 0) strcpy(reply, "vCont;c;s");
+            else if (strncmp(stub->packet, "vCont;", 6) == 0) {
+                SUBLANQ_Stop stop = gdb_resume(stub, vm, false, stub->packet[6] == 's' ? 1 : UINT64_MAX);
+                gdb_stop_reply(stub, vm, stop, reply);
+            }
+            else if (strncmp(stub->packet, "vKill", 5) == 0) { gdb_send(stub, "OK"); return false; }
+        break;
+        case 'Z':
+        case 'z': {
+            char type = *cursor++;
+            if (type < '0' || type > '4' || *cursor++ != ',') break;
+            size_t address = gdb_parse_hex(&cursor);
+            if (*cursor++ != ',') { strcpy(reply, "E01"); break; }
+            size_t length = gdb_parse_hex(&cursor);
+            gdb_set_point(stub, type, address, type <= '1' ? 1 : length, stub->packet[0] == 'Z', reply);
+        } break;
+        case 'q':
+            if (strncmp(stub->packet, "qSupported", 10) == 0) sprintf(reply, "PacketSize=%x;qXfer:features:read+;swbreak+;hwbreak+%s", GDB_PACKET_SIZE, stub->history ? ";ReverseStep+;ReverseContinue+" : "");
+            else if (strncmp(stub->packet, "qRcmd,", 6) == 0) gdb_monitor(stub, vm, stub->packet + 6, reply);
+            else if (strcmp(stub->packet, "qAttached") == 0) strcpy(reply, "1");
+            else if (strcmp(stub->packet, "qC") == 0) strcpy(reply, "QC1");
+            else if (strcmp(stub->packet, "qfThreadInfo") == 0) strcpy(reply, "m1");
+            else if (strcmp(stub->packet, "qsThreadInfo") == 0) strcpy(reply, "l");
+            else if (strncmp(stub->packet, "qXfer:features:read:target.xml:", 31) == 0) {
+                cursor = stub->packet + 31;
+                size_t offset = gdb_parse_hex(&cursor);
+                if (*cursor++ != ',') { strcpy(reply, "E01"); break; }
+                size_t length = gdb_parse_hex(&cursor);
+                size_t total = sizeof(gdb_target_xml) - 1;
+                if (offset >= total) { strcpy(reply, "l"); break; }
+                if (length > GDB_PACKET_SIZE - 1) length = GDB_PACKET_SIZE - 1;
+                if (length > total - offset) length = total - offset;
+                reply[0] = offset + length < total ? 'm' : 'l';
+                memcpy(reply + 1, gdb_target_xml + offset, length);
+                reply[length + 1] = '\0';
+            }
+        break;
+        case 'H': strcpy(reply, "OK"); break;
+        case 'D': gdb_send(stub, "OK"); return true;
+        case 'k': return false;
+        default: break;
+        }
+        if (!gdb_send(stub, reply)) break;
+    }
+    return true;
+}
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// execution history for reverse debugging
+// - every recorded step logs the pc it ran at and the one word it wrote, with the value before and after
+//   so a step can be undone (reverse-step) or redone without re-running devices (input values are the logged new values)
+// - steps that write nothing (output, halt) are logged as a no-op write of the word at pc to itself
+// - an output that switched the memory bank is also kept in a list of bank switches, undoing or redoing the step
+//   selects the bank it switched from or to
+// - every interval steps a full memory checkpoint is taken into a ring of count checkpoints
+//   the log keeps count * interval steps, checkpoints bound the cost of seeking anywhere in it to interval redos
+//   they only hold the window of the bank that was selected, so once a bank was switched seeking steps the whole way
+// - position is where the VM is in the history, it is below head after travelling back
+
+typedef struct {
+    WORD_UTYPE pc, address, old_value, new_value;
+} HistoryEntry;
+
+typedef struct {
+    uint64_t step;
+    WORD_UTYPE old_bank, new_bank;
+} HistoryBank;
+
+typedef struct {
+    WORD_STYPE* memory;
+    WORD_UTYPE pc;
+    uint64_t step;
+    bool valid;
+} HistoryCheckpoint;
+
+typedef struct {
+    uint64_t interval;
+    size_t checkpoint_count;
+    HistoryCheckpoint* checkpoints;
+    uint64_t next_checkpoint_step;
+    HistoryEntry* log;
+    uint64_t log_capacity;
+    uint64_t first;
+    uint64_t head;
+    uint64_t position;
+    WORD_UTYPE head_pc;
+    // the bank switches from first to head in step order, bank_cursor is the number of them before position
+    HistoryBank* banks;
+    size_t banks_count, banks_capacity, bank_cursor;
+} History;
+
+static inline bool history_init(History* history, SUBLANQ_VM* vm, uint64_t interval, size_t checkpoint_count) {
+    memset(history, 0, sizeof(*history));
+    if (interval == 0 || checkpoint_count == 0 || checkpoint_count > UINT64_MAX / interval) return false;
+    if (interval * checkpoint_count > SIZE_MAX / sizeof(HistoryEntry)) return false;
+    history->interval = interval;
+    history->checkpoint_count = checkpoint_count;
+    history->log_capacity = interval * checkpoint_count;
+    history->checkpoints = calloc(checkpoint_count, sizeof(HistoryCheckpoint));
+    history->log = malloc(history->log_capacity * sizeof(HistoryEntry));
+    if (!history->checkpoints || !history->log) return false;
+    for (size_t i = 0; i < checkpoint_count; ++i) {
+        history->checkpoints[i].memory = malloc(SUBLANQ_MEMORY_WORDS * sizeof(WORD_STYPE));
+        if (!history->checkpoints[i].memory) return false;
+    }
+    history->first = history->head = history->position = vm->steps;
+    history->next_checkpoint_step = vm->steps;
+    history->head_pc = vm->pc;
+    return true;
+}
+static inline void history_free(History* history) {
+    if (history->checkpoints) for (size_t i = 0; i < history->checkpoint_count; ++i) free(history->checkpoints[i].memory);
+    free(history->checkpoints);
+    free(history->log);
+    free(history->banks);
+    memset(history, 0, sizeof(*history));
+}
+
+static inline void history_checkpoint(History* history, SUBLANQ_VM* vm, WORD_UTYPE pc, uint64_t step) {
+    // reuse a free slot, or else the oldest checkpoint, everything before the next oldest falls out of the log
+    HistoryCheckpoint* checkpoint = NULL;
+    for (size_t i = 0; i < history->checkpoint_count; ++i) {
+        HistoryCheckpoint* candidate = &history->checkpoints[i];
+        if (!candidate->valid) { checkpoint = candidate; break; }
+        if (!checkpoint || candidate->step < checkpoint->step) checkpoint = candidate;
+    }
+    memcpy(checkpoint->memory, vm->memory, SUBLANQ_MEMORY_WORDS * sizeof(WORD_STYPE));
+    checkpoint->pc = pc;
+    checkpoint->step = step;
+    checkpoint->valid = true;
+    history->next_checkpoint_step = step + history->interval;
+    uint64_t first = step;
+    for (size_t i = 0; i < history->checkpoint_count; ++i) {
+        if (history->checkpoints[i].valid && history->checkpoints[i].step < first) first = history->checkpoints[i].step;
+    }
+    history->first = first;
+    // the bank switches that fell out of the log go with it
+    size_t dropped = 0;
+    while (dropped < history->banks_count && history->banks[dropped].step < first) ++dropped;
+    if (!dropped) return;
+    memmove(history->banks, history->banks + dropped, (history->banks_count - dropped) * sizeof(HistoryBank));
+    history->banks_count -= dropped;
+    history->bank_cursor -= dropped < history->bank_cursor ? dropped : history->bank_cursor;
+}
+
+static inline void history_bank_switched(History* history, uint64_t step, size_t old_bank, size_t new_bank) {
+    if (history->banks_count == history->banks_capacity) {
+        history->banks_capacity = history->banks_capacity ? history->banks_capacity * 2 : 64;
+        history->banks = realloc(history->banks, history->banks_capacity * sizeof(HistoryBank));
+        if (!history->banks) { fprintf(stderr, "History alloc failed\n"); exit(1); }
+    }
+    history->banks[history->banks_count++] = (HistoryBank){step, (WORD_UTYPE)old_bank, (WORD_UTYPE)new_bank};
+    history->bank_cursor = history->banks_count;
+}
+
+// SUBLANQ_run that logs every step, only valid at the head of the history, debug may be NULL
+// steps run in chunks that end at the next checkpoint or the end of the log ring so the inner loop only counts down
+// gcc turns the jump into a cmov once the log store is shared by both paths, that chains every step on the
+// one before it and doubles the cost of recording, so if-conversion is turned off for this function
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-if-conversion", "no-if-conversion2")))
+#endif
+static inline SUBLANQ_Stop history_record(History* history, SUBLANQ_VM* vm, uint64_t max_steps, SUBLANQ_Debug* debug) {
+    WORD_STYPE* program = vm->memory;
+    WORD_UTYPE program_size = vm->size;
+    WORD_UTYPE pc = vm->pc;
+    uint64_t step = vm->steps;
+    uint64_t left = max_steps;
+    SUBLANQ_Stop stop = SUBLANQ_STOP_BUDGET;
+    vm->yield = false;
+    while (left) {
+        if (step == history->next_checkpoint_step) history_checkpoint(history, vm, pc, step);
+        uint64_t slot = step % history->log_capacity;
+        uint64_t chunk = left;
+        if (chunk > history->next_checkpoint_step - step) chunk = history->next_checkpoint_step - step;
+        if (chunk > history->log_capacity - slot) chunk = history->log_capacity - slot;
+        HistoryEntry* entry = &history->log[slot];
+        HistoryEntry* entry_end = entry + chunk;
+        bool stopped = true;
+        while (true) {
+            if (entry == entry_end) { stopped = false; break; }
+            if (pc + 2 >= program_size) { stop = SUBLANQ_STOP_END; break; }
+            if (debug && (left != max_steps || entry != &history->log[slot]) && SUBLANQ_BIT_TEST(debug->breakpoints, pc)) { stop = SUBLANQ_STOP_BREAK; break; }
+            WORD_UTYPE a = program[pc];
+            WORD_UTYPE b = program[pc + 1];
+            WORD_UTYPE c = program[pc + 2];
+            if (a == WORD_MAX) {
+                SUBLANQ_InputPort* port = &vm->inputs[c < SUBLANQ_PORT_COUNT ? c : SUBLANQ_PORT_COUNT];
+                WORD_UTYPE old_value = (WORD_UTYPE)program[b];
+                program[b] = port->fn(vm, port->user, c);
+                *entry++ = (HistoryEntry){pc, b, old_value, (WORD_UTYPE)program[b]};
+                pc += 3;
+                if (debug && SUBLANQ_BIT_TEST(debug->watch_write, b)) { debug->watch_address = b; debug->watch_kind = SUBLANQ_WATCH_WRITE; stop = SUBLANQ_STOP_WATCH; break; }
+                if (vm->yield) { stop = SUBLANQ_STOP_YIELD; break; }
+                continue;
+            }
+            else if (b == WORD_MAX) {
+                SUBLANQ_OutputPort* port = &vm->outputs[c < SUBLANQ_PORT_COUNT ? c : SUBLANQ_PORT_COUNT];
+                size_t bank = vm->bank;
+                *entry++ = (HistoryEntry){pc, pc, (WORD_UTYPE)program[pc], (WORD_UTYPE)program[pc]};
+                port->fn(vm, port->user, c, program[a]);
+                if (vm->bank != bank) history_bank_switched(history, step + (uint64_t)(entry - &history->log[slot]) - 1, bank, vm->bank);
+                pc += 3;
+                if (debug && SUBLANQ_BIT_TEST(debug->watch_read, a)) { debug->watch_address = a; debug->watch_kind = SUBLANQ_WATCH_READ; stop = SUBLANQ_STOP_WATCH; break; }
+                if (vm->yield) { stop = SUBLANQ_STOP_YIELD; break; }
+                continue;
+            }
+            else if (c == WORD_MAX) {
+                // a halt is logged as a step like SUBLANQ_run counts it, but the pc stays on it
+                *entry++ = (HistoryEntry){pc, pc, (WORD_UTYPE)program[pc], (WORD_UTYPE)program[pc]};
+                stop = SUBLANQ_STOP_HALT;
+                break;
+            }
+            // the log is WORD_UTYPE like memory so it may alias it, the new value is kept in a local
+            WORD_STYPE old_value = program[b];
+            WORD_STYPE new_value = (WORD_STYPE)(old_value - program[a]);
+            program[b] = new_value;
+            *entry++ = (HistoryEntry){pc, b, (WORD_UTYPE)old_value, (WORD_UTYPE)new_value};
+            if (debug) {
+                pc = new_value <= 0 ? c : (WORD_UTYPE)(pc + 3);
+                if (SUBLANQ_BIT_TEST(debug->watch_write, b)) { debug->watch_address = b; debug->watch_kind = SUBLANQ_WATCH_WRITE; stop = SUBLANQ_STOP_WATCH; break; }
+                if (SUBLANQ_BIT_TEST(debug->watch_read, a)) { debug->watch_address = a; debug->watch_kind = SUBLANQ_WATCH_READ; stop = SUBLANQ_STOP_WATCH; break; }
+                if (SUBLANQ_BIT_TEST(debug->watch_read, b)) { debug->watch_address = b; debug->watch_kind = SUBLANQ_WATCH_READ; stop = SUBLANQ_STOP_WATCH; break; }
+                continue;
+            }
+            if (new_value <= 0) {
+                pc = c;
+                continue;
+            }
+            pc += 3;
+        }
+        uint64_t done = (uint64_t)(entry - &history->log[slot]);
+        step += done;
+        left -= done;
+        if (stopped) break;
+    }
+    vm->pc = pc;
+    vm->steps = step;
+    history->head = history->position = step;
+    history->head_pc = pc;
+    return stop;
+}
+
+static inline bool history_at_head(History* history) {
+    return history->position == history->head;
+}
+
+static inline bool history_step_back(History* history, SUBLANQ_VM* vm) {
+    if (history->position <= history->first) return false;
+    --history->position;
+    HistoryEntry* entry = &history->log[history->position % history->log_capacity];
+    vm->memory[entry->address] = (WORD_STYPE)entry->old_value;
+    if (history->bank_cursor && history->banks[history->bank_cursor - 1].step == history->position) {
+        SUBLANQ_select_bank(vm, history->banks[--history->bank_cursor].old_bank);
+    }
+    vm->pc = entry->pc;
+    vm->steps = history->position;
+    return true;
+}
+static inline bool history_step_forward(History* history, SUBLANQ_VM* vm) {
+    if (history->position >= history->head) return false;
+    HistoryEntry* entry = &history->log[history->position % history->log_capacity];
+    vm->memory[entry->address] = (WORD_STYPE)entry->new_value;
+    if (history->bank_cursor < history->banks_count && history->banks[history->bank_cursor].step == history->position) {
+        SUBLANQ_select_bank(vm, history->banks[history->bank_cursor++].new_bank);
+    }
+    ++history->position;
+    vm->pc = history->position < history->head ? history->log[history->position % history->log_capacity].pc : history->head_pc;
+    vm->steps = history->position;
+    return true;
+}
+
+// moves to any step in [first, head], from the nearest checkpoint when that is cheaper than stepping
+static inline bool history_seek(History* history, SUBLANQ_VM* vm, uint64_t step) {
+    if (step < history->first || step > history->head) return false;
+    HistoryCheckpoint* best = NULL;
+    for (size_t i = 0; i < history->checkpoint_count; ++i) {
+        HistoryCheckpoint* checkpoint = &history->checkpoints[i];
+        if (!checkpoint->valid || checkpoint->step > step || checkpoint->step < history->first) continue;
+        if (!best || checkpoint->step > best->step) best = checkpoint;
+    }
+    uint64_t distance = step > history->position ? step - history->position : history->position - step;
+    bool banked = vm->bank_file || vm->bank_store;
+    if (best && !banked && step - best->step < distance) {
+        memcpy(vm->memory, best->memory, SUBLANQ_MEMORY_WORDS * sizeof(WORD_STYPE));
+        history->position = best->step;
+        vm->pc = best->pc;
+        vm->steps = best->step;
+    }
+    while (history->position > step) history_step_back(history, vm);
+    while (history->position < step) history_step_forward(history, vm);
+    return true;
+}
+
+// forgets everything after position, used before the debugger changes memory or pc so the log stays consistent
+static inline void history_truncate(History* history, SUBLANQ_VM* vm) {
+    for (size_t i = 0; i < history->checkpoint_count; ++i) {
+        if (history->checkpoints[i].valid && history->checkpoints[i].step >= history->position) history->checkpoints[i].valid = false;
+    }
+    history->head = history->position;
+    history->head_pc = vm->pc;
+    history->banks_count = history->bank_cursor;
+    history->next_checkpoint_step = history->position;
+    if (history->first > history->position) history->first = history->position;
+}
+
+// finds the newest step before position that wrote address, no-op entries of output and halt steps are skipped
+static inline bool history_last_write(History* history, WORD_UTYPE address, uint64_t* step, WORD_UTYPE* pc) {
+    for (uint64_t s = history->position; s > history->first; --s) {
+        HistoryEntry* entry = &history->log[(s - 1) % history->log_capacity];
+        if (entry->address != address) continue;
+        if (entry->address == entry->pc && entry->old_value == entry->new_value) continue;
+        *step = s - 1;
+        *pc = entry->pc;
+        return true;
+    }
+    return false;
+}
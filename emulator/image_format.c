@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// program image format (.sq), written by asm and sqld, loaded by emulate
+// - a header says the version, word size, entry point and memory size of the program, a section table says what is
+//   where: data, read only data (the constants and address words asm adds), code and zero filled words (bss)
+// - only data, read only data and code sections store their words, bss is a range, words no section covers are zero too,
+//   so a large allocation costs nothing on disk and the loader only writes the words that are not zero
+// - an optional symbols section names addresses (variables and labels), it is not loaded into memory
+// - layout, numbers are little endian:
+//   "SQIMG" u8 version u8 word_size u8 0 u16 entry u32 size u16 sections_count
+//   sections_count * (u8 kind u8 0 u16 start u16 count u32 offset), the words of a section are count * u16 at offset
+//   a symbols section has count entries of (u8 kind u8 0 u16 address u16 name_length, name) at offset
+// - a file without the magic is a raw dump of the memory, what asm wrote before
+
+#define IMAGE_MAGIC "SQIMG"
+#define IMAGE_MAGIC_SIZE 5
+#define IMAGE_VERSION 1
+#define IMAGE_HEADER_SIZE 16
+#define IMAGE_SECTION_SIZE 10
+#define IMAGE_SECTIONS_MAX 256
+// a run of at least this many zero words in the data is stored as bss
+#define IMAGE_BSS_MIN 16
+
+typedef enum {
+    IMAGE_DATA = 1,
+    IMAGE_RODATA, // never written by the program
+    IMAGE_CODE,
+    IMAGE_BSS, // zero, not stored
+    IMAGE_SYMBOLS, // not memory, count is the number of symbols
+    IMAGE__KIND_END,
+} ImageKind;
+
+typedef struct {
+    uint8_t kind;
+    WORD_UTYPE start, count;
+    uint32_t offset;
+} ImageSection;
+
+typedef struct {
+    uint8_t kind; // IMAGE_DATA or IMAGE_CODE
+    WORD_UTYPE address;
+    const char* name;
+} ImageSymbol;
+
+typedef struct {
+    uint8_t version, word_size;
+    WORD_UTYPE entry;
+    uint32_t size;
+    ImageSection sections[IMAGE_SECTIONS_MAX];
+    size_t sections_count;
+    const uint8_t* bytes; // the file the sections point into
+    size_t length;
+} Image;
+
+static inline uint16_t image_u16(const uint8_t* bytes) {
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+static inline uint32_t image_u32(const uint8_t* bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+static inline void image_put_u16(uint8_t* bytes, size_t value) {
+    bytes[0] = (uint8_t)(value & 0xFF);
+    bytes[1] = (uint8_t)((value >> 8) & 0xFF);
+}
+static inline void image_put_u32(uint8_t* bytes, size_t value) {
+    image_put_u16(bytes, value & 0xFFFF);
+    image_put_u16(bytes + 2, (value >> 16) & 0xFFFF);
+}
+
+static inline bool image_is_container(const uint8_t* bytes, size_t length) {
+    return length >= IMAGE_MAGIC_SIZE && memcmp(bytes, IMAGE_MAGIC, IMAGE_MAGIC_SIZE) == 0;
+}
+
+// false if the bytes are not a valid image, the sections point into bytes
+static inline bool image_parse(Image* image, const uint8_t* bytes, size_t length) {
+    memset(image, 0, sizeof(*image));
+    if (length < IMAGE_HEADER_SIZE || !image_is_container(bytes, length)) return false;
+    image->version = bytes[5];
+    image->word_size = bytes[6];
+    image->entry = image_u16(bytes + 8);
+    image->size = image_u32(bytes + 10);
+    image->sections_count = image_u16(bytes + 14);
+    image->bytes = bytes;
+    image->length = length;
+    if (image->version != IMAGE_VERSION || image->word_size != WORD_SIZE || image->size > WORD_MAX || image->entry > image->size) return false;
+    if (image->sections_count > IMAGE_SECTIONS_MAX || length < IMAGE_HEADER_SIZE + image->sections_count * IMAGE_SECTION_SIZE) return false;
+    size_t memory_end = 0;
+    for (size_t i = 0; i < image->sections_count; ++i) {
+        const uint8_t* entry = bytes + IMAGE_HEADER_SIZE + i * IMAGE_SECTION_SIZE;
+        ImageSection* section = &image->sections[i];
+        *section = (ImageSection){entry[0], image_u16(entry + 2), image_u16(entry + 4), image_u32(entry + 6)};
+        if (section->kind == 0 || section->kind >= IMAGE__KIND_END) return false;
+        if (section->kind == IMAGE_SYMBOLS) {
+            // every entry is at least 6 bytes, the names are checked when they are read
+            if (section->offset > length || (length - section->offset) / 6 < section->count) return false;
+            continue;
+        }
+        // memory sections are in address order and do not overlap
+        if (section->start < memory_end || (size_t)section->start + section->count > image->size) return false;
+        memory_end = (size_t)section->start + section->count;
+        if (section->kind == IMAGE_BSS) continue;
+        if (section->offset % 2 || section->offset > length || (length - section->offset) / 2 < section->count) return false;
+    }
+    return true;
+}
+
+// the i-th word of a section that stores its words
+static inline WORD_UTYPE image_word(const Image* image, const ImageSection* section, size_t i) {
+    return image_u16(image->bytes + section->offset + 2 * i);
+}
+
+// walks the symbols of a section, false at the end or at a broken entry
+static inline bool image_symbol(const Image* image, const ImageSection* section, size_t* cursor, ImageSymbol* symbol, char* name, size_t name_capacity) {
+    size_t at = section->offset + *cursor;
+    if (at + 6 > image->length) return false;
+    size_t name_length = image_u16(image->bytes + at + 4);
+    if (at + 6 + name_length > image->length || name_length + 1 > name_capacity) return false;
+    memcpy(name, image->bytes + at + 6, name_length);
+    name[name_length] = '\0';
+    *symbol = (ImageSymbol){image->bytes[at], image_u16(image->bytes + at + 2), name};
+    *cursor += 6 + name_length;
+    return true;
+}
+
+// the memory of a program goes out as data, rodata from rodata_start, code from code_start to size, zero runs of the
+// data become bss. symbols can be NULL
+static inline bool image_write(const char* path, const WORD_UTYPE* memory, size_t size, size_t rodata_start, size_t code_start,
+                               const ImageSymbol* symbols, size_t symbols_count) {
+    ImageSection sections[IMAGE_SECTIONS_MAX];
+    size_t sections_count = 0, offset = 0;
+    // offsets are relative to the end of the section table until it is known
+    for (size_t start = 0; start < rodata_start;) {
+        // the data goes up to the next run of IMAGE_BSS_MIN zeros, the rest is data once the table is almost full
+        size_t end = start;
+        while (end < rodata_start) {
+            if (memory[end] != 0) { ++end; continue; }
+            size_t run = end;
+            while (run < rodata_start && memory[run] == 0) ++run;
+            if (run - end >= IMAGE_BSS_MIN && sections_count + 5 < IMAGE_SECTIONS_MAX) break;
+            end = run;
+        }
+        if (end > start) {
+            sections[sections_count++] = (ImageSection){IMAGE_DATA, (WORD_UTYPE)start, (WORD_UTYPE)(end - start), (uint32_t)offset};
+            offset += 2 * (end - start);
+        }
+        start = end;
+        while (end < rodata_start && memory[end] == 0) ++end;
+        if (end > start) sections[sections_count++] = (ImageSection){IMAGE_BSS, (WORD_UTYPE)start, (WORD_UTYPE)(end - start), 0};
+        start = end;
+    }
+    if (code_start > rodata_start) {
+        sections[sections_count++] = (ImageSection){IMAGE_RODATA, (WORD_UTYPE)rodata_start, (WORD_UTYPE)(code_start - rodata_start), (uint32_t)offset};
+        offset += 2 * (code_start - rodata_start);
+    }
+    sections[sections_count++] = (ImageSection){IMAGE_CODE, (WORD_UTYPE)code_start, (WORD_UTYPE)(size - code_start), (uint32_t)offset};
+    offset += 2 * (size - code_start);
+    if (symbols) sections[sections_count++] = (ImageSection){IMAGE_SYMBOLS, 0, (WORD_UTYPE)symbols_count, (uint32_t)offset};
+
+    size_t table_end = IMAGE_HEADER_SIZE + sections_count * IMAGE_SECTION_SIZE;
+    size_t length = table_end + offset;
+    for (size_t i = 0; symbols && i < symbols_count; ++i) length += 6 + strlen(symbols[i].name);
+    uint8_t* bytes = calloc(length + 1, 1);
+    if (!bytes) return false;
+    memcpy(bytes, IMAGE_MAGIC, IMAGE_MAGIC_SIZE);
+    bytes[5] = IMAGE_VERSION;
+    bytes[6] = WORD_SIZE;
+    image_put_u16(bytes + 8, memory[2]);
+    image_put_u32(bytes + 10, size);
+    image_put_u16(bytes + 14, sections_count);
+    for (size_t i = 0; i < sections_count; ++i) {
+        ImageSection* section = &sections[i];
+        uint8_t* entry = bytes + IMAGE_HEADER_SIZE + i * IMAGE_SECTION_SIZE;
+        if (section->kind != IMAGE_BSS) section->offset += (uint32_t)table_end;
+        entry[0] = section->kind;
+        image_put_u16(entry + 2, section->start);
+        image_put_u16(entry + 4, section->count);
+        image_put_u32(entry + 6, section->offset);
+        if (section->kind == IMAGE_BSS || section->kind == IMAGE_SYMBOLS) continue;
+        for (size_t w = 0; w < section->count; ++w) image_put_u16(bytes + section->offset + 2 * w, memory[section->start + w]);
+    }
+    uint8_t* at = bytes + table_end + offset;
+    for (size_t i = 0; symbols && i < symbols_count; ++i) {
+        size_t name_length = strlen(symbols[i].name);
+        at[0] = symbols[i].kind;
+        image_put_u16(at + 2, symbols[i].address);
+        image_put_u16(at + 4, name_length);
+        memcpy(at + 6, symbols[i].name, name_length);
+        at += 6 + name_length;
+    }
+    FILE* file = fopen(path, "wb");
+    bool ok = file && fwrite(bytes, 1, length, file) == length;
+    if (file && fclose(file) != 0) ok = false;
+    free(bytes);
+    return ok;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// execution profile (--profile <file>)
+// - profile_run is SUBLANQ_run that also counts how many times the instruction at every address was executed
+// - profile_write writes one "<address> <count>" line per executed address, asm --profile reads it back
+//   together with the address map of the build that ran (asm --map)
+
+static inline SUBLANQ_Stop profile_run(uint64_t* counts, SUBLANQ_VM* vm, uint64_t max_steps) {
+    WORD_STYPE* program = vm->memory;
+    WORD_UTYPE program_size = vm->size;
+    WORD_UTYPE pc = vm->pc;
+    uint64_t left = max_steps;
+    SUBLANQ_Stop stop = SUBLANQ_STOP_BUDGET;
+    vm->yield = false;
+    while (left) {
+        if (pc + 2 >= program_size) { stop = SUBLANQ_STOP_END; break; }
+        WORD_UTYPE a = program[pc];
+        WORD_UTYPE b = program[pc + 1];
+        WORD_UTYPE c = program[pc + 2];
+        --left;
+        ++counts[pc];
+        if (a == WORD_MAX) {
+            SUBLANQ_InputPort* port = &vm->inputs[c < SUBLANQ_PORT_COUNT ? c : SUBLANQ_PORT_COUNT];
+            program[b] = port->fn(vm, port->user, c);
+            if (vm->yield) { pc += 3; stop = SUBLANQ_STOP_YIELD; break; }
+        }
+        else if (b == WORD_MAX) {
+            SUBLANQ_OutputPort* port = &vm->outputs[c < SUBLANQ_PORT_COUNT ? c : SUBLANQ_PORT_COUNT];
+            port->fn(vm, port->user, c, program[a]);
+            if (vm->yield) { pc += 3; stop = SUBLANQ_STOP_YIELD; break; }
+        }
+        else if (c == WORD_MAX) { stop = SUBLANQ_STOP_HALT; break; }
+        else {
+            program[b] -= program[a];
+            if (program[b] <= 0) {
+                pc = c;
+                continue;
+            }
+        }
+        pc += 3;
+    }
+    vm->pc = pc;
+    vm->steps += max_steps - left;
+    return stop;
+}
+
+static inline bool profile_write(const uint64_t* counts, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) { perror("fopen"); return false; }
+    bool ok = true;
+    for (size_t address = 0; address < SUBLANQ_MEMORY_WORDS && ok; ++address) {
+        if (counts[address]) ok = fprintf(file, "%zu %llu\n", address, (unsigned long long)counts[address]) > 0;
+    }
+    if (fclose(file) != 0) ok = false;
+    return ok;
+}
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define SCREEN_WIDTH 256
+#define SCREEN_HEIGHT 256
+#include "picofb.h"
+
+typedef struct {
+    PICOFB_Window window;
+    uint8_t mode;
+    WORD_UTYPE x, y;
+    uint8_t r, g, b;
+} ScreenIo;
+
+static inline bool screen_init(SUBLANQ_VM* vm, void* user) {
+    (void)vm;
+    ScreenIo* io = user;
+    return PICOFB_init("SUBLANQ", SCREEN_WIDTH, SCREEN_HEIGHT, &io->window);
+}
+static inline void screen_cleanup(void* user) {
+    ScreenIo* io = user;
+    PICOFB_cleanup(&io->window);
+}
+
+static inline WORD_UTYPE screen_flip(SUBLANQ_VM* vm, void* user, WORD_UTYPE port) {
+    (void)vm; (void)port;
+    ScreenIo* io = user;
+    PICOFB_update(&io->window);
+    return 0;
+}
+static inline WORD_UTYPE screen_quit(SUBLANQ_VM* vm, void* user, WORD_UTYPE port) {
+    (void)vm; (void)port;
+    ScreenIo* io = user;
+    if (io->window.quit) return (WORD_UTYPE)27; 
+    return (WORD_UTYPE)0;
+}
+static inline void screen_pixel(SUBLANQ_VM* vm, void* user, WORD_UTYPE port, WORD_UTYPE data) {
+    (void)vm; (void)port;
+    ScreenIo* io = user;
+    switch (io->mode) {
+    case 0:
+        io->x = data;
+        io->mode = 1;
+    break;
+    case 1:
+        io->y = data;
+        io->mode = 2;
+    break;
+    case 2:
+        io->r = (uint8_t)data;
+        io->mode = 3;
+    break;
+    case 3:
+        io->g = (uint8_t)data;
+        io->mode = 4;
+    break;
+    case 4:
+        io->b = (uint8_t)data;
+        PICOFB_set_pixel(&io->window, io->x, io->y, PICOFB_color_argb(0xFF, io->r, io->g, io->b));
+        io->mode = 0;
+    break;
+    default: break;
+    }
+}
+
+static inline WORD_UTYPE random_byte(SUBLANQ_VM* vm, void* user, WORD_UTYPE port) {
+    (void)user; (void)port;
+    return (WORD_UTYPE)(uint8_t)SUBLANQ_random(vm);
+}
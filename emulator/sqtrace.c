@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WORD_SIZE 16
+#define WORD_STYPE int16_t
+#define WORD_UTYPE uint16_t
+#define WORD_MAX UINT16_MAX
+
+#include "sublanq.h"
+#include "trace_format.c"
+
+// reader for the traces written by emulate --trace
+// prints one line per step, or with --stats a summary with the instruction mix and the hottest instructions
+
+#define SQTRACE_HOT_COUNT 16
+
+static inline void usage(const char* program_name) {
+    fprintf(stderr, "Usage: %s [--stats] [--skip <steps>] [--count <steps>] <trace>\n", program_name);
+}
+
+int main(int argc, char **argv) {
+    const char* trace_path = NULL;
+    bool stats = false;
+    unsigned long long skip = 0, count = UINT64_MAX;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--stats") == 0) stats = true;
+        else if (strcmp(argv[i], "--skip") == 0 && i + 1 < argc) skip = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) count = strtoull(argv[++i], NULL, 10);
+        else if (argv[i][0] != '-' && !trace_path) trace_path = argv[i];
+        else { usage(argv[0]); return 1; }
+    }
+    if (!trace_path) { usage(argv[0]); return 1; }
+
+    FILE* f = fopen(trace_path, "rb");
+    if (!f) { perror("fopen"); return 1; }
+    TraceDecoder* decoder = malloc(sizeof(TraceDecoder));
+    uint64_t* hits = calloc(SUBLANQ_MEMORY_WORDS, sizeof(uint64_t));
+    if (!decoder || !hits) { perror("malloc"); fclose(f); free(decoder); free(hits); return 1; }
+    if (!trace_decoder_open(decoder, f)) { fprintf(stderr, "Not a trace file\n"); fclose(f); free(decoder); free(hits); return 1; }
+
+    uint64_t first_step = decoder->model.step;
+    uint64_t steps = 0, subtracts = 0, taken = 0, inputs = 0, outputs = 0, halts = 0;
+    TraceRecord record;
+    // count defaults to UINT64_MAX, so skip + count would wrap
+    while (steps < skip || steps - skip < count) {
+        uint64_t step = decoder->model.step;
+        if (!trace_decode(decoder, &record)) break;
+        ++steps;
+        if (steps <= skip) continue;
+        // the model already holds memory after the step, c was only overwritten if the step wrote it
+        WORD_UTYPE c = record.b == (WORD_UTYPE)(record.pc + 2) ? record.old_value : decoder->model.memory[(WORD_UTYPE)(record.pc + 2)];
+        if (stats) {
+            ++hits[record.pc];
+            if (record.a == WORD_MAX) ++inputs;
+            else if (record.b == WORD_MAX) ++outputs;
+            else if (c == WORD_MAX) ++halts;
+            else { ++subtracts; taken += record.taken; }
+            continue;
+        }
+        if (record.a == WORD_MAX) printf("%llu %u: in %u -> [%u] %d\n", (unsigned long long)step, record.pc, c, record.b, (WORD_STYPE)record.new_value);
+        else if (record.b == WORD_MAX) printf("%llu %u: out [%u] %d -> %u%s\n", (unsigned long long)step, record.pc, record.a, (WORD_STYPE)record.old_value, c, record.taken ? ", bank switched" : "");
+        else if (c == WORD_MAX) printf("%llu %u: halt\n", (unsigned long long)step, record.pc);
+        else printf("%llu %u: [%u] -= [%u], %d -> %d%s\n", (unsigned long long)step, record.pc, record.b, record.a,
+                    (WORD_STYPE)record.old_value, (WORD_STYPE)record.new_value, record.taken ? " jump" : "");
+    }
+    fclose(f);
+
+    if (stats) {
+        uint64_t counted = steps > skip ? steps - skip : 0;
+        printf("steps %llu to %llu (%llu)\n", (unsigned long long)(first_step + steps - counted), (unsigned long long)(first_step + steps), (unsigned long long)counted);
+        printf("subtract %llu (%llu jumped), input %llu, output %llu, halt %llu\n", (unsigned long long)subtracts, (unsigned long long)taken,
+               (unsigned long long)inputs, (unsigned long long)outputs, (unsigned long long)halts);
+        printf("hottest instructions:\n");
+        for (int i = 0; i < SQTRACE_HOT_COUNT; ++i) {
+            size_t best = 0;
+            for (size_t pc = 1; pc < SUBLANQ_MEMORY_WORDS; ++pc) if (hits[pc] > hits[best]) best = pc;
+            if (!hits[best]) break;
+            printf("  %5zu %12llu %6.2f%%\n", best, (unsigned long long)hits[best], 100.0 * (double)hits[best] / (double)counted);
+            hits[best] = 0;
+        }
+    }
+    trace_model_free(&decoder->model);
+    free(decoder);
+    free(hits);
+    return 0;
+}
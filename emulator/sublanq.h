@@ -0,0 +1,339 @@
+// A minimal single-header re-entrant Subleq virtual machine
+//================================================================
+// DOCS
+//================================================================
+// Guidelines
+// - Allocate a zero initialized SUBLANQ_VM per program, load an image into it and pass it to the API
+// - All state lives in the SUBLANQ_VM (memory, pc, devices, PRNG), nothing is global, so any number of VMs can run on any number of threads
+//   as long as a single VM is only run by one thread at a time
+// - Memory is always the full address space, every word index a program can form is in bounds, so a program can not touch host memory
+// - Devices are bound per port, the handler of every port is resolved when it is bound so an I/O instruction is a single table lookup
+//   and call with no switch, ports that were never bound (and ports >= SUBLANQ_PORT_COUNT) read 0 and ignore writes
+// - Handlers get the VM and the user pointer they were bound with so a device can keep its own state
+// - SUBLANQ_run runs at most max_steps instructions and returns why it stopped, calling it again resumes where it left off
+// - A device callback can call SUBLANQ_yield to make SUBLANQ_run return after the current instruction (e.g. on a blocking read or a frame flip)
+// - Banked memory: the window [SUBLANQ_BANK_BASE, SUBLANQ_MEMORY_WORDS) shows one of SUBLANQ_BANK_COUNT banks, bank 0 at first.
+//   Where the OS allows it the banks are pages of a temporary file and selecting one maps it over the window, so the switch
+//   does not copy and memory stays one flat array for the interpreter, elsewhere the window is copied out and in
+//
+// API:
+// - bool SUBLANQ_load(SUBLANQ_VM* vm, const WORD_UTYPE* image, size_t word_count) - allocate memory and copy an image into it, resets pc and PRNG
+//                                                                               (image NULL: word_count zero words the host fills in)
+// - void SUBLANQ_bind_input(SUBLANQ_VM* vm, WORD_UTYPE port, SUBLANQ_InputFn fn, void* user)   - bind an input handler to a port
+// - void SUBLANQ_bind_output(SUBLANQ_VM* vm, WORD_UTYPE port, SUBLANQ_OutputFn fn, void* user) - bind an output handler to a port
+// - void SUBLANQ_seed(SUBLANQ_VM* vm, uint64_t seed)                            - seed the per VM PRNG
+// - uint32_t SUBLANQ_random(SUBLANQ_VM* vm)                                     - next number from the per VM PRNG
+// - SUBLANQ_Stop SUBLANQ_run(SUBLANQ_VM* vm, uint64_t max_steps)                - run for at most max_steps instructions
+// - void SUBLANQ_yield(SUBLANQ_VM* vm)                                          - stop SUBLANQ_run after the current instruction
+// - bool SUBLANQ_select_bank(SUBLANQ_VM* vm, size_t bank)                       - show another bank in the window
+// - SUBLANQ_Stop SUBLANQ_run_debug(SUBLANQ_VM* vm, uint64_t max_steps, SUBLANQ_Debug* debug) - SUBLANQ_run that also stops on breakpoints and watchpoints
+// - void SUBLANQ_cleanup(SUBLANQ_VM* vm)                                        - free the memory of the VM
+//
+// User visible fields of SUBLANQ_VM:
+//    WORD_STYPE* memory;   (always SUBLANQ_MEMORY_WORDS long)
+//    WORD_UTYPE size;      (program size, execution stops when pc + 2 reaches it)
+//    WORD_UTYPE pc;
+//    uint64_t steps;       (instructions executed over the lifetime of the VM)
+//    size_t bank;          (the bank in the window)
+//
+
+#ifndef SUBLANQ_H_
+#define SUBLANQ_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#if defined(__unix__) || defined(__APPLE__)
+#define SUBLANQ_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifndef WORD_SIZE
+#define WORD_SIZE 16
+#define WORD_STYPE int16_t
+#define WORD_UTYPE uint16_t
+#define WORD_MAX UINT16_MAX
+#endif
+
+#define SUBLANQ_MEMORY_WORDS ((size_t)WORD_MAX + 1)
+#ifndef SUBLANQ_PORT_COUNT
+#define SUBLANQ_PORT_COUNT 256
+#endif
+#define SUBLANQ_BANK_BASE 0xC000
+#define SUBLANQ_BANK_WORDS (SUBLANQ_MEMORY_WORDS - SUBLANQ_BANK_BASE)
+#define SUBLANQ_BANK_COUNT 256
+
+typedef enum {
+    SUBLANQ_STOP_HALT,      // reached a {a, b, -1} instruction, pc stays on it
+    SUBLANQ_STOP_END,       // pc ran past the end of the program
+    SUBLANQ_STOP_BUDGET,    // executed max_steps instructions
+    SUBLANQ_STOP_YIELD,     // a device called SUBLANQ_yield
+    SUBLANQ_STOP_BREAK,     // SUBLANQ_run_debug reached a breakpoint, pc is on it and it is not executed yet
+    SUBLANQ_STOP_WATCH,     // SUBLANQ_run_debug executed an instruction that touched a watched word
+} SUBLANQ_Stop;
+
+typedef struct SUBLANQ_VM SUBLANQ_VM;
+
+typedef WORD_UTYPE (*SUBLANQ_InputFn)(SUBLANQ_VM* vm, void* user, WORD_UTYPE port);
+typedef void (*SUBLANQ_OutputFn)(SUBLANQ_VM* vm, void* user, WORD_UTYPE port, WORD_UTYPE data);
+
+typedef struct {
+    SUBLANQ_InputFn fn;
+    void* user;
+} SUBLANQ_InputPort;
+typedef struct {
+    SUBLANQ_OutputFn fn;
+    void* user;
+} SUBLANQ_OutputPort;
+
+struct SUBLANQ_VM {
+    WORD_STYPE* memory;
+    WORD_UTYPE size;
+    WORD_UTYPE pc;
+    uint64_t steps;
+    // the extra last entry is the null device every out of range port resolves to
+    SUBLANQ_InputPort inputs[SUBLANQ_PORT_COUNT + 1];
+    SUBLANQ_OutputPort outputs[SUBLANQ_PORT_COUNT + 1];
+    uint64_t rng;
+    bool yield;
+    size_t bank;
+    // the banks once one was selected, the file they are mapped from or the copies of the ones not in the window
+    FILE* bank_file;
+    WORD_STYPE* bank_store;
+};
+
+// breakpoint and watchpoint bitmaps have one bit per word, SUBLANQ_BITMAP_WORDS uint64_t long
+#define SUBLANQ_BITMAP_WORDS (SUBLANQ_MEMORY_WORDS / 64)
+#define SUBLANQ_BIT_TEST(bitmap, index) (((bitmap)[(index) >> 6] >> ((index) & 63)) & 1)
+#define SUBLANQ_BIT_SET(bitmap, index) ((bitmap)[(index) >> 6] |= (uint64_t)1 << ((index) & 63))
+#define SUBLANQ_BIT_CLEAR(bitmap, index) ((bitmap)[(index) >> 6] &= ~((uint64_t)1 << ((index) & 63)))
+
+typedef enum {
+    SUBLANQ_WATCH_WRITE,
+    SUBLANQ_WATCH_READ,
+} SUBLANQ_WatchKind;
+
+typedef struct {
+    uint64_t breakpoints[SUBLANQ_BITMAP_WORDS];
+    uint64_t watch_write[SUBLANQ_BITMAP_WORDS];
+    uint64_t watch_read[SUBLANQ_BITMAP_WORDS];
+    // filled in on SUBLANQ_STOP_WATCH
+    WORD_UTYPE watch_address;
+    SUBLANQ_WatchKind watch_kind;
+} SUBLANQ_Debug;
+
+static inline WORD_UTYPE SUBLANQ_null_input(SUBLANQ_VM* vm, void* user, WORD_UTYPE port) {(void)vm; (void)user; (void)port; return 0;}
+static inline void SUBLANQ_null_output(SUBLANQ_VM* vm, void* user, WORD_UTYPE port, WORD_UTYPE data) {(void)vm; (void)user; (void)port; (void)data;}
+
+static inline void SUBLANQ_seed(SUBLANQ_VM* vm, uint64_t seed) {
+    // splitmix64 so that small or similar seeds still give unrelated streams
+    seed += 0x9E3779B97F4A7C15ull;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+    seed ^= seed >> 31;
+    vm->rng = seed ? seed : 1;
+}
+static inline uint32_t SUBLANQ_random(SUBLANQ_VM* vm) {
+    // xorshift64*
+    vm->rng ^= vm->rng >> 12;
+    vm->rng ^= vm->rng << 25;
+    vm->rng ^= vm->rng >> 27;
+    return (uint32_t)((vm->rng * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+// memory is page aligned so the window can be mapped over, and zero, a page is only backed once it is written
+static inline WORD_STYPE* SUBLANQ_memory_alloc(void) {
+    #ifdef SUBLANQ_MMAP
+    void* memory = mmap(NULL, SUBLANQ_MEMORY_WORDS * sizeof(WORD_STYPE), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+    #else
+    return calloc(SUBLANQ_MEMORY_WORDS, sizeof(WORD_STYPE));
+    #endif
+}
+static inline void SUBLANQ_memory_free(WORD_STYPE* memory) {
+    #ifdef SUBLANQ_MMAP
+    if (memory) munmap(memory, SUBLANQ_MEMORY_WORDS * sizeof(WORD_STYPE));
+    #else
+    free(memory);
+    #endif
+}
+// back to a single bank, the window keeps what it shows
+static inline void SUBLANQ_banks_reset(SUBLANQ_VM* vm) {
+    if (vm->bank_file) {
+        fclose(vm->bank_file);
+        vm->bank_file = NULL;
+    }
+    free(vm->bank_store);
+    vm->bank_store = NULL;
+    vm->bank = 0;
+}
+
+static inline bool SUBLANQ_load(SUBLANQ_VM* vm, const WORD_UTYPE* image, size_t word_count) {
+    if (!vm || word_count > WORD_MAX) return false;
+    if (vm->bank_file) {
+        // the window is still mapped from the old bank file
+        SUBLANQ_memory_free(vm->memory);
+        vm->memory = NULL;
+    }
+    SUBLANQ_banks_reset(vm);
+    if (vm->memory) memset(vm->memory, 0, SUBLANQ_MEMORY_WORDS * sizeof(WORD_STYPE));
+    else vm->memory = SUBLANQ_memory_alloc();
+    if (!vm->memory) return false;
+    if (image) memcpy(vm->memory, image, word_count * sizeof(WORD_UTYPE));
+    vm->size = (WORD_UTYPE)word_count;
+    vm->pc = 0;
+    vm->steps = 0;
+    vm->yield = false;
+    for (size_t i = 0; i <= SUBLANQ_PORT_COUNT; ++i) {
+        if (!vm->inputs[i].fn) vm->inputs[i].fn = SUBLANQ_null_input;
+        if (!vm->outputs[i].fn) vm->outputs[i].fn = SUBLANQ_null_output;
+    }
+    SUBLANQ_seed(vm, 0);
+    return true;
+}
+static inline void SUBLANQ_bind_input(SUBLANQ_VM* vm, WORD_UTYPE port, SUBLANQ_InputFn fn, void* user) {
+    if (port >= SUBLANQ_PORT_COUNT) return;
+    vm->inputs[port] = (SUBLANQ_InputPort){.fn = fn ? fn : SUBLANQ_null_input, .user = user};
+}
+static inline void SUBLANQ_bind_output(SUBLANQ_VM* vm, WORD_UTYPE port, SUBLANQ_OutputFn fn, void* user) {
+    if (port >= SUBLANQ_PORT_COUNT) return;
+    vm->outputs[port] = (SUBLANQ_OutputPort){.fn = fn ? fn : SUBLANQ_null_output, .user = user};
+}
+static inline void SUBLANQ_yield(SUBLANQ_VM* vm) {
+    vm->yield = true;
+}
+static inline void SUBLANQ_cleanup(SUBLANQ_VM* vm) {
+    SUBLANQ_memory_free(vm->memory);
+    SUBLANQ_banks_reset(vm);
+    vm->memory = NULL;
+    vm->size = 0;
+}
+
+#ifdef SUBLANQ_MMAP
+// the first switch moves the window into bank 0 of a new sparse file, false if the window can not be mapped here
+static inline bool SUBLANQ_banks_map(SUBLANQ_VM* vm) {
+    size_t bytes = SUBLANQ_BANK_WORDS * sizeof(WORD_STYPE);
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0 || (SUBLANQ_BANK_BASE * sizeof(WORD_STYPE)) % (size_t)page || bytes % (size_t)page) return false;
+    FILE* file = tmpfile();
+    if (!file) return false;
+    int fd = fileno(file);
+    if (ftruncate(fd, (off_t)(SUBLANQ_BANK_COUNT * bytes)) != 0 || pwrite(fd, vm->memory + SUBLANQ_BANK_BASE, bytes, 0) != (ssize_t)bytes
+        || mmap(vm->memory + SUBLANQ_BANK_BASE, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        fclose(file);
+        return false;
+    }
+    vm->bank_file = file;
+    return true;
+}
+#endif
+
+// banks other than 0 start out zero, false if there is no such bank
+static inline bool SUBLANQ_select_bank(SUBLANQ_VM* vm, size_t bank) {
+    if (bank >= SUBLANQ_BANK_COUNT) return false;
+    if (bank == vm->bank) return true;
+    WORD_STYPE* window = vm->memory + SUBLANQ_BANK_BASE;
+    size_t bytes = SUBLANQ_BANK_WORDS * sizeof(WORD_STYPE);
+    #ifdef SUBLANQ_MMAP
+    if (vm->bank_file || (!vm->bank_store && SUBLANQ_banks_map(vm))) {
+        // MAP_FIXED replaces the old mapping in one step, its pages stay in the file
+        if (mmap(window, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fileno(vm->bank_file), (off_t)(bank * bytes)) == MAP_FAILED) return false;
+        vm->bank = bank;
+        return true;
+    }
+    #endif
+    if (!vm->bank_store) vm->bank_store = calloc(SUBLANQ_BANK_COUNT * SUBLANQ_BANK_WORDS, sizeof(WORD_STYPE));
+    if (!vm->bank_store) return false;
+    memcpy(vm->bank_store + vm->bank * SUBLANQ_BANK_WORDS, window, bytes);
+    memcpy(window, vm->bank_store + bank * SUBLANQ_BANK_WORDS, bytes);
+    vm->bank = bank;
+    return true;
+}
+
+static inline SUBLANQ_Stop SUBLANQ_run(SUBLANQ_VM* vm, uint64_t max_steps) {
+    WORD_STYPE* program = vm->memory;
+    WORD_UTYPE program_size = vm->size;
+    WORD_UTYPE pc = vm->pc;
+    uint64_t left = max_steps;
+    SUBLANQ_Stop stop = SUBLANQ_STOP_BUDGET;
+    vm->yield = false;
+    while (left) {
+        if (pc + 2 >= program_size) { stop = SUBLANQ_STOP_END; break; }
+        WORD_UTYPE a = program[pc];
+        WORD_UTYPE b = program[pc + 1];
+        WORD_UTYPE c = program[pc + 2];
+        --left;
+        if (a == WORD_MAX) {
+            SUBLANQ_InputPort* port = &vm->inputs[c < SUBLANQ_PORT_COUNT ? c : SUBLANQ_PORT_COUNT];
+            program[b] = port->fn(vm, port->user, c);
+            if (vm->yield) { pc += 3; stop = SUBLANQ_STOP_YIELD; break; }
+        }
+        else if (b == WORD_MAX) {
+            SUBLANQ_OutputPort* port = &vm->outputs[c < SUBLANQ_PORT_COUNT ? c : SUBLANQ_PORT_COUNT];
+            port->fn(vm, port->user, c, program[a]);
+            if (vm->yield) { pc += 3; stop = SUBLANQ_STOP_YIELD; break; }
+        }
+        else if (c == WORD_MAX) { stop = SUBLANQ_STOP_HALT; break; }
+        else {
+            program[b] -= program[a];
+            if (program[b] <= 0) {
+                pc = c;
+                continue;
+            }
+        }
+        pc += 3;
+    }
+    vm->pc = pc;
+    vm->steps += max_steps - left;
+    return stop;
+}
+
+// same as SUBLANQ_run but checks the bitmaps of debug on every step, so only use it while a breakpoint or watchpoint is set
+// the breakpoint on the pc it starts from is ignored so that a stopped program can be resumed
+static inline SUBLANQ_Stop SUBLANQ_run_debug(SUBLANQ_VM* vm, uint64_t max_steps, SUBLANQ_Debug* debug) {
+    WORD_STYPE* program = vm->memory;
+    WORD_UTYPE program_size = vm->size;
+    WORD_UTYPE pc = vm->pc;
+    uint64_t left = max_steps;
+    SUBLANQ_Stop stop = SUBLANQ_STOP_BUDGET;
+    vm->yield = false;
+    while (left) {
+        if (pc + 2 >= program_size) { stop = SUBLANQ_STOP_END; break; }
+        if (left != max_steps && SUBLANQ_BIT_TEST(debug->breakpoints, pc)) { stop = SUBLANQ_STOP_BREAK; break; }
+        WORD_UTYPE a = program[pc];
+        WORD_UTYPE b = program[pc + 1];
+        WORD_UTYPE c = program[pc + 2];
+        --left;
+        if (a == WORD_MAX) {
+            SUBLANQ_InputPort* port = &vm->inputs[c < SUBLANQ_PORT_COUNT ? c : SUBLANQ_PORT_COUNT];
+            program[b] = port->fn(vm, port->user, c);
+            pc += 3;
+            if (SUBLANQ_BIT_TEST(debug->watch_write, b)) { debug->watch_address = b; debug->watch_kind = SUBLANQ_WATCH_WRITE; stop = SUBLANQ_STOP_WATCH; break; }
+            if (vm->yield) { stop = SUBLANQ_STOP_YIELD; break; }
+            continue;
+        }
+        else if (b == WORD_MAX) {
+            SUBLANQ_OutputPort* port = &vm->outputs[c < SUBLANQ_PORT_COUNT ? c : SUBLANQ_PORT_COUNT];
+            port->fn(vm, port->user, c, program[a]);
+            pc += 3;
+            if (SUBLANQ_BIT_TEST(debug->watch_read, a)) { debug->watch_address = a; debug->watch_kind = SUBLANQ_WATCH_READ; stop = SUBLANQ_STOP_WATCH; break; }
+            if (vm->yield) { stop = SUBLANQ_STOP_YIELD; break; }
+            continue;
+        }
+        else if (c == WORD_MAX) { stop = SUBLANQ_STOP_HALT; break; }
+        program[b] -= program[a];
+        WORD_UTYPE next = program[b] <= 0 ? c : (WORD_UTYPE)(pc + 3);
+        pc = next;
+        if (SUBLANQ_BIT_TEST(debug->watch_write, b)) { debug->watch_address = b; debug->watch_kind = SUBLANQ_WATCH_WRITE; stop = SUBLANQ_STOP_WATCH; break; }
+        if (SUBLANQ_BIT_TEST(debug->watch_read, a)) { debug->watch_address = a; debug->watch_kind = SUBLANQ_WATCH_READ; stop = SUBLANQ_STOP_WATCH; break; }
+        if (SUBLANQ_BIT_TEST(debug->watch_read, b)) { debug->watch_address = b; debug->watch_kind = SUBLANQ_WATCH_READ; stop = SUBLANQ_STOP_WATCH; break; }
+    }
+    vm->pc = pc;
+    vm->steps += max_steps - left;
+    return stop;
+}
+
+#endif // SUBLANQ_H_
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#ifndef _WIN32
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    #ifndef _WIN32
+    struct termios oldt;
+    struct termios newt;
+    #endif
+    unsigned char ch;
+} KeyboardIo;
+
+static inline bool keyboard_init(SUBLANQ_VM* vm, void* user) {
+    (void)vm;
+    KeyboardIo* io = user;
+    #ifndef _WIN32
+    tcgetattr(STDIN_FILENO, &io->oldt);
+    io->newt = io->oldt;
+    io->newt.c_lflag &= ~(ICANON | ECHO);
+    io->newt.c_cc[VMIN] = 0;
+    io->newt.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &io->newt);
+    #else
+    (void)io;
+    #endif
+    return true;
+}
+static inline void keyboard_cleanup(void* user) {
+    KeyboardIo* io = user;
+    #ifndef _WIN32
+    tcsetattr(STDIN_FILENO, TCSANOW, &io->oldt);
+    #else
+    (void)io;
+    #endif
+}
+
+static inline WORD_UTYPE keyboard_key(SUBLANQ_VM* vm, void* user, WORD_UTYPE port) {
+    (void)vm; (void)port;
+    KeyboardIo* io = user;
+    #ifndef _WIN32
+    ssize_t n = read(STDIN_FILENO, &io->ch, 1);
+    if (n <= 0) return 0;
+    return (WORD_UTYPE)io->ch;
+    #else
+    (void)io;
+    return 0;
+    #endif
+}
+
+static inline void console_char(SUBLANQ_VM* vm, void* user, WORD_UTYPE port, WORD_UTYPE data) {
+    (void)vm; (void)user; (void)port;
+    if (data <= 255) {putchar(data); fflush(stdout);} 
+}
+static inline void console_int(SUBLANQ_VM* vm, void* user, WORD_UTYPE port, WORD_UTYPE data) {
+    (void)vm; (void)user; (void)port;
+    printf("\033[93;1m%d\033[0m\n", (WORD_STYPE)data);
+}
+static inline void console_uint(SUBLANQ_VM* vm, void* user, WORD_UTYPE port, WORD_UTYPE data) {
+    (void)vm; (void)user; (void)port;
+    printf("\033[93;1m%d\033[0m\n", data);
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "trace_format.c"
+
+// streaming execution trace (--trace <file>)
+// - trace_run is SUBLANQ_run that also stores a raw TraceRecord per step into the current block of a ring of blocks,
+//   each VM thread has its own Trace so nothing is shared between threads except with the compressor of that Trace
+// - a full block is handed to a background thread that encodes it with trace_encode and writes it out,
+//   the two only synchronize once per block, the VM only waits if the compressor falls a whole ring behind
+
+#define TRACE_BLOCK_RECORDS (1u << 14)
+#define TRACE_BLOCK_COUNT 8
+#define TRACE_OUT_SIZE (TRACE_BLOCK_RECORDS * TRACE_RECORD_MAX_BYTES)
+
+typedef struct {
+    TraceRecord records[TRACE_BLOCK_RECORDS];
+    size_t count;
+} TraceBlock;
+
+typedef struct {
+    FILE* file;
+    TraceBlock* blocks;
+    // blocks [consumed, produced) are full and waiting for the compressor, block produced % count is being filled
+    uint64_t produced;
+    uint64_t consumed;
+    bool closing;
+    bool failed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+    bool started;
+    TraceEncoder* encoder;
+    uint8_t* out;
+} Trace;
+
+static void* trace_compressor(void* arg) {
+    Trace* trace = arg;
+    pthread_mutex_lock(&trace->lock);
+    while (true) {
+        while (trace->consumed == trace->produced && !trace->closing) pthread_cond_wait(&trace->changed, &trace->lock);
+        if (trace->consumed == trace->produced) break;
+        TraceBlock* block = &trace->blocks[trace->consumed % TRACE_BLOCK_COUNT];
+        pthread_mutex_unlock(&trace->lock);
+        uint8_t* out = trace->out;
+        for (size_t i = 0; i < block->count; ++i) out = trace_encode(trace->encoder, &block->records[i], out);
+        bool written = fwrite(trace->out, 1, (size_t)(out - trace->out), trace->file) == (size_t)(out - trace->out);
+        pthread_mutex_lock(&trace->lock);
+        if (!written) trace->failed = true;
+        ++trace->consumed;
+        pthread_cond_broadcast(&trace->changed);
+    }
+    uint8_t* out = trace_flush_run(trace->encoder, trace->out);
+    if (fwrite(trace->out, 1, (size_t)(out - trace->out), trace->file) != (size_t)(out - trace->out)) trace->failed = true;
+    pthread_mutex_unlock(&trace->lock);
+    return NULL;
+}
+
+// the trace starts at the current state of the VM, the header is written before this returns
+static inline bool trace_open(Trace* trace, SUBLANQ_VM* vm, const char* path) {
+    memset(trace, 0, sizeof(*trace));
+    trace->file = fopen(path, "wb");
+    if (!trace->file) { perror("fopen"); return false; }
+    trace->blocks = calloc(TRACE_BLOCK_COUNT, sizeof(TraceBlock));
+    trace->encoder = calloc(1, sizeof(TraceEncoder));
+    trace->out = malloc(TRACE_OUT_SIZE > TRACE_HEADER_SIZE ? TRACE_OUT_SIZE : TRACE_HEADER_SIZE);
+    if (!trace->blocks || !trace->encoder || !trace->out) { fprintf(stderr, "Trace alloc failed\n"); return false; }
+    TraceModel* model = &trace->encoder->model;
+    memcpy(model->memory, vm->memory, SUBLANQ_MEMORY_WORDS * sizeof(WORD_UTYPE));
+    model->pc = vm->pc;
+    model->size = vm->size;
+    model->step = vm->steps;
+    model->bank = (WORD_UTYPE)vm->bank;
+    uint8_t* out = trace_put_header(trace->out, model);
+    if (fwrite(trace->out, 1, (size_t)(out - trace->out), trace->file) != (size_t)(out - trace->out)) { perror("fwrite"); return false; }
+    pthread_mutex_init(&trace->lock, NULL);
+    pthread_cond_init(&trace->changed, NULL);
+    if (pthread_create(&trace->thread, NULL, trace_compressor, trace) != 0) {
+        fprintf(stderr, "Trace thread failed to start\n");
+        pthread_mutex_destroy(&trace->lock);
+        pthread_cond_destroy(&trace->changed);
+        return false;
+    }
+    trace->started = true;
+    return true;
+}
+
+// hands the block being filled to the compressor and waits for a free one
+static inline TraceBlock* trace_submit(Trace* trace, TraceBlock* block) {
+    pthread_mutex_lock(&trace->lock);
+    if (block->count) {
+        ++trace->produced;
+        pthread_cond_broadcast(&trace->changed);
+    }
+    while (trace->produced - trace->consumed == TRACE_BLOCK_COUNT) pthread_cond_wait(&trace->changed, &trace->lock);
+    TraceBlock* next = &trace->blocks[trace->produced % TRACE_BLOCK_COUNT];
+    pthread_mutex_unlock(&trace->lock);
+    next->count = 0;
+    return next;
+}
+
+// SUBLANQ_run that records every step, see trace_format.c for what a record holds
+// like history_record, if-conversion is off on gcc or the jump becomes a cmov that chains the steps together
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-if-conversion", "no-if-conversion2")))
+#endif
+static inline SUBLANQ_Stop trace_run(Trace* trace, SUBLANQ_VM* vm, uint64_t max_steps) {
+    WORD_STYPE* program = vm->memory;
+    WORD_UTYPE program_size = vm->size;
+    WORD_UTYPE pc = vm->pc;
+    uint64_t left = max_steps;
+    SUBLANQ_Stop stop = SUBLANQ_STOP_BUDGET;
+    vm->yield = false;
+    TraceBlock* block = &trace->blocks[trace->produced % TRACE_BLOCK_COUNT];
+    while (left) {
+        if (block->count == TRACE_BLOCK_RECORDS) block = trace_submit(trace, block);
+        uint64_t chunk = TRACE_BLOCK_RECORDS - block->count;
+        if (chunk > left) chunk = left;
+        TraceRecord* record = &block->records[block->count];
+        TraceRecord* record_end = record + chunk;
+        bool stopped = true;
+        while (true) {
+            if (record == record_end) { stopped = false; break; }
+            if (pc + 2 >= program_size) { stop = SUBLANQ_STOP_END; break; }
+            WORD_UTYPE a = program[pc];
+            WORD_UTYPE b = program[pc + 1];
+            WORD_UTYPE c = program[pc + 2];
+            if (a == WORD_MAX) {
+                SUBLANQ_InputPort* port = &vm->inputs[c < SUBLANQ_PORT_COUNT ? c : SUBLANQ_PORT_COUNT];
+                WORD_UTYPE old_value = (WORD_UTYPE)program[b];
+                program[b] = port->fn(vm, port->user, c);
+                *record++ = (TraceRecord){pc, a, b, old_value, (WORD_UTYPE)program[b], false};
+                pc += 3;
+                if (vm->yield) { stop = SUBLANQ_STOP_YIELD; break; }
+                continue;
+            }
+            else if (b == WORD_MAX) {
+                SUBLANQ_OutputPort* port = &vm->outputs[c < SUBLANQ_PORT_COUNT ? c : SUBLANQ_PORT_COUNT];
+                // the value is read before the port may switch the bank a is in
+                WORD_UTYPE value = (WORD_UTYPE)program[a];
+                size_t bank = vm->bank;
+                port->fn(vm, port->user, c, (WORD_STYPE)value);
+                *record++ = (TraceRecord){pc, a, b, value, value, vm->bank != bank};
+                pc += 3;
+                if (vm->yield) { stop = SUBLANQ_STOP_YIELD; break; }
+                continue;
+            }
+            else if (c == WORD_MAX) {
+                *record++ = (TraceRecord){pc, a, b, (WORD_UTYPE)program[b], (WORD_UTYPE)program[b], false};
+                stop = SUBLANQ_STOP_HALT;
+                break;
+            }
+            WORD_STYPE old_value = program[b];
+            WORD_STYPE new_value = (WORD_STYPE)(old_value - program[a]);
+            program[b] = new_value;
+            bool taken = new_value <= 0;
+            *record++ = (TraceRecord){pc, a, b, (WORD_UTYPE)old_value, (WORD_UTYPE)new_value, taken};
+            if (taken) {
+                pc = c;
+                continue;
+            }
+            pc += 3;
+        }
+        uint64_t done = (uint64_t)(record - &block->records[block->count]);
+        block->count += done;
+        left -= done;
+        if (stopped) break;
+    }
+    vm->pc = pc;
+    vm->steps += max_steps - left;
+    return stop;
+}
+
+// submits the last partial block, waits for the compressor to write everything and closes the file
+static inline bool trace_close(Trace* trace) {
+    if (!trace->file) return true;
+    bool ok = true;
+    if (trace->started) {
+        TraceBlock* block = &trace->blocks[trace->produced % TRACE_BLOCK_COUNT];
+        pthread_mutex_lock(&trace->lock);
+        if (block->count) ++trace->produced;
+        trace->closing = true;
+        pthread_cond_broadcast(&trace->changed);
+        pthread_mutex_unlock(&trace->lock);
+        pthread_join(trace->thread, NULL);
+        pthread_mutex_destroy(&trace->lock);
+        pthread_cond_destroy(&trace->changed);
+        ok = !trace->failed;
+    }
+    if (fclose(trace->file) != 0) ok = false;
+    free(trace->blocks);
+    if (trace->encoder) trace_model_free(&trace->encoder->model);
+    free(trace->encoder);
+    free(trace->out);
+    memset(trace, 0, sizeof(*trace));
+    return ok;
+}
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// execution trace file format, shared by the emulator (--trace) and the sqtrace reader
+// - a record is one executed instruction: pc, a, b, the value of b before and after it and whether it jumped
+//   input steps have a = WORD_MAX and new = the value read, output steps have old = new = the value written out and
+//   taken if it switched the memory bank, halt steps write nothing so old = new = memory[b]
+// - the header holds the pc, step, program size, selected bank and the full memory when tracing started
+// - both sides run a model of the VM on the records (a shadow memory and the predicted next pc) and every field is
+//   stored as the difference to what the model predicts, so a step only costs bytes where the model was wrong
+//   (mostly input values), fully predicted steps collapse into runs. the model keeps the banks that are not in the
+//   window and switches them on the records of bank switches, the banks other than the selected one start out zero
+// - stream: 0x00 <varint n> is n fully predicted records, any other byte is a mask of the mispredicted fields
+//   followed by one zigzag varint delta per set field (TRACE_MISS_TAKEN has none, it flips the prediction)
+
+#define TRACE_MAGIC "SQTRACE2"
+#define TRACE_MAGIC_SIZE 8
+#define TRACE_HEADER_SIZE (TRACE_MAGIC_SIZE + 2 + 8 + 2 + 2 + SUBLANQ_MEMORY_WORDS * 2)
+
+typedef struct {
+    WORD_UTYPE pc, a, b, old_value, new_value;
+    bool taken;
+} TraceRecord;
+
+typedef enum {
+    TRACE_MISS_PC = 1 << 0,
+    TRACE_MISS_A = 1 << 1,
+    TRACE_MISS_B = 1 << 2,
+    TRACE_MISS_OLD = 1 << 3,
+    TRACE_MISS_NEW = 1 << 4,
+    TRACE_MISS_TAKEN = 1 << 5,
+} TraceMiss;
+
+typedef struct {
+    WORD_UTYPE memory[SUBLANQ_MEMORY_WORDS];
+    WORD_UTYPE pc;
+    WORD_UTYPE size;
+    uint64_t step;
+    WORD_UTYPE bank;
+    WORD_UTYPE* banks; // every bank, the one in the window as it was when it was switched out, NULL before a switch
+} TraceModel;
+
+static inline void trace_model_free(TraceModel* model) {
+    free(model->banks);
+    model->banks = NULL;
+}
+
+static inline void trace_predict(const TraceModel* model, TraceRecord* record) {
+    WORD_UTYPE pc = model->pc;
+    WORD_UTYPE a = model->memory[pc];
+    WORD_UTYPE b = model->memory[(WORD_UTYPE)(pc + 1)];
+    WORD_UTYPE c = model->memory[(WORD_UTYPE)(pc + 2)];
+    WORD_UTYPE old_value = model->memory[b];
+    *record = (TraceRecord){pc, a, b, old_value, old_value, false};
+    if (a != WORD_MAX && b == WORD_MAX) record->old_value = record->new_value = model->memory[a];
+    if (a == WORD_MAX || b == WORD_MAX || c == WORD_MAX) return;
+    record->new_value = (WORD_UTYPE)(old_value - model->memory[a]);
+    record->taken = (WORD_STYPE)record->new_value <= 0;
+}
+
+static inline void trace_apply(TraceModel* model, const TraceRecord* record) {
+    // c is read before the write like the VM does, the write may land on the instruction itself
+    WORD_UTYPE c = model->memory[(WORD_UTYPE)(record->pc + 2)];
+    bool output = record->a != WORD_MAX && record->b == WORD_MAX;
+    if (!output) model->memory[record->b] = record->new_value;
+    model->pc = record->taken && !output ? c : (WORD_UTYPE)(record->pc + 3);
+    ++model->step;
+    if (!output || !record->taken || record->new_value >= SUBLANQ_BANK_COUNT) return;
+    if (!model->banks) model->banks = calloc((size_t)SUBLANQ_BANK_COUNT * SUBLANQ_BANK_WORDS, sizeof(WORD_UTYPE));
+    if (!model->banks) { fprintf(stderr, "Trace alloc failed\n"); exit(1); }
+    WORD_UTYPE* window = model->memory + SUBLANQ_BANK_BASE;
+    memcpy(model->banks + (size_t)model->bank * SUBLANQ_BANK_WORDS, window, SUBLANQ_BANK_WORDS * sizeof(WORD_UTYPE));
+    memcpy(window, model->banks + (size_t)record->new_value * SUBLANQ_BANK_WORDS, SUBLANQ_BANK_WORDS * sizeof(WORD_UTYPE));
+    model->bank = record->new_value;
+}
+
+static inline uint8_t* trace_put_varint(uint8_t* out, uint32_t value) {
+    while (value >= 0x80) { *out++ = (uint8_t)(value | 0x80); value >>= 7; }
+    *out++ = (uint8_t)value;
+    return out;
+}
+static inline uint8_t* trace_put_delta(uint8_t* out, WORD_UTYPE actual, WORD_UTYPE predicted) {
+    int32_t delta = (WORD_STYPE)(WORD_UTYPE)(actual - predicted);
+    return trace_put_varint(out, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+}
+static inline uint8_t* trace_put_header(uint8_t* out, const TraceModel* model) {
+    memcpy(out, TRACE_MAGIC, TRACE_MAGIC_SIZE);
+    out += TRACE_MAGIC_SIZE;
+    *out++ = (uint8_t)model->pc; *out++ = (uint8_t)(model->pc >> 8);
+    for (int i = 0; i < 8; ++i) *out++ = (uint8_t)(model->step >> (8 * i));
+    *out++ = (uint8_t)model->size; *out++ = (uint8_t)(model->size >> 8);
+    *out++ = (uint8_t)model->bank; *out++ = (uint8_t)(model->bank >> 8);
+    for (size_t i = 0; i < SUBLANQ_MEMORY_WORDS; ++i) { *out++ = (uint8_t)model->memory[i]; *out++ = (uint8_t)(model->memory[i] >> 8); }
+    return out;
+}
+
+// encoder, run is the count of fully predicted records not written yet
+typedef struct {
+    TraceModel model;
+    uint64_t run;
+} TraceEncoder;
+
+// out needs room for TRACE_RECORD_MAX_BYTES
+#define TRACE_RECORD_MAX_BYTES 32
+static inline uint8_t* trace_flush_run(TraceEncoder* encoder, uint8_t* out) {
+    while (encoder->run) {
+        uint32_t n = encoder->run > UINT32_MAX ? UINT32_MAX : (uint32_t)encoder->run;
+        *out++ = 0;
+        out = trace_put_varint(out, n);
+        encoder->run -= n;
+    }
+    return out;
+}
+static inline uint8_t* trace_encode(TraceEncoder* encoder, const TraceRecord* record, uint8_t* out) {
+    TraceRecord predicted;
+    trace_predict(&encoder->model, &predicted);
+    uint8_t mask = (record->pc != predicted.pc ? TRACE_MISS_PC : 0)
+                 | (record->a != predicted.a ? TRACE_MISS_A : 0)
+                 | (record->b != predicted.b ? TRACE_MISS_B : 0)
+                 | (record->old_value != predicted.old_value ? TRACE_MISS_OLD : 0)
+                 | (record->new_value != predicted.new_value ? TRACE_MISS_NEW : 0)
+                 | (record->taken != predicted.taken ? TRACE_MISS_TAKEN : 0);
+    if (!mask) ++encoder->run;
+    else {
+        out = trace_flush_run(encoder, out);
+        *out++ = mask;
+        if (mask & TRACE_MISS_PC) out = trace_put_delta(out, record->pc, predicted.pc);
+        if (mask & TRACE_MISS_A) out = trace_put_delta(out, record->a, predicted.a);
+        if (mask & TRACE_MISS_B) out = trace_put_delta(out, record->b, predicted.b);
+        if (mask & TRACE_MISS_OLD) out = trace_put_delta(out, record->old_value, predicted.old_value);
+        if (mask & TRACE_MISS_NEW) out = trace_put_delta(out, record->new_value, predicted.new_value);
+    }
+    trace_apply(&encoder->model, record);
+    return out;
+}
+
+// decoder reads from a FILE, the run of predicted records left is kept between calls
+typedef struct {
+    TraceModel model;
+    uint64_t run;
+    FILE* file;
+} TraceDecoder;
+
+static inline bool trace_get_varint(FILE* file, uint32_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int byte = getc(file);
+        if (byte == EOF) return false;
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+static inline bool trace_get_delta(FILE* file, WORD_UTYPE* field) {
+    uint32_t zigzag;
+    if (!trace_get_varint(file, &zigzag)) return false;
+    *field = (WORD_UTYPE)(*field + (WORD_UTYPE)((zigzag >> 1) ^ (0u - (zigzag & 1))));
+    return true;
+}
+
+static inline bool trace_decoder_open(TraceDecoder* decoder, FILE* file) {
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->file = file;
+    uint8_t header[TRACE_HEADER_SIZE];
+    if (fread(header, 1, TRACE_HEADER_SIZE, file) != TRACE_HEADER_SIZE || memcmp(header, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0) return false;
+    const uint8_t* in = header + TRACE_MAGIC_SIZE;
+    decoder->model.pc = (WORD_UTYPE)(in[0] | in[1] << 8);
+    in += 2;
+    for (int i = 0; i < 8; ++i) decoder->model.step |= (uint64_t)in[i] << (8 * i);
+    in += 8;
+    decoder->model.size = (WORD_UTYPE)(in[0] | in[1] << 8);
+    in += 2;
+    decoder->model.bank = (WORD_UTYPE)(in[0] | in[1] << 8);
+    in += 2;
+    for (size_t i = 0; i < SUBLANQ_MEMORY_WORDS; ++i) decoder->model.memory[i] = (WORD_UTYPE)(in[2 * i] | in[2 * i + 1] << 8);
+    return true;
+}
+
+// false at the end of the trace
+static inline bool trace_decode(TraceDecoder* decoder, TraceRecord* record) {
+    TraceModel* model = &decoder->model;
+    while (!decoder->run) {
+        int mask = getc(decoder->file);
+        if (mask == EOF) return false;
+        if (mask == 0) {
+            uint32_t n;
+            if (!trace_get_varint(decoder->file, &n)) return false;
+            decoder->run = n;
+            continue;
+        }
+        trace_predict(model, record);
+        if ((mask & TRACE_MISS_PC) && !trace_get_delta(decoder->file, &record->pc)) return false;
+        if ((mask & TRACE_MISS_A) && !trace_get_delta(decoder->file, &record->a)) return false;
+        if ((mask & TRACE_MISS_B) && !trace_get_delta(decoder->file, &record->b)) return false;
+        if ((mask & TRACE_MISS_OLD) && !trace_get_delta(decoder->file, &record->old_value)) return false;
+        if ((mask & TRACE_MISS_NEW) && !trace_get_delta(decoder->file, &record->new_value)) return false;
+        if (mask & TRACE_MISS_TAKEN) record->taken = !record->taken;
+        trace_apply(model, record);
+        return true;
+    }
+    --decoder->run;
+    trace_predict(model, record);
+    trace_apply(model, record);
+    return true;
+}